@@ -9,7 +9,12 @@ SDL_PATH := ../SDL2
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/$(SDL_PATH)/include
 
 # Add your application source files here...
-LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c bundle.c draw.c mbrowse.c sound.c stats.c ticks.c about.c levels.c pixel.c scrollbar.c swscale.c credits.c game.c menu.c sprite.c strings.c transition.c levelselector.c settings.c teleport.c cursor.c input.c pack.c player.c stars.c strinput.c userfiles.c board.c skipleveldialog.c text.c leveleditor.c main.c particles.c pointer.c switch.c waveimg.c list/list.c platform/libDLC.c platform/androidUtils.c
+LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c bundle.c archive.c draw.c mbrowse.c sound.c stats.c statsupload.c capture.c ticks.c about.c levels.c levelindex.c levelbin.c preview.c solver.c bench.c memtrack.c pixel.c scrollbar.c swscale.c credits.c game.c menu.c sprite.c strings.c transition.c levelselector.c settings.c teleport.c cursor.c input.c pack.c player.c stars.c strinput.c userfiles.c board.c skipleveldialog.c text.c leveleditor.c main.c startup.c particles.c pointer.c profiler.c switch.c waveimg.c list/list.c platform/libDLC.c platform/androidUtils.c
+
+# ndk-build WANT_MEMTRACK=1 tracks every allocation, see memtrack.h
+ifeq ($(WANT_MEMTRACK),1)
+LOCAL_CFLAGS += -DWANT_MEMTRACK -include $(LOCAL_PATH)/memtrack.h
+endif
 
 LOCAL_SHARED_LIBRARIES := SDL2_image SDL2_mixer SDL2
 
@@ -0,0 +1,606 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "archive.h"
+#include "levelindex.h"
+#include "list/list.h"
+#if defined(__ANDROID__)
+#include "platform/androidUtils.h"
+#endif
+
+//All fields are little endian
+#pragma pack(push, 1)
+typedef struct {
+  char ident[8];
+  Uint32 version;
+  Uint32 numEntries;
+  Uint32 tocOffset;
+  Uint32 namesOffset;
+  Uint32 namesLen;
+} archiveHeader_t;
+
+typedef struct {
+  Uint32 hash; //Entries are sorted by hash, then name
+  Uint32 nameOffset; //Into the name table, names are 0 terminated
+  Uint32 nameLen;
+  Uint32 dataOffset; //Aligned to ARCHIVE_ALIGN
+  Uint32 dataLen;
+} archiveEntry_t;
+#pragma pack(pop)
+
+struct archive_s {
+  char* path;
+  int pathLen;
+  const Uint8* base;
+  size_t size;
+  const archiveEntry_t* toc;
+  Uint32 numEntries;
+  const char* names;
+  void* map; //mmap'ed, or NULL
+#if defined(__ANDROID__)
+  AAsset* asset; //Opened from the apk, or NULL
+#endif
+};
+
+static list_t* mounted=NULL;
+//Packs are mounted while other startup jobs look up files. Archives are never unmounted.
+static SDL_SpinLock mountLock=0;
+
+static int archiveValidate(archive_t* a)
+{
+  const archiveHeader_t* hdr = (const archiveHeader_t*)a->base;
+  Uint32 i, tocOffset, namesOffset, namesLen;
+  const archiveEntry_t* e;
+
+  if( a->size < sizeof(archiveHeader_t) || memcmp(hdr->ident, ARCHIVE_IDENT, 8)!=0 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveOpen(); '%s' is not an archive.", a->path);
+    return(0);
+  }
+
+  if( SDL_SwapLE32(hdr->version) != ARCHIVE_VERSION )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveOpen(); '%s' has unsupported version %u.", a->path, SDL_SwapLE32(hdr->version));
+    return(0);
+  }
+
+  a->numEntries = SDL_SwapLE32(hdr->numEntries);
+  tocOffset = SDL_SwapLE32(hdr->tocOffset);
+  namesOffset = SDL_SwapLE32(hdr->namesOffset);
+  namesLen = SDL_SwapLE32(hdr->namesLen);
+
+  if( tocOffset > a->size || (a->size-tocOffset)/sizeof(archiveEntry_t) < a->numEntries ||
+      namesOffset > a->size || a->size-namesOffset < namesLen )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveOpen(); '%s' is corrupt (header).", a->path);
+    return(0);
+  }
+
+  a->toc = (const archiveEntry_t*)(a->base+tocOffset);
+  a->names = (const char*)(a->base+namesOffset);
+
+  for(i=0; i < a->numEntries; i++)
+  {
+    e=&a->toc[i];
+    if( SDL_SwapLE32(e->dataOffset) > a->size || a->size-SDL_SwapLE32(e->dataOffset) < SDL_SwapLE32(e->dataLen) ||
+        SDL_SwapLE32(e->nameOffset) >= namesLen || namesLen-SDL_SwapLE32(e->nameOffset) <= SDL_SwapLE32(e->nameLen) ||
+        a->names[SDL_SwapLE32(e->nameOffset)+SDL_SwapLE32(e->nameLen)] != 0 )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveOpen(); '%s' is corrupt (entry %u).", a->path, i);
+      return(0);
+    }
+  }
+
+  return(1);
+}
+
+archive_t* archiveOpen(const char* fileName)
+{
+  struct stat st;
+  int fd;
+  archive_t* a = malloc(sizeof(archive_t));
+
+  if(!a)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveOpen(); Out of memory.");
+    return(NULL);
+  }
+  memset(a, 0, sizeof(archive_t));
+
+  a->pathLen = strlen(fileName);
+  a->path = malloc( sizeof(char)*(a->pathLen+1) );
+  strcpy(a->path, fileName);
+
+  //Map it from the filesystem
+  fd = open(fileName, O_RDONLY);
+  if( fd != -1 )
+  {
+    if( fstat(fd, &st)==0 && st.st_size > 0 )
+    {
+      a->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if( a->map == MAP_FAILED )
+      {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveOpen(); mmap('%s') failed: %s", fileName, strerror(errno));
+        a->map=NULL;
+      } else {
+        a->base=a->map;
+        a->size=st.st_size;
+      }
+    }
+    close(fd);
+  }
+#if defined(__ANDROID__)
+  //Or from the apk, it should be stored uncompressed so the buffer points straight into it
+  else
+  {
+    a->asset = AAssetManager_open(asset_mgr, fileName, AASSET_MODE_BUFFER);
+    if( a->asset )
+    {
+      a->base = AAsset_getBuffer(a->asset);
+      a->size = AAsset_getLength(a->asset);
+    }
+  }
+#endif
+
+  if( !a->base || !archiveValidate(a) )
+  {
+    archiveClose(a);
+    return(NULL);
+  }
+
+  return(a);
+}
+
+void archiveClose(archive_t* a)
+{
+  if(!a) return;
+
+  if(a->map)
+    munmap(a->map, a->size);
+#if defined(__ANDROID__)
+  if(a->asset)
+    AAsset_close(a->asset);
+#endif
+
+  free(a->path);
+  free(a);
+}
+
+const void* archiveGet(archive_t* a, const char* name, Uint32* len)
+{
+  Uint32 h = levelIndexHash(name);
+  Uint32 lo=0, hi=a->numEntries, mid;
+  const archiveEntry_t* e;
+
+  //Find the first entry with this hash
+  while( lo < hi )
+  {
+    mid = lo+(hi-lo)/2;
+    if( SDL_SwapLE32(a->toc[mid].hash) < h )
+      lo=mid+1;
+    else
+      hi=mid;
+  }
+
+  for( ; lo < a->numEntries && SDL_SwapLE32(a->toc[lo].hash)==h; lo++ )
+  {
+    e=&a->toc[lo];
+    if( strcmp(a->names+SDL_SwapLE32(e->nameOffset), name)==0 )
+    {
+      if(len)
+        *len = SDL_SwapLE32(e->dataLen);
+      return( a->base+SDL_SwapLE32(e->dataOffset) );
+    }
+  }
+
+  return(NULL);
+}
+
+int archiveMount(const char* fileName)
+{
+  archive_t* a = archiveOpen(fileName);
+  if(!a)
+    return(0);
+
+  SDL_AtomicLock(&mountLock);
+  if(!mounted)
+    mounted = listInit(NULL);
+
+  listAppendData(mounted, (void*)a);
+  SDL_AtomicUnlock(&mountLock);
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "archiveMount(); Mounted '%s' (%u files).", fileName, a->numEntries);
+  return(1);
+}
+
+//The mounted archive path is inside of, and the name within it
+static archive_t* archiveOf(const char* path, const char** name)
+{
+  archive_t* a;
+  archive_t* found=NULL;
+  listItem* it;
+
+  SDL_AtomicLock(&mountLock);
+  if(mounted)
+  {
+    it=&mounted->begin;
+    while( LISTFWD(mounted,it) )
+    {
+      a=(archive_t*)it->data;
+      if( strncmp(path, a->path, a->pathLen)==0 && path[a->pathLen]=='/' )
+      {
+        *name = path+a->pathLen+1;
+        found=a;
+        break;
+      }
+    }
+  }
+  SDL_AtomicUnlock(&mountLock);
+  return(found);
+}
+
+const void* archiveFind(const char* path, Uint32* len)
+{
+  const char* name;
+  archive_t* a = archiveOf(path, &name);
+  return( (a)?archiveGet(a, name, len):NULL );
+}
+
+SDL_RWops* archiveRW(const char* path)
+{
+  Uint32 len;
+  const void* data = archiveFind(path, &len);
+  return( (data)?SDL_RWFromConstMem(data, len):NULL );
+}
+
+int archiveIsFile(const char* path)
+{
+  return( archiveFind(path, NULL)!=NULL );
+}
+
+static int archiveIsMounted(const char* path)
+{
+  listItem* it;
+  int ret=0;
+
+  SDL_AtomicLock(&mountLock);
+  if(mounted)
+  {
+    it=&mounted->begin;
+    while( LISTFWD(mounted,it) )
+    {
+      if( strcmp( ((archive_t*)it->data)->path, path)==0 )
+      {
+        ret=1;
+        break;
+      }
+    }
+  }
+  SDL_AtomicUnlock(&mountLock);
+  return(ret);
+}
+
+int archiveIsDir(const char* path)
+{
+  const char* name;
+  const char* entry;
+  archive_t* a;
+  Uint32 i;
+  size_t n;
+
+  //A mounted archive counts as the directory it was made from
+  if( archiveIsMounted(path) )
+    return(1);
+
+  a = archiveOf(path, &name);
+  if(!a)
+    return(0);
+
+  n = strlen(name);
+  while( n > 0 && name[n-1]=='/' )
+    n--;
+  if( n == 0 )
+    return(1);
+
+  //Dirs are not stored, only the names of the files in them
+  for(i=0; i < a->numEntries; i++)
+  {
+    entry = a->names+SDL_SwapLE32(a->toc[i].nameOffset);
+    if( strncmp(entry, name, n)==0 && entry[n]=='/' )
+      return(1);
+  }
+  return(0);
+}
+
+#if defined(__ANDROID__)
+struct memFile_s {
+  const char* data;
+  Uint32 len;
+  Uint32 pos;
+};
+
+static int memRead(void* cookie, char* buf, int size)
+{
+  struct memFile_s* m = (struct memFile_s*)cookie;
+  if( (Uint32)size > m->len-m->pos )
+    size = m->len-m->pos;
+  memcpy(buf, m->data+m->pos, size);
+  m->pos+=size;
+  return(size);
+}
+
+static int memWrite(void* cookie, const char* buf, int size)
+{
+  errno=EACCES;
+  return(-1);
+}
+
+static fpos_t memSeek(void* cookie, fpos_t offset, int whence)
+{
+  struct memFile_s* m = (struct memFile_s*)cookie;
+  fpos_t p = (whence==SEEK_SET)?offset:(whence==SEEK_CUR)?m->pos+offset:m->len+offset;
+  if( p < 0 || p > m->len )
+    return(-1);
+  m->pos=p;
+  return(p);
+}
+
+static int memClose(void* cookie)
+{
+  free(cookie);
+  return(0);
+}
+#endif
+
+FILE* archiveFopen(const char* path)
+{
+  Uint32 len;
+  const void* data = archiveFind(path, &len);
+
+  if(!data)
+    return(NULL);
+
+#if defined(__ANDROID__)
+  struct memFile_s* m = malloc(sizeof(struct memFile_s));
+  m->data=data;
+  m->len=len;
+  m->pos=0;
+  return( funopen(m, memRead, memWrite, memSeek, memClose) );
+#else
+  return( fmemopen((void*)data, len, "r") );
+#endif
+}
+
+FILE* archiveFopenAny(const char* path, const char* mode)
+{
+  FILE* f = (mode[0]=='r')?archiveFopen(path):NULL;
+  return( (f)?f:fopen(path, mode) );
+}
+
+//Writer
+struct archiveSrc_s {
+  char* name; //Relative to inDir
+  Uint32 hash;
+  Uint32 len;
+};
+
+static int archiveScan(const char* dir, const char* rel, list_t* files)
+{
+  struct dirent *pent;
+  struct stat st;
+  char buf[2048], relBuf[1024];
+  struct archiveSrc_s* src;
+  DIR *pdir= opendir( dir );
+
+  if(!pdir)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveCreate(); Couldn't open dir '%s'.", dir);
+    return(0);
+  }
+
+  while( (pent=readdir(pdir)) )
+  {
+    //We're not going to read hidden files or . / ..
+    if(pent->d_name[0] == '.')
+      continue;
+
+    sprintf(buf, "%s/%s", dir, pent->d_name);
+    if(rel[0])
+      sprintf(relBuf, "%s/%s", rel, pent->d_name);
+    else
+      strcpy(relBuf, pent->d_name);
+
+    if(stat(buf, &st)!=0)
+      continue;
+
+    if( S_ISDIR(st.st_mode) )
+    {
+      if(!archiveScan(buf, relBuf, files))
+      {
+        closedir(pdir);
+        return(0);
+      }
+    } else if( S_ISREG(st.st_mode) )
+    {
+      src = malloc(sizeof(struct archiveSrc_s));
+      src->name = malloc( sizeof(char)*(strlen(relBuf)+1) );
+      strcpy(src->name, relBuf);
+      src->hash = levelIndexHash(relBuf);
+      src->len = st.st_size;
+      listAppendData(files, (void*)src);
+    }
+  }
+  closedir(pdir);
+  return(1);
+}
+
+static int archiveSrcCmp(const void* a, const void* b)
+{
+  const struct archiveSrc_s* sa = *(const struct archiveSrc_s**)a;
+  const struct archiveSrc_s* sb = *(const struct archiveSrc_s**)b;
+  if( sa->hash != sb->hash )
+    return( (sa->hash < sb->hash)?-1:1 );
+  return( strcmp(sa->name, sb->name) );
+}
+
+static void archivePad(FILE* f, long to)
+{
+  while( ftell(f) < to )
+    fputc(0, f);
+}
+
+static void _freeArchiveSrc(void* data)
+{
+  free( ((struct archiveSrc_s*)data)->name );
+  free( data );
+}
+
+int archiveCreate(const char* file, const char* inDir)
+{
+  list_t* files = listInit(_freeArchiveSrc);
+  struct archiveSrc_s** srcs=NULL;
+  archiveHeader_t hdr;
+  archiveEntry_t e;
+  listItem* it;
+  FILE *f=NULL, *in;
+  Uint32 i, n, namesLen=0, nameOffset=0, dataOffset;
+  char buf[4096];
+  size_t r;
+  int ret=0;
+
+  if( !archiveScan(inDir, "", files) )
+    goto done;
+
+  //Sort the table of contents
+  n = files->count;
+  srcs = malloc( sizeof(struct archiveSrc_s*)*(n+1) );
+  i=0;
+  it=&files->begin;
+  while( LISTFWD(files,it) )
+  {
+    srcs[i] = (struct archiveSrc_s*)it->data;
+    namesLen += strlen(srcs[i]->name)+1;
+    i++;
+  }
+  qsort(srcs, n, sizeof(struct archiveSrc_s*), archiveSrcCmp);
+
+  f = fopen(file, "wb");
+  if(!f)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveCreate(); Couldn't open '%s' for writing.", file);
+    goto done;
+  }
+
+  memcpy(hdr.ident, ARCHIVE_IDENT, 8);
+  hdr.version = SDL_SwapLE32(ARCHIVE_VERSION);
+  hdr.numEntries = SDL_SwapLE32(n);
+  hdr.tocOffset = SDL_SwapLE32(sizeof(archiveHeader_t));
+  hdr.namesOffset = SDL_SwapLE32(sizeof(archiveHeader_t)+n*sizeof(archiveEntry_t));
+  hdr.namesLen = SDL_SwapLE32(namesLen);
+  fwrite(&hdr, sizeof(archiveHeader_t), 1, f);
+
+  //Table of contents, data offsets are laid out page by page after the names
+  dataOffset = sizeof(archiveHeader_t)+n*sizeof(archiveEntry_t)+namesLen;
+  for(i=0; i < n; i++)
+  {
+    dataOffset = (dataOffset+ARCHIVE_ALIGN-1)/ARCHIVE_ALIGN*ARCHIVE_ALIGN;
+    e.hash = SDL_SwapLE32(srcs[i]->hash);
+    e.nameOffset = SDL_SwapLE32(nameOffset);
+    e.nameLen = SDL_SwapLE32(strlen(srcs[i]->name));
+    e.dataOffset = SDL_SwapLE32(dataOffset);
+    e.dataLen = SDL_SwapLE32(srcs[i]->len);
+    fwrite(&e, sizeof(archiveEntry_t), 1, f);
+
+    nameOffset += strlen(srcs[i]->name)+1;
+    dataOffset += srcs[i]->len;
+  }
+
+  for(i=0; i < n; i++)
+  {
+    fwrite(srcs[i]->name, strlen(srcs[i]->name)+1, 1, f);
+  }
+
+  //Data
+  dataOffset = sizeof(archiveHeader_t)+n*sizeof(archiveEntry_t)+namesLen;
+  for(i=0; i < n; i++)
+  {
+    dataOffset = (dataOffset+ARCHIVE_ALIGN-1)/ARCHIVE_ALIGN*ARCHIVE_ALIGN;
+    archivePad(f, dataOffset);
+
+    sprintf(buf, "%s/%s", inDir, srcs[i]->name);
+    in = fopen(buf, "rb");
+    if(!in)
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveCreate(); Couldn't open '%s'.", buf);
+      goto done;
+    }
+    while( (r=fread(buf, 1, sizeof(buf), in)) > 0 )
+    {
+      fwrite(buf, 1, r, f);
+    }
+    fclose(in);
+
+    dataOffset += srcs[i]->len;
+    if( ftell(f) != (long)dataOffset )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "archiveCreate(); '%s/%s' changed while writing.", inDir, srcs[i]->name);
+      goto done;
+    }
+  }
+
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "archiveCreate(); Wrote %u files to '%s'.", n, file);
+  ret=1;
+
+done:
+  if(f)
+    fclose(f);
+  if(!ret && f)
+    unlink(file);
+  free(srcs);
+  listFree(files);
+  return(ret);
+}
+
+int archiveMain(int argc, char** argv)
+{
+  archive_t* a;
+
+  if( argc != 2 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Usage: -archive packs/packdir out"ARCHIVE_EXT"\n");
+    return(-1);
+  }
+
+  if( !archiveCreate(argv[1], argv[0]) )
+    return(-1);
+
+  //Read it back the way the game will
+  a = archiveOpen(argv[1]);
+  if(!a)
+    return(-1);
+  archiveClose(a);
+  return(0);
+}
@@ -0,0 +1,63 @@
+#ifndef ARCHIVE_H_INCLUDED
+#define ARCHIVE_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <SDL.h>
+
+//Read-only pack archive: One file with a table of contents sorted by name hash,
+//and every entry aligned to a page so it can be used straight from a memory mapping.
+//A pack archive is installed by dropping "name.wza" into the packs dir, files in it
+//are then found as "path/to/name.wza/levels/level000.wzp".
+
+#define ARCHIVE_IDENT "WZNCARCH"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_EXT ".wza"
+
+#ifndef ARCHIVE_ALIGN
+  #define ARCHIVE_ALIGN 4096
+#endif
+
+typedef struct archive_s archive_t;
+
+archive_t* archiveOpen(const char* fileName); //Ret 0 fail
+void archiveClose(archive_t* a);
+//Returns a pointer into the mapping, or NULL if name is not in the archive.
+const void* archiveGet(archive_t* a, const char* name, Uint32* len);
+
+//Mount an archive so paths below its file name are served from it. Returns 1 on success.
+int archiveMount(const char* fileName);
+//Lookups on mounted archives, all return NULL/0 if path is not inside one.
+const void* archiveFind(const char* path, Uint32* len);
+SDL_RWops* archiveRW(const char* path);
+FILE* archiveFopen(const char* path);
+int archiveIsFile(const char* path);
+//The archive itself and the dirs of the files in it.
+int archiveIsDir(const char* path);
+
+//archiveFopen() inside mounted archives, fopen() everywhere else.
+FILE* archiveFopenAny(const char* path, const char* mode);
+
+//Write all files below inDir into an archive. Returns 1 on success.
+int archiveCreate(const char* file, const char* inDir);
+
+//-archive packs/packdir out.wza, for pack makers.
+int archiveMain(int argc, char** argv);
+
+#endif // ARCHIVE_H_INCLUDED
@@ -0,0 +1,710 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL_image.h>
+#include <SDL_mixer.h>
+
+#include "bench.h"
+#include "defs.h"
+#include "settings.h"
+#include "board.h"
+#include "capture.h"
+#include "cursor.h"
+#include "draw.h"
+#include "pack.h"
+#include "particles.h"
+#include "pixel.h"
+#include "sound.h"
+#include "sprite.h"
+#include "stats.h"
+#include "statsupload.h"
+#include "swscale.h"
+#include "text.h"
+#include "ticks.h"
+#include "transition.h"
+#include "userfiles.h"
+#include "waveimg.h"
+#include "memtrack.h"
+
+typedef struct {
+  char name[32];
+  int frames;
+  int ops; //What one op is depends on the scenario, a frame unless noted
+  Uint64 counts; //Performance counter, only the measured part
+  Uint64 start;
+  Uint32 allocs; //Made in the measured part, when the tracker is compiled in
+  Uint32 allocStart;
+} benchResult_t;
+
+typedef struct {
+  const char* name;
+  void (*run)();
+} benchScenario_t;
+
+static benchResult_t results[BENCH_MAX_RESULTS];
+static int numResults=0;
+static int frames=BENCH_FRAMES;
+static SDL_Surface* screen=NULL;
+static int failed=0; //A scenario found wrong output
+static Uint32 rnd; //For the scripted moves, rand() belongs to the game
+
+static const char* transitionNames[NUM_TRANSITIONS] = { "dissolve", "curtain_up", "curtain_down", "roll_out", "roll_in", "diagonal", "iris", "pixel_dissolve" };
+
+static Uint32 benchRand()
+{
+  rnd = rnd*1103515245u+12345u;
+  return( rnd>>16 );
+}
+
+static void benchSeed()
+{
+  srand(BENCH_SEED);
+  rnd=BENCH_SEED;
+}
+
+static void benchBegin(benchResult_t* r)
+{
+  #if defined(WANT_MEMTRACK)
+  memStats_t ms;
+  memGetStats(&ms);
+  r->allocStart=ms.allocs;
+  #endif
+  r->start=SDL_GetPerformanceCounter();
+}
+
+static void benchEnd(benchResult_t* r)
+{
+  #if defined(WANT_MEMTRACK)
+  memStats_t ms;
+  #endif
+
+  r->counts += SDL_GetPerformanceCounter()-r->start;
+  #if defined(WANT_MEMTRACK)
+  memGetStats(&ms);
+  r->allocs += ms.allocs-r->allocStart;
+  #endif
+}
+
+static benchResult_t* benchResult(const char* name)
+{
+  benchResult_t* r;
+
+  if( numResults == BENCH_MAX_RESULTS )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: More than %i results, '%s' is not kept.\n", BENCH_MAX_RESULTS, name);
+    r=&results[BENCH_MAX_RESULTS-1];
+  } else {
+    r=&results[numResults++];
+  }
+
+  memset( r, 0, sizeof(benchResult_t) );
+  snprintf( r->name, sizeof(r->name), "%s", name );
+  return(r);
+}
+
+//Level and its graphics, like initGame() but without the samples and fonts
+static int benchLevelLoad(playField* pf, const char* file)
+{
+  memset( pf, 0, sizeof(playField) );
+  if( !loadLevel(pf, file) )
+  {
+    return(0);
+  }
+  if( !initDraw(pf->levelInfo, screen) )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: Couldn't load graphics for '%s'\n", file);
+    freeField(pf);
+    freeLevelInfo(&pf->levelInfo);
+    return(0);
+  }
+  return(1);
+}
+
+static void benchLevelFree(playField* pf)
+{
+  clearParticles();
+  cleanUpDraw();
+  freeField(pf);
+  freeLevelInfo(&pf->levelInfo);
+}
+
+static packInfoType* benchPack(int p)
+{
+  packInfoType* pi = (packInfoType*)listGetItemAt(packState()->packs, p)->data;
+  if( pi == packState()->dlc )
+    return(NULL);
+
+  packSet(p);
+  return(pi);
+}
+
+static int benchBricks(playField* pf)
+{
+  int i, n=0;
+  for(i=BRICKSBEGIN; i <= BRICKSEND; i++)
+  {
+    n += pf->brickTypes[i-1];
+  }
+  return(n);
+}
+
+//Scripted player, pushes a random brick a random way
+static void benchMove(playField* pf)
+{
+  int i, c = benchRand()%(FIELDSIZE*FIELDSIZE);
+  int dir = (benchRand()&1)?DIRRIGHT:DIRLEFT;
+  brickType* b;
+
+  for(i=0; i < FIELDSIZE*FIELDSIZE; i++)
+  {
+    b = pf->board[c%FIELDSIZE][c/FIELDSIZE];
+    if( b && isBrick(b) && curMoveBrick(pf, b, dir) )
+      return;
+    c = (c+1)%(FIELDSIZE*FIELDSIZE);
+  }
+}
+
+//simField and doRules on every level of every pack, with a move every BENCH_MOVE_FRAMES
+static void benchSim()
+{
+  benchResult_t* r = benchResult("sim");
+  packInfoType* pi;
+  playField pf;
+  cursorType cur;
+  int p,l,f;
+
+  for(p=0; p < packState()->numPacks; p++)
+  {
+    if( !(pi=benchPack(p)) )
+      continue;
+
+    for(l=0; l < pi->numLevels; l++)
+    {
+      if( !benchLevelLoad(&pf, ((levelInfo_t*)ARRAYAT(pi->levels, l))->file) )
+        continue;
+
+      initCursor(&cur);
+      benchSeed();
+      benchBegin(r);
+      for(f=0; f < frames; f++)
+      {
+        frameStartFixed(BENCH_TICK_MS);
+        if( f%BENCH_MOVE_FRAMES == 0 )
+          benchMove(&pf);
+        simField(&pf, &cur);
+        doRules(&pf);
+      }
+      benchEnd(r);
+      r->frames += frames;
+      r->ops += frames;
+
+      benchLevelFree(&pf);
+    }
+  }
+}
+
+//draw() on the shipped level with the most bricks
+static void benchDraw()
+{
+  benchResult_t* r;
+  packInfoType* pi;
+  playField pf;
+  cursorType cur;
+  char* file=NULL;
+  int p,l,n,f,best=-1,bestPack=0;
+
+  for(p=0; p < packState()->numPacks; p++)
+  {
+    if( !(pi=benchPack(p)) )
+      continue;
+
+    for(l=0; l < pi->numLevels; l++)
+    {
+      memset( &pf, 0, sizeof(playField) );
+      if( !loadLevel(&pf, ((levelInfo_t*)ARRAYAT(pi->levels, l))->file) )
+        continue;
+
+      n=benchBricks(&pf);
+      if( n > best )
+      {
+        best=n;
+        bestPack=p;
+        file=((levelInfo_t*)ARRAYAT(pi->levels, l))->file;
+      }
+      freeField(&pf);
+      freeLevelInfo(&pf.levelInfo);
+    }
+  }
+
+  if( !file )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: No level to draw.\n");
+    return;
+  }
+
+  benchPack(bestPack);
+  if( !benchLevelLoad(&pf, file) )
+    return;
+
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "bench: Drawing '%s', %i bricks.\n", file, best);
+  r = benchResult("draw");
+  initCursor(&cur);
+  benchSeed();
+  benchBegin(r);
+  for(f=0; f < frames; f++)
+  {
+    frameStartFixed(BENCH_TICK_MS);
+    draw(&cur, &pf, screen);
+  }
+  benchEnd(r);
+  r->frames = r->ops = frames;
+
+  benchLevelFree(&pf);
+}
+
+//BENCH_STORM_SYSTEMS new particle systems a frame, the size of brick explosions
+static void benchParticles()
+{
+  benchResult_t* r = benchResult("particles");
+  int f,i;
+
+  benchSeed();
+  SDL_FillRect(screen, NULL, 0);
+  benchBegin(r);
+  for(f=0; f < frames; f++)
+  {
+    frameStartFixed(BENCH_TICK_MS);
+    for(i=0; i < BENCH_STORM_SYSTEMS; i++)
+    {
+      psysSpawnPreset( (i&1)?PSYS_PRESET_WHITE:PSYS_PRESET_COLOR, benchRand()%SCREENW, benchRand()%SCREENH, 60, 350 );
+    }
+    runParticles(screen);
+  }
+  benchEnd(r);
+  r->frames = r->ops = frames;
+
+  clearParticles();
+}
+
+//The menu's title
+static void benchWave()
+{
+  benchResult_t* r;
+  wavingImage_t wi;
+  SDL_Surface* img;
+  int f;
+
+  img = loadImg("data/menu/intro.png");
+  if( !img )
+    return;
+
+  setWaving(&wi, screen, img, HSCREENW-149, HSCREENH-90, 1, 15, 300);
+  wi.privRotAmount=0;
+  wi.useOverlay=1;
+  wi.overlaySpeed=1;
+  wi.overlay = loadImg("data/menu/introoverlay.png");
+  wi.mask = loadImg("data/menu/intromask.png");
+  if( !wi.overlay || !wi.mask )
+  {
+    wi.useOverlay=0;
+  } else {
+    wi.overlayPos=wi.overlay->w+1;
+  }
+
+  r = benchResult("waveimg");
+  benchBegin(r);
+  for(f=0; f < frames; f++)
+  {
+    frameStartFixed(BENCH_TICK_MS);
+    waveImg(&wi);
+  }
+  benchEnd(r);
+  r->frames = r->ops = frames;
+
+  SDL_FreeSurface(img);
+  if( wi.overlay )
+    SDL_FreeSurface(wi.overlay);
+  if( wi.mask )
+    SDL_FreeSurface(wi.mask);
+}
+
+//One op is one string. The same strings every frame, then strings that change every frame.
+static void benchText()
+{
+  benchResult_t* r;
+  char buf[32];
+  int f,i,pass;
+
+  for(pass=0; pass < 2; pass++)
+  {
+    r = benchResult( (pass)?"text_changing":"text_cached" );
+    benchBegin(r);
+    for(f=0; f < frames; f++)
+    {
+      frameStartFixed(BENCH_TICK_MS);
+      for(i=0; i < BENCH_TEXT_LINES; i++)
+      {
+        sprintf( buf, "Score: %i", (pass)?f*BENCH_TEXT_LINES+i:i );
+        txtWrite(screen, (i&1)?FONTMEDIUM:FONTSMALL, buf, HSCREENW-150, HSCREENH-120+i*14);
+      }
+    }
+    benchEnd(r);
+    r->frames = frames;
+    r->ops = frames*BENCH_TEXT_LINES;
+  }
+}
+
+//Each transition, started over whenever it's done
+static void benchTransitions()
+{
+  benchResult_t* r;
+  char name[32];
+  int type,f,per;
+
+  per = BENCH_TRANSITION_MS/BENCH_TICK_MS+1;
+  for(type=0; type < NUM_TRANSITIONS; type++)
+  {
+    sprintf(name, "transition_%s", transitionNames[type]);
+    r = benchResult(name);
+    benchSeed();
+    benchBegin(r);
+    for(f=0; f < frames; f++)
+    {
+      if( f%per == 0 )
+        startTransition(screen, type, BENCH_TRANSITION_MS);
+      frameStartFixed(BENCH_TICK_MS);
+      runTransition(screen);
+    }
+    benchEnd(r);
+    r->frames = r->ops = frames;
+  }
+}
+
+#if defined(WANT_SWSCALE)
+static void benchSwScale()
+{
+  benchResult_t* r;
+  SDL_Surface* src;
+  char name[32];
+  int factor,f;
+
+  for(factor=2; factor <= BENCH_SWSCALE_MAX; factor++)
+  {
+    src = swScaleInit(SDL_SWSURFACE, factor);
+    if( !src )
+      continue;
+
+    sprintf(name, "swscale_%i", factor);
+    r = benchResult(name);
+    benchBegin(r);
+    for(f=0; f < frames; f++)
+    {
+      swScale(src, factor);
+    }
+    benchEnd(r);
+    r->frames = r->ops = frames;
+    SDL_FreeSurface(src);
+  }
+}
+#endif
+
+//QOI encode and decode of particles on black, the round trip must give back every pixel
+static void benchCapture()
+{
+  benchResult_t* r = benchResult("capture_qoi");
+  int f,i;
+
+  benchSeed();
+  SDL_FillRect(screen, NULL, 0);
+  for(f=0; f < frames; f++)
+  {
+    frameStartFixed(BENCH_TICK_MS);
+    for(i=0; i < BENCH_STORM_SYSTEMS; i++)
+    {
+      psysSpawnPreset( (i&1)?PSYS_PRESET_WHITE:PSYS_PRESET_COLOR, benchRand()%SCREENW, benchRand()%SCREENH, 60, 350 );
+    }
+    SDL_FillRect(screen, NULL, 0);
+    runParticles(screen);
+
+    benchBegin(r);
+    if( !captureQoiCheck(screen) )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: QOI round trip failed at frame %i.\n", f);
+      failed=1;
+      break;
+    }
+    benchEnd(r);
+  }
+  r->frames = r->ops = f;
+
+  clearParticles();
+}
+
+#if defined(PLATFORM_SUPPORTS_STATSUPLOAD)
+static int standInOld, standInBad;
+
+//Stands in for the stats server, the reply to "bench n" is n+1
+static int benchStandIn(const char** bodies, int num, int* replies)
+{
+  int i, n;
+
+  for(i=0; i < num; i++)
+  {
+    n = atoi( bodies[i]+6 );
+    if( strncmp( bodies[i], "bench ", 6 ) || n == -2 )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: Stand-in server got '%.32s'.\n", bodies[i]);
+      standInBad++;
+    } else if( n == -1 )
+    {
+      standInOld++;
+    }
+    replies[i] = n+1;
+  }
+  return(num);
+}
+
+//statsUpPost with a reply wanted, so every event is sent at once. The queue left from
+//"last time" has one event to send and two lines too long to send.
+static void benchStatsUpload()
+{
+  benchResult_t* r = benchResult("statsupload");
+  int* replies = calloc( frames, sizeof(int) );
+  char fn[600], bak[620], body[32];
+  Uint32 start;
+  int f, i, moved;
+  FILE* q;
+
+  //The player's own queue is put back afterwards
+  snprintf( fn, sizeof(fn), "%s/statsqueue.txt", getConfigDir() );
+  snprintf( bak, sizeof(bak), "%s.bench", fn );
+  moved = ( rename( fn, bak ) == 0 );
+
+  if( (q = fopen( fn, "w" )) )
+  {
+    fprintf( q, "bench bench -1\n" );
+    fprintf( q, "actionthatistoolong bench -2\n" );
+    fprintf( q, "bench " );
+    for(i=0; i < STATSUP_BODY_LEN+STATSUP_ACTION_LEN; i++)
+      fputc( 'x', q );
+    fprintf( q, "\n" );
+    fclose( q );
+  }
+
+  standInOld=standInBad=0;
+  setting()->uploadStats=1;
+  statsUpSetTransport( benchStandIn );
+  statsUpInit();
+
+  for(f=0; f < frames; f++)
+  {
+    snprintf( body, sizeof(body), "bench %i", f );
+    benchBegin(r);
+    i = statsUpPost( "bench", body, &replies[f] );
+    benchEnd(r);
+
+    start = SDL_GetTicks();
+    while( i && !replies[f] && SDL_GetTicks()-start < 1000 )
+      SDL_Delay(1);
+    if( replies[f] != f+1 )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: Event %i got reply %i from the stand-in server.\n", f, replies[f]);
+      failed=1;
+      break;
+    }
+  }
+  r->frames = r->ops = f;
+
+  statsUpQuit();
+  statsUpSetTransport( NULL );
+  setting()->uploadStats=0;
+
+  if( standInOld != 1 || standInBad )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: The queue on disk was sent %i times, %i bad events.\n", standInOld, standInBad);
+    failed=1;
+  }
+
+  remove( fn );
+  if( moved )
+    rename( bak, fn );
+  free( replies );
+}
+#endif
+
+static const benchScenario_t scenarios[] = {
+  { "sim", benchSim },
+  { "draw", benchDraw },
+  { "particles", benchParticles },
+  #if defined(WANT_SWSCALE)
+  { "swscale", benchSwScale },
+  #endif
+  { "waveimg", benchWave },
+  { "text", benchText },
+  { "transitions", benchTransitions },
+  { "capture", benchCapture },
+  #if defined(PLATFORM_SUPPORTS_STATSUPLOAD)
+  { "statsupload", benchStatsUpload },
+  #endif
+  { NULL, NULL }
+};
+
+static void benchWrite(FILE* f)
+{
+  double freq = (double)SDL_GetPerformanceFrequency();
+  double sec;
+  char allocStr[32] = "null"; //Unknown without the tracker
+  int i;
+
+  fprintf(f, "{\n  \"frames\": %i,\n  \"tick_ms\": %i,\n  \"seed\": %i,\n  \"results\": [\n", frames, BENCH_TICK_MS, BENCH_SEED);
+  for(i=0; i < numResults; i++)
+  {
+    sec = (double)results[i].counts/freq;
+    #if defined(WANT_MEMTRACK)
+    sprintf(allocStr, "%.2f", (results[i].frames)?(double)results[i].allocs/results[i].frames:0.0);
+    #endif
+    fprintf(f, "    { \"name\": \"%s\", \"frames\": %i, \"ops\": %i, \"ns_per_op\": %.1f, \"fps\": %.1f, \"allocs_per_frame\": %s }%s\n",
+            results[i].name, results[i].frames, results[i].ops,
+            (results[i].ops)?sec*1000000000.0/results[i].ops:0.0,
+            (sec > 0)?results[i].frames/sec:0.0,
+            allocStr,
+            (i+1 < numResults)?",":"" );
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+static int benchSetup()
+{
+  //Nothing is shown or heard, but everything is drawn and mixed like in the game.
+  SDL_setenv( "SDL_VIDEODRIVER", "dummy", 1 );
+  SDL_setenv( "SDL_AUDIODRIVER", "disk", 1 );
+  SDL_setenv( "SDL_DISKAUDIOFILE", "/dev/null", 1 );
+  if( SDL_Init( SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER ) < 0 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_Init failed: %s\n", SDL_GetError());
+    return(0);
+  }
+  IMG_Init( IMG_INIT_PNG );
+
+  //The player's settings would make runs differ
+  initSettings();
+  setting()->particles=1;
+  setting()->showFps=0;
+  setting()->uploadStats=0;
+
+  screen = SDL_CreateRGBSurface(0, SCREENW, SCREENH, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+  if( !screen )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: Couldn't create screen: %s\n", SDL_GetError());
+    return(0);
+  }
+
+  if( !initSound() )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "bench: No audio, sound effects are skipped.\n");
+  }
+
+  txtInit();
+  statsInit();
+  packInit();
+  initParticles(screen);
+  initTransition(screen);
+  return(1);
+}
+
+int benchMain(int argc, char** argv)
+{
+  const char* outFile=NULL;
+  int i,s,run=0;
+  FILE* f;
+  #if defined(WANT_MEMTRACK)
+  Uint32 mark;
+  #endif
+
+  while( argc > 0 && argv[0][0]=='-' )
+  {
+    if( strcmp(argv[0], "-o")==0 && argc > 1 )
+    {
+      outFile=argv[1];
+    } else if( strcmp(argv[0], "-n")==0 && argc > 1 && atoi(argv[1]) > 0 )
+    {
+      frames=atoi(argv[1]);
+    } else {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Usage: -bench [-o file.json] [-n frames] [scenario ...]\n");
+      return(-1);
+    }
+    argc-=2;
+    argv+=2;
+  }
+
+  for(i=0; i < argc; i++)
+  {
+    for(s=0; scenarios[s].name && strcmp(scenarios[s].name, argv[i]); s++);
+    if( !scenarios[s].name )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: No scenario named '%s'.\n", argv[i]);
+      return(-1);
+    }
+  }
+
+  if( !benchSetup() )
+  {
+    SDL_Quit();
+    return(-1);
+  }
+
+  #if defined(WANT_MEMTRACK)
+  mark=memMark();
+  #endif
+
+  for(s=0; scenarios[s].name; s++)
+  {
+    for(i=0; i < argc && strcmp(scenarios[s].name, argv[i]); i++);
+    if( argc && i == argc )
+      continue;
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "bench: Running %s.\n", scenarios[s].name);
+    scenarios[s].run();
+    run++;
+  }
+
+  //What the scenarios left behind, and who allocates while they run
+  #if defined(WANT_MEMTRACK)
+  memReport("bench", mark);
+  memReportSites();
+  #endif
+
+  f = (outFile)?fopen(outFile, "w"):stdout;
+  if( !f )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "bench: Couldn't open '%s' for writing.\n", outFile);
+  } else {
+    benchWrite(f);
+    if( outFile )
+      fclose(f);
+  }
+
+  statsFlush();
+  SDL_FreeSurface(screen);
+  Mix_CloseAudio();
+  IMG_Quit();
+  SDL_Quit();
+  return( (f && run && !failed)?0:-1 );
+}
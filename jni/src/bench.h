@@ -0,0 +1,69 @@
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+#include <SDL.h>
+
+//Benchmark runner for catching performance regressions before a release. Scenarios run
+//headless on SDL's dummy video and disk audio drivers, with a fixed frame time and seed,
+//so two runs of the same build do the same work. Results are written as JSON.
+
+//Frames run by each scenario, the sim scenario runs this many on every level.
+#ifndef BENCH_FRAMES
+  #define BENCH_FRAMES 500
+#endif
+
+//Milliseconds each frame takes as far as the game can tell.
+#ifndef BENCH_TICK_MS
+  #define BENCH_TICK_MS 20
+#endif
+
+#ifndef BENCH_SEED
+  #define BENCH_SEED 1234
+#endif
+
+//Frames between the scripted brick moves in the sim scenario.
+#ifndef BENCH_MOVE_FRAMES
+  #define BENCH_MOVE_FRAMES 8
+#endif
+
+//Particle systems spawned each frame of the storm.
+#ifndef BENCH_STORM_SYSTEMS
+  #define BENCH_STORM_SYSTEMS 8
+#endif
+
+//Strings drawn each frame of the text scenarios.
+#ifndef BENCH_TEXT_LINES
+  #define BENCH_TEXT_LINES 16
+#endif
+
+#ifndef BENCH_TRANSITION_MS
+  #define BENCH_TRANSITION_MS 1000
+#endif
+
+#ifndef BENCH_SWSCALE_MAX
+  #define BENCH_SWSCALE_MAX 4
+#endif
+
+#define BENCH_MAX_RESULTS 32
+
+//-bench [-o file.json] [-n frames] [scenario ...], all scenarios when none are named.
+//JSON goes to stdout without -o. Ret 0 on success.
+int benchMain(int argc, char** argv);
+
+#endif // BENCH_H_INCLUDED
@@ -26,6 +26,7 @@
 #include "draw.h"
 #include "input.h"
 #include "platform/androidUtils.h"
+#include "levelbin.h"
 
 int isWall(playField* pf, int x, int y)
 {
@@ -130,80 +131,44 @@ void queueBrickRemoval(playField* pf,int x,int y)
   }
 }
 
-int loadField(playField* pf, const char* file)
+int loadFieldCells(const char* file, uint8_t cells[FIELDSIZE][FIELDSIZE])
 {
-  FILE *f = android_fopen(file, "r");
-  if(f == NULL) {
-	  f = fopen(file, "r");
-  }
-  if(!f)
+  //The level file is parsed in one pass, the info is not needed here.
+  levelInfo_t* li = mkLevelInfoCells(file, cells);
+  if(!li)
   {
-	SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "%s %i Board: couldn't open '%s'\n",__FILE__,__LINE__,file);
+	SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "%s %i Board: couldn't load '%s'\n",__FILE__,__LINE__,file);
     return(0);
   }
+  freeLevelInfo(&li);
+  return(1);
+}
 
-  char temp[32];
-  int type=0;
+//Bricks from cells, and the lists. pf->levelInfo must be set.
+static int initField(playField* pf, uint8_t cells[FIELDSIZE][FIELDSIZE])
+{
+  int x,y;
 
   memset( pf->brickTypes, 0,sizeof(pf->brickTypes) );
 
-  //For atoi hack
-  temp[2] = '\0';
-
-  //Fast forward to the interesting section.
-  while( fgets( temp,32, f) )
+  for(y=0; y < FIELDSIZE; y++)
   {
-    stripNewLine( temp);
-    if(strcmp("[data]", temp)==0)
-    {
-      break;
-    }
-  }
-  //For checking that level var correctly loaded
-  //Read each byte into the field
-  int c=0,x=0,y=0;
-
-  do {
-    c = fgetc(f);
-    temp[0]=c;
-
-    if(c=='\n')
-    {
-        y++;
-        x=0;
-        if(y == FIELDSIZE)
-        {
-          break;
-        }
-    } else if(c=='\r')
+    for(x=0; x < FIELDSIZE; x++)
     {
-      //Ignore windows wanting to run on a typewriter.
-    } else {
-      if(x==FIELDSIZE) { 
-		SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Error loading level, bail before accesing invalid index");
-		return(0); 
-	  } //Error loading level, bail before accesing invalid index.
-
-      temp[1]=fgetc(f);
-      type=atoi(temp);
-
-      if(type !=0)
+      if(cells[x][y] != 0)
       {
-        newBrick(pf,x,y,type);
+        newBrick(pf,x,y,cells[x][y]);
       } else {
         pf->board[x][y] = 0;
       }
-      x++;
     }
+  }
 
-  } while( c != EOF );
-
-  //Close the file
-  fclose(f);
-
-  pf->movingList = listInit(NULL);
-  pf->removeList = listInit(NULL);
-  pf->deactivated = listInit(NULL);
+  //Per field pool, so fields can be simulated on different threads.
+  pf->listPool = listPoolInit();
+  pf->movingList = listInitPooled(NULL, pf->listPool);
+  pf->removeList = listInitPooled(NULL, pf->listPool);
+  pf->deactivated = listInitPooled(NULL, pf->listPool);
 
   pf->blocker = malloc(sizeof(brickType));
   pf->blocker->type=RESERVED;
@@ -219,6 +184,40 @@ int loadField(playField* pf, const char* file)
   return(1);
 }
 
+int loadField(playField* pf, const char* file)
+{
+  uint8_t cells[FIELDSIZE][FIELDSIZE];
+  if( !loadFieldCells(file, cells) )
+  {
+    return(0);
+  }
+  return( initField(pf, cells) );
+}
+
+int loadLevel(playField* pf, const char* file)
+{
+  uint8_t cells[FIELDSIZE][FIELDSIZE];
+  pf->levelInfo = levelBinLoad(file, cells);
+  if( !pf->levelInfo )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s %i Board: couldn't load '%s'\n",__FILE__,__LINE__,file);
+    return(0);
+  }
+  return( initField(pf, cells) );
+}
+
+int loadLevelWzp(playField* pf, const char* file)
+{
+  uint8_t cells[FIELDSIZE][FIELDSIZE];
+  pf->levelInfo = mkLevelInfoCells(file, cells);
+  if( !pf->levelInfo )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s %i Board: couldn't load '%s'\n",__FILE__,__LINE__,file);
+    return(0);
+  }
+  return( initField(pf, cells) );
+}
+
 void freeField(playField* pf)
 {
   int x,y;
@@ -243,6 +242,8 @@ void freeField(playField* pf)
   listFree(pf->movingList);
   listFree(pf->removeList);
   listFree(pf->deactivated);
+  listPoolDebugShow(pf->listPool, "board");
+  listPoolFree(pf->listPool);
 }
 
 int moveBrick(playField* pf, int x, int y, int dirx, int diry, int block, int speed)
@@ -1234,6 +1235,9 @@ int saveLevel(const char* fileName, playField* pf)
   fputc('\n',f);
   fclose(f);
 
+  //The compiled level is stale now
+  levelBinInvalidate(fileName);
+
   return(1);
 }
 
@@ -1254,18 +1258,12 @@ int isLevelCompletable(const char* fileName)
 void setLevelCompletable(const char* fileName, int_fast8_t completable)
 {
   playField pf;
-  pf.levelInfo = mkLevelInfo( fileName );
-  if( pf.levelInfo )
+  if( loadLevelWzp(&pf, fileName) )
   {
-
-    if( loadField(&pf, fileName) )
-    {
-      pf.levelInfo->completable=completable;
-      saveLevel(fileName, &pf);
-      freeField( &pf );
-    }
+    pf.levelInfo->completable=completable;
+    saveLevel(fileName, &pf);
+    freeField( &pf );
     freeLevelInfo( &(pf.levelInfo) );
-
   }
 
 }
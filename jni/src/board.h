@@ -69,12 +69,17 @@ struct playField_t
   list_t* removeList; //Start of the linked list of bricks that's going to die, tl counts down their lifespan
   int_fast8_t newWalls; //Used to indicate that walls have changed on this board.
 
+  listPool_t* listPool; //Nodes for the lists above, so moving and dying bricks don't malloc
+
 };
 
 typedef struct playField_t playField;
 
 void boardSetWalls(playField* pf);
 int loadField(playField* pf, const char* file); //Henter et spillefelt med filnavnet, retunerer 0 ved fejl.
+int loadLevel(playField* pf, const char* file); //mkLevelInfo() and loadField() in one, from the compiled level (levelbin.h) when it's up to date.
+int loadLevelWzp(playField* pf, const char* file); //Like loadLevel(), but parses the level file in one pass and leaves the compiled one alone.
+int loadFieldCells(const char* file, uint8_t cells[FIELDSIZE][FIELDSIZE]); //Brick type of each cell of a level file, ret 0 on error.
 void freeField(playField* pf); //Frees allocated memory
 void simField(playField* pf, cursorType* cur); //Does logic on the field (gravity/moving bricks)
 int doRules(playField* pf); //Does gameRules, returns number of bricks destroyed, returns -1 when no more bricks left.
@@ -21,10 +21,12 @@
 #include <sys/stat.h>
 #include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 #include "bundle.h"
 #include "list/list.h"
 #include <SDL.h>
 #include "platform/androidUtils.h"
+#include "../SDL2_image/miniz.h"
 
 #define bundleFileIdentString "<WizznicBundle>"
 #define bundleFileEndMarkString "</WizznicBundle>"
@@ -40,6 +42,9 @@ static int debugTestSwapBytes=0;
 #define TYPE_FILE 1
 #define TYPE_DIR 2
 
+#define METHOD_STORED 0
+#define METHOD_DEFLATE 1
+
 #pragma pack(push, 1)
 typedef struct {
     char ident[16]; // 15 characters + one 0 terminator
@@ -54,16 +59,46 @@ typedef struct {
     uint32_t dataLen;
     uint16_t nameLen;
 } bundleFileEntry;
+
+//Version 0x12 entry, the name is at dataOffset, followed by dataLen bytes of (compressed) data.
+typedef struct {
+    uint8_t type;
+    uint8_t method; //METHOD_*
+    uint32_t dataOffset;
+    uint32_t dataLen; //Size in the bundle
+    uint32_t origLen; //Size when extracted
+    uint32_t crc; //CRC32 of the extracted data
+    uint16_t nameLen;
+} bundleFileEntry12;
 #pragma pack(pop)
 
 typedef struct {
     uint8_t type;
     char name[1024];
-    uint32_t dataOffset;
-    uint32_t dataSize; //Actual size + filename
-    void* data;
+    uint32_t dataSize; //Size of the file when it was scanned
 } entity;
 
+//A chunk of file data on its way to the deflater
+typedef struct {
+    uint8_t* data;
+    uint32_t len;
+    uint8_t last; //Last chunk of the file
+    uint8_t err; //The file could not be read, also the last chunk
+} bundleChunk_t;
+
+//State used while streaming the files of a bundle into the output
+typedef struct {
+    list_t* entries;
+    bundleChunk_t* chunk; //Ring of BUNDLE_READAHEAD chunks (one when reading without a thread)
+    int slot; //Next chunk to be deflated
+    SDL_sem* free; //Chunks the reader may fill
+    SDL_sem* full; //Chunks ready to be deflated
+    SDL_atomic_t stop;
+    SDL_Thread* thread;
+    tdefl_compressor* deflator;
+    uint8_t* out;
+} bundleStream_t;
+
 uint16_t uswap16(uint16_t in)
 {
   return( ((in & 0xFF00u)>>8) | ((in & 0x00FFu)<<8) );
@@ -87,26 +122,45 @@ void swapBundleEntry(bundleFileEntry* be)
   be->nameLen = uswap16(be->nameLen);
 }
 
+void swapBundleEntry12(bundleFileEntry12* be)
+{
+  be->dataOffset = uswap32(be->dataOffset);
+  be->dataLen = uswap32(be->dataLen);
+  be->origLen = uswap32(be->origLen);
+  be->crc = uswap32(be->crc);
+  be->nameLen = uswap16(be->nameLen);
+}
+
+//Bundles are read from the apk or the filesystem
+static FILE* bundleOpenRead(const char* file)
+{
+  FILE* f = android_fopen( file, "rb" );
+  if(!f)
+    f = fopen( file, "rb" );
+  return(f);
+}
+
+//Only metadata is collected here, the file data is streamed into the bundle later
 int dirScan( const char* dir,int type, list_t* list )
 {
   entity* fe;
-  FILE* f;
   struct dirent *pent;
   struct stat st;
-  char* buf=malloc(sizeof(char)*2048);
+  char buf[2048];
+  int ret=1;
   DIR *pdir= opendir( dir );
 
   if(pdir)
   {
-    while( (pent=readdir(pdir)) )
+    while( ret && (pent=readdir(pdir)) )
     {
       //We're not going to read hidden files or . / ..
       if(pent->d_name[0] != '.')
       {
-        sprintf(buf, "%s/%s",dir,pent->d_name);
+        snprintf(buf, sizeof(buf), "%s/%s",dir,pent->d_name);
         if(stat(buf, &st)==0)
         {
-          if( (st.st_mode&S_IFDIR)==S_IFDIR )
+          if( S_ISDIR(st.st_mode) )
           {
             if( type==TYPE_DIR)
             {
@@ -118,48 +172,31 @@ int dirScan( const char* dir,int type, list_t* list )
               listAppendData( list, (void*)fe );
             }
 
-            if(!dirScan( buf, type, list ))
-            {
-              return(0);
-            }
-          } else if( (st.st_mode&&S_IFREG))
+            ret = dirScan( buf, type, list );
+          } else if( S_ISREG(st.st_mode) )
           {
             if( type== TYPE_FILE )
             {
               fe = malloc( sizeof( entity ) );
               fe->type=TYPE_FILE;
+              fe->dataSize = st.st_size;
               strcpy( fe->name, buf );
 
-              f = android_fopen( buf, "rb" );
-              if(!f)
-              {
-                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,"Could not read file %s\n", buf);
-                return(0);
-              }
-
-              fseek(f, 0L, SEEK_END);
-              fe->dataSize = ftell(f);
-              fseek(f, 0L, SEEK_SET);
-
-              fe->data = malloc( fe->dataSize+strlen(fe->name) );
-              strcpy( fe->data, fe->name );
-              if( fread( (void*)(((char*)fe->data)+strlen(fe->name)), fe->dataSize, 1, f ) != 1 )
-              {
-                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not read input data from file '%s'.\n", fe->name);
-                return(0);
-              }
-
               listAppendData( list, (void*)fe );
             }
           } else {
             SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Bundles must only contain directories and regular files.\n");
-            return(0);
+            ret=0;
           }
 
+        } else {
+          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,"Could not stat %s\n", buf);
+          ret=0;
         }
       }
     }
-    return(1);
+    closedir(pdir);
+    return(ret);
   }
   SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,"Could not open directory: %s\n",dir);
   return(0);
@@ -172,6 +209,7 @@ int debundleCreateEntry( bundleFileEntry* fe, const char* fileName, FILE* f )
   void* data=NULL;
   struct stat st;
   FILE* wf=NULL;
+  uint32_t left, n;
 
   //Check if destination exists
   if(stat(fileName,&st) < 0)
@@ -190,21 +228,28 @@ int debundleCreateEntry( bundleFileEntry* fe, const char* fileName, FILE* f )
       }
     } else if( fe->type==TYPE_FILE)
     {
-      data = malloc( fe->dataLen );
-      if( fread( data, fe->dataLen, 1, f) == 1 )
+      //Copy in chunks, so a big file doesn't need a big buffer
+      data = malloc( BUNDLE_CHUNK );
+      wf = fopen( fileName, "wb" );
+      if( wf )
       {
-        wf = android_fopen( fileName, "wb" );
-        if( wf )
+        left = fe->dataLen;
+        while( left && retVal == BUNDLE_SUCCESS )
         {
-          fwrite( data, fe->dataLen, 1, wf );
-        } else {
-          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Could not open file %s for writing.\n", fileName);
-          retVal = BUNDLE_FAIL_NO_WRITE_PERMISSION;
+          n = (left < BUNDLE_CHUNK)?left:BUNDLE_CHUNK;
+          if( fread( data, n, 1, f) == 1 )
+          {
+            fwrite( data, n, 1, wf );
+            left -= n;
+          } else {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Could not get data for '%s'.\n", fileName);
+            retVal = BUNDLE_FAIL_CORRUPT;
+          } //Read file data
         }
       } else {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Could not get data for '%s'.\n", fileName);
-        retVal = BUNDLE_FAIL_CORRUPT;
-      } //Read file data
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Could not open file %s for writing.\n", fileName);
+        retVal = BUNDLE_FAIL_NO_WRITE_PERMISSION;
+      }
     } //Is a file
   } else { //Exists
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: The destination file '%s' already exists.\n", fileName);
@@ -220,6 +265,287 @@ int debundleCreateEntry( bundleFileEntry* fe, const char* fileName, FILE* f )
 }
 
 
+//State shared by the workers extracting a version 0x12 bundle
+typedef struct {
+  const char* file;
+  const char* outDir;
+  bundleFileEntry12* fe;
+  int numEntries;
+  SDL_atomic_t next; //Next entry to take
+  SDL_atomic_t ret; //BUNDLE_SUCCESS until an entry fails
+} debundleJob_t;
+
+//Buffers one worker needs, allocated once per worker
+typedef struct {
+  uint8_t* in;
+  uint8_t* dict; //TINFL_LZ_DICT_SIZE, inflated data wraps around in this
+  tinfl_decompressor* inflator;
+} debundleBufs_t;
+
+//Extract one file entry, streaming it through bufs. f is positioned at the data.
+static int debundleExtract12( bundleFileEntry12* fe, const char* fileName, FILE* f, debundleBufs_t* bufs )
+{
+  FILE* wf;
+  struct stat st;
+  uint32_t inLeft = fe->dataLen, outLen=0;
+  mz_ulong crc = MZ_CRC32_INIT;
+  size_t inAvail=0, inOfs=0, dictOfs=0, inBytes, outBytes, n;
+  tinfl_status status;
+  int ret = BUNDLE_SUCCESS;
+
+  if( stat(fileName, &st) == 0 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: The destination file '%s' already exists.\n", fileName);
+    return(BUNDLE_FAIL_DIR_EXISTS);
+  }
+
+  wf = fopen( fileName, "wb" );
+  if( !wf )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Could not open file %s for writing.\n", fileName);
+    return(BUNDLE_FAIL_NO_WRITE_PERMISSION);
+  }
+
+  if( fe->method == METHOD_STORED )
+  {
+    while( inLeft && ret == BUNDLE_SUCCESS )
+    {
+      n = (inLeft < BUNDLE_CHUNK)?inLeft:BUNDLE_CHUNK;
+      if( fread( bufs->in, n, 1, f ) == 1 )
+      {
+        crc = mz_crc32( crc, bufs->in, n );
+        fwrite( bufs->in, n, 1, wf );
+        inLeft -= n;
+        outLen += n;
+      } else {
+        ret = BUNDLE_FAIL_CORRUPT;
+      }
+    }
+  } else {
+    tinfl_init( bufs->inflator );
+    while( ret == BUNDLE_SUCCESS )
+    {
+      //Refill the input chunk
+      if( inAvail == 0 && inLeft )
+      {
+        n = (inLeft < BUNDLE_CHUNK)?inLeft:BUNDLE_CHUNK;
+        if( fread( bufs->in, n, 1, f ) != 1 )
+        {
+          ret = BUNDLE_FAIL_CORRUPT;
+          break;
+        }
+        inAvail = n;
+        inOfs = 0;
+        inLeft -= n;
+      }
+
+      inBytes = inAvail;
+      outBytes = TINFL_LZ_DICT_SIZE - dictOfs;
+      status = tinfl_decompress( bufs->inflator, bufs->in+inOfs, &inBytes, bufs->dict, bufs->dict+dictOfs, &outBytes, (inLeft)?TINFL_FLAG_HAS_MORE_INPUT:0 );
+      inAvail -= inBytes;
+      inOfs += inBytes;
+
+      if( outBytes )
+      {
+        crc = mz_crc32( crc, bufs->dict+dictOfs, outBytes );
+        fwrite( bufs->dict+dictOfs, outBytes, 1, wf );
+        outLen += outBytes;
+        dictOfs = (dictOfs+outBytes) & (TINFL_LZ_DICT_SIZE-1);
+      }
+
+      if( status == TINFL_STATUS_DONE )
+        break;
+      if( status < TINFL_STATUS_DONE || (status == TINFL_STATUS_NEEDS_MORE_INPUT && !inLeft && !inAvail) )
+        ret = BUNDLE_FAIL_CORRUPT;
+    }
+  }
+
+  fclose(wf);
+
+  if( ret == BUNDLE_SUCCESS && (outLen != fe->origLen || (uint32_t)crc != fe->crc) )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Checksum mismatch for '%s'.\n", fileName);
+    ret = BUNDLE_FAIL_CORRUPT;
+  }
+
+  if( ret == BUNDLE_FAIL_CORRUPT )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Could not get data for '%s'.\n", fileName);
+    unlink( fileName );
+  }
+
+  return(ret);
+}
+
+//Read the name at fe->dataOffset and prepend outDir, leaves f at the data.
+static int debundleName12( bundleFileEntry12* fe, FILE* f, const char* outDir, char* buf )
+{
+  char name[1024];
+
+  if( fe->nameLen >= sizeof(name) || fseek( f, fe->dataOffset, SEEK_SET ) != 0 || fread( name, fe->nameLen, 1, f ) != 1 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "  ERROR: Could not read a filename from bundlefile.\n");
+    return(0);
+  }
+  name[fe->nameLen]=0;
+  sprintf(buf, "%s/%s", outDir, name );
+  return(1);
+}
+
+static int debundleWorker( void* data )
+{
+  debundleJob_t* job = (debundleJob_t*)data;
+  debundleBufs_t bufs;
+  char fileName[2048];
+  FILE* f;
+  int i, ret=BUNDLE_SUCCESS;
+
+  bufs.in = malloc( BUNDLE_CHUNK );
+  bufs.dict = malloc( TINFL_LZ_DICT_SIZE );
+  bufs.inflator = malloc( sizeof(tinfl_decompressor) );
+  f = bundleOpenRead( job->file );
+
+  if( !bufs.in || !bufs.dict || !bufs.inflator || !f )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "debundleWorker(); Could not get buffers or open '%s'.\n", job->file);
+    SDL_AtomicCAS( &job->ret, BUNDLE_SUCCESS, BUNDLE_FAIL_COULD_NOT_OPEN );
+  } else {
+    //Take entries until they are all done, or one failed
+    while( SDL_AtomicGet( &job->ret ) == BUNDLE_SUCCESS )
+    {
+      i = SDL_AtomicAdd( &job->next, 1 );
+      if( i >= job->numEntries )
+        break;
+
+      if( job->fe[i].type != TYPE_FILE )
+        continue;
+
+      if( !debundleName12( &job->fe[i], f, job->outDir, fileName ) )
+        ret = BUNDLE_FAIL_CORRUPT;
+      else
+        ret = debundleExtract12( &job->fe[i], fileName, f, &bufs );
+
+      if( ret != BUNDLE_SUCCESS )
+        SDL_AtomicCAS( &job->ret, BUNDLE_SUCCESS, ret );
+    }
+  }
+
+  if( f ) { fclose(f); }
+  free( bufs.in );
+  free( bufs.dict );
+  free( bufs.inflator );
+  return(0);
+}
+
+//Directories are created in order first, then files are extracted by BUNDLE_WORKERS threads.
+static int debundle12( FILE* f, const char* file, bundleHeader_t* header, uint_fast8_t swapBytes, const char* outDir )
+{
+  int i, ret=BUNDLE_SUCCESS;
+  uint32_t end=0;
+  char buf[2048];
+  struct stat st;
+  debundleJob_t job;
+  SDL_Thread* workers[BUNDLE_WORKERS];
+  bundleFileEntry12* fe = malloc( sizeof(bundleFileEntry12)*header->numEntries );
+
+  if( fread( fe, sizeof(bundleFileEntry12), header->numEntries, f ) != header->numEntries )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Could not read %i entries from file.\n", header->numEntries);
+    free(fe);
+    return(BUNDLE_FAIL_CORRUPT);
+  }
+
+  for( i=0; i < header->numEntries && ret == BUNDLE_SUCCESS; i++ )
+  {
+    if(swapBytes)
+    {
+      swapBundleEntry12(&fe[i]);
+    }
+
+    //Verify that type and method are sane
+    if( (fe[i].type != TYPE_DIR && fe[i].type != TYPE_FILE) || fe[i].method > METHOD_DEFLATE )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Entry %i has an unknown type or method.\n", i);
+      ret = BUNDLE_FAIL_CORRUPT;
+    }
+
+    if( fe[i].dataOffset+fe[i].nameLen+fe[i].dataLen > end )
+    {
+      end = fe[i].dataOffset+fe[i].nameLen+fe[i].dataLen;
+    }
+
+    if( ret == BUNDLE_SUCCESS && fe[i].type == TYPE_DIR )
+    {
+      if( !debundleName12( &fe[i], f, outDir, buf ) )
+      {
+        ret = BUNDLE_FAIL_CORRUPT;
+      } else if( stat(buf, &st) == 0 )
+      {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: The destination file '%s' already exists.\n", buf);
+        ret = BUNDLE_FAIL_DIR_EXISTS;
+      } else
+#ifdef WIN32
+      if( mkdir( buf ) != 0 )
+#else
+      if( mkdir( buf,S_IRWXU ) != 0 )
+#endif
+      {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Could not create directory '%s'\n", buf);
+        ret = BUNDLE_FAIL_NO_WRITE_PERMISSION;
+      } else if( lastExtractedBundle == NULL )
+      {
+        //Hack: We assume that the first entry to be debundled is the topdirectory.
+        lastExtractedBundle = malloc( strlen(buf)+1 );
+        sprintf(lastExtractedBundle, "%s", buf );
+        //Hack2: Wizznic does not expect / at the end of the packdir.
+        if( lastExtractedBundle[ strlen(lastExtractedBundle)-1 ] == '/' )
+        {
+          lastExtractedBundle[ strlen(lastExtractedBundle)-1 ]=0;
+        }
+      }
+    }
+  }
+
+  //Check for the end marker before spending time on the files
+  if( ret == BUNDLE_SUCCESS )
+  {
+    memset( buf, 0, strlen(bundleFileEndMarkString)+1 );
+    if( fseek( f, end, SEEK_SET ) != 0 || fread(buf, strlen(bundleFileEndMarkString), 1, f) != 1 || strcmp(buf, bundleFileEndMarkString) != 0 )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Could not read end of file marker.\n");
+      ret = BUNDLE_FAIL_CORRUPT;
+    }
+  }
+
+  if( ret == BUNDLE_SUCCESS )
+  {
+    job.file = file;
+    job.outDir = outDir;
+    job.fe = fe;
+    job.numEntries = header->numEntries;
+    SDL_AtomicSet( &job.next, 0 );
+    SDL_AtomicSet( &job.ret, BUNDLE_SUCCESS );
+
+    for( i=0; i < BUNDLE_WORKERS; i++ )
+    {
+      workers[i] = SDL_CreateThread( debundleWorker, "debundle", (void*)&job );
+    }
+
+    //If no thread could be started, do the work here
+    debundleWorker( (void*)&job );
+
+    for( i=0; i < BUNDLE_WORKERS; i++ )
+    {
+      if( workers[i] )
+        SDL_WaitThread( workers[i], NULL );
+    }
+
+    ret = SDL_AtomicGet( &job.ret );
+  }
+
+  free(fe);
+  return(ret);
+}
 
 int debundle( const char* file, const char* outDir )
 {
@@ -237,7 +563,7 @@ int debundle( const char* file, const char* outDir )
   bundleFileEntry* fe=NULL;
 
   //Open file
-  f = android_fopen( file, "rb");
+  f = bundleOpenRead( file );
   if(f)
   {
     //Read header
@@ -246,7 +572,6 @@ int debundle( const char* file, const char* outDir )
       //Verify it's a bundle
       if( strcmp(header.ident, bundleFileIdentString) == 0 )
       {
-        //This code reads version 0x11 bundles.
         if( header.version == BUNDLE_FILE_VERSION )
         {
           if( header.byteOrderTest == 0xFF00 )
@@ -258,6 +583,20 @@ int debundle( const char* file, const char* outDir )
             swapBytes = 1;
           }
 
+          ret = debundle12( f, file, &header, swapBytes, outDir );
+        } else
+        //This code reads version 0x11 bundles.
+        if( header.version == BUNDLE_FILE_VERSION_11 )
+        {
+          if( header.byteOrderTest == 0xFF00 )
+          {
+            swapBytes = 0;
+          } else {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Bundle has opposite byte-order, converting.\n");
+            swapBundleHeader(&header);
+            swapBytes = 1;
+          }
+
           fe = malloc( sizeof(bundleFileEntry)* header.numEntries );
 
           // Read all the entries into an array
@@ -357,15 +696,224 @@ int debundle( const char* file, const char* outDir )
 
 
 
+//Read the next chunk of a file, a NULL f gives an error chunk.
+static void bundleReadChunk( FILE* f, bundleChunk_t* c )
+{
+  c->len=0;
+  c->err=1;
+  c->last=1;
+  if(f)
+  {
+    c->len = fread( c->data, 1, BUNDLE_CHUNK, f );
+    c->err = (ferror(f)!=0);
+    c->last = (c->len < BUNDLE_CHUNK || c->err);
+  }
+}
+
+//Reads the files in the entry list, in order, into the ring of chunks ahead of the deflater.
+static int bundleReadAhead( void* data )
+{
+  bundleStream_t* s = (bundleStream_t*)data;
+  listItem* it=&s->entries->begin;
+  bundleChunk_t* c;
+  entity* e;
+  FILE* f;
+  int slot=0;
+
+  while( LISTFWD(s->entries,it) )
+  {
+    e = (entity*)it->data;
+    if( e->type != TYPE_FILE )
+      continue;
+
+    f = fopen( e->name, "rb" );
+    do
+    {
+      SDL_SemWait( s->free );
+      if( SDL_AtomicGet(&s->stop) )
+      {
+        if(f)
+          fclose(f);
+        return(0);
+      }
+      c = &s->chunk[slot];
+      bundleReadChunk( f, c );
+      SDL_SemPost( s->full );
+      slot = (slot+1)%BUNDLE_READAHEAD;
+    } while( !c->last );
+
+    if(f)
+      fclose(f);
+  }
+  return(0);
+}
+
+static int bundleStreamInit( bundleStream_t* s, list_t* entries )
+{
+  int i, num=(BUNDLE_READAHEAD>1)?BUNDLE_READAHEAD:1;
+  memset( s, 0, sizeof(bundleStream_t) );
+  s->entries = entries;
+  s->deflator = malloc( sizeof(tdefl_compressor) );
+  s->out = malloc( BUNDLE_CHUNK );
+  s->chunk = calloc( num, sizeof(bundleChunk_t) );
+  if( !s->deflator || !s->out || !s->chunk )
+    return(0);
+
+  for(i=0; i < num; i++)
+  {
+    s->chunk[i].data = malloc( BUNDLE_CHUNK );
+    if( !s->chunk[i].data )
+      return(0);
+  }
+
+  //Without a reader thread, the files are read by the thread writing the bundle
+  if( BUNDLE_READAHEAD > 1 )
+  {
+    SDL_AtomicSet( &s->stop, 0 );
+    s->free = SDL_CreateSemaphore( BUNDLE_READAHEAD );
+    s->full = SDL_CreateSemaphore( 0 );
+    if( s->free && s->full )
+      s->thread = SDL_CreateThread( bundleReadAhead, "bundleReadAhead", (void*)s );
+    if( !s->thread )
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Could not start read-ahead thread, reading files directly.\n");
+  }
+  return(1);
+}
+
+static void bundleStreamFree( bundleStream_t* s )
+{
+  int i;
+  if( s->thread )
+  {
+    //Wake the reader if it's waiting for a free chunk
+    SDL_AtomicSet( &s->stop, 1 );
+    SDL_SemPost( s->free );
+    SDL_WaitThread( s->thread, NULL );
+  }
+  if( s->free )
+    SDL_DestroySemaphore( s->free );
+  if( s->full )
+    SDL_DestroySemaphore( s->full );
+  if( s->chunk )
+  {
+    for(i=0; i < ((BUNDLE_READAHEAD>1)?BUNDLE_READAHEAD:1); i++)
+      free( s->chunk[i].data );
+    free( s->chunk );
+  }
+  free( s->deflator );
+  free( s->out );
+}
+
+//Get the next chunk of the file being bundled, from the read-ahead ring or directly from in.
+static bundleChunk_t* bundleGetChunk( bundleStream_t* s, FILE* in )
+{
+  if( !s->thread )
+  {
+    bundleReadChunk( in, &s->chunk[0] );
+    return( &s->chunk[0] );
+  }
+  SDL_SemWait( s->full );
+  return( &s->chunk[s->slot] );
+}
+
+static void bundleReleaseChunk( bundleStream_t* s )
+{
+  if( s->thread )
+  {
+    s->slot = (s->slot+1)%BUNDLE_READAHEAD;
+    SDL_SemPost( s->free );
+  }
+}
+
+//Stream the file e through the deflater into f. Returns the number of bytes written, or -1 on error.
+static long bundleDeflateFile( bundleStream_t* s, entity* e, FILE* f, uint32_t* origLen, uint32_t* crc )
+{
+  FILE* in=NULL;
+  bundleChunk_t* c;
+  size_t inBytes, outBytes;
+  uint32_t pos;
+  long written=0;
+  int last, ok=1;
+  tdefl_flush flush;
+  tdefl_status status=TDEFL_STATUS_OKAY;
+
+  *origLen=0;
+  *crc=MZ_CRC32_INIT;
+
+  if( tdefl_init( s->deflator, NULL, NULL, BUNDLE_DEFLATE_PROBES ) != TDEFL_STATUS_OKAY )
+    ok=0;
+
+  if( !s->thread )
+    in = fopen( e->name, "rb" );
+
+  //The reader always delivers the file up to its last chunk, even when we stop deflating.
+  do
+  {
+    c = bundleGetChunk( s, in );
+    last = c->last;
+
+    if( c->err )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not read input data from file '%s'.\n", e->name);
+      ok=0;
+    }
+
+    if( ok )
+    {
+      *crc = mz_crc32( *crc, c->data, c->len );
+      *origLen += c->len;
+
+      flush = (last)?TDEFL_FINISH:TDEFL_NO_FLUSH;
+      pos=0;
+      do
+      {
+        inBytes = c->len-pos;
+        outBytes = BUNDLE_CHUNK;
+        status = tdefl_compress( s->deflator, c->data+pos, &inBytes, s->out, &outBytes, flush );
+        pos += inBytes;
+        if( outBytes )
+        {
+          if( fwrite( s->out, outBytes, 1, f ) != 1 )
+            status = TDEFL_STATUS_PUT_BUF_FAILED;
+          written += outBytes;
+        }
+      } while( status == TDEFL_STATUS_OKAY && (flush==TDEFL_FINISH || pos < c->len || outBytes == BUNDLE_CHUNK) );
+
+      if( status < 0 || (last && status != TDEFL_STATUS_DONE) )
+      {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not compress %s\n", e->name);
+        ok=0;
+      }
+    }
+
+    bundleReleaseChunk( s );
+  } while( !last );
+
+  if(in)
+    fclose(in);
+
+  if( ok && *origLen != e->dataSize )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "File %s changed size while bundling (%u -> %u bytes).\n", e->name, e->dataSize, *origLen);
+  }
+
+  return( (ok)?written:-1 );
+}
+
+//Bundles are written in two passes, first the directory tree is scanned for names and sizes,
+//then the file data is streamed through fixed buffers, so memory use does not depend on the size of the pack.
 void bundle( const char* file, const char* inDir)
 {
   FILE* f;
   entity* e;
-  list_t* entryList = listInit(NULL);
+  list_t* entryList = listInit(free);
   listItem* it=&entryList->begin;
   bundleHeader_t header;
-  bundleFileEntry* be;
+  bundleFileEntry12* be=NULL;
+  bundleStream_t stream;
   uint32_t dataOffset=0;
+  long packed;
+  int i, ok=1;
   header.version = BUNDLE_FILE_VERSION;
   header.byteOrderTest = 0xFF00;
   sprintf( header.ident, "%s", bundleFileIdentString );
@@ -373,8 +921,6 @@ void bundle( const char* file, const char* inDir)
   char endMark[] = bundleFileEndMarkString;
 
   e = malloc(sizeof(entity) );
-  e->data=0;
-  e->dataOffset=0;
   e->dataSize=0;
   strcpy( e->name, inDir );
   e->type = TYPE_DIR;
@@ -393,79 +939,96 @@ void bundle( const char* file, const char* inDir)
       header.numEntries = entryList->count;
       SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "There are now %i entries.\n", header.numEntries);
       //First dataoffset is after the list of all entries
-      dataOffset = sizeof(bundleHeader_t) + (sizeof(bundleFileEntry)*header.numEntries);
+      dataOffset = sizeof(bundleHeader_t) + (sizeof(bundleFileEntry12)*header.numEntries);
 
 
       SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Bundling...\n");
 
-      f = android_fopen( file, "wb" );
+      memset( &stream, 0, sizeof(bundleStream_t) );
+      f = fopen( file, "wb" );
 
-      if(f)
+      be = malloc( sizeof(bundleFileEntry12)*header.numEntries );
+
+      if(f && be && bundleStreamInit( &stream, entryList ) )
       {
+        memset( be, 0, sizeof(bundleFileEntry12)*header.numEntries );
+
+        //Write header, and room for the entries, they are filled in when the compressed sizes are known
         if(debugTestSwapBytes)
         {
           swapBundleHeader(&header);
         }
-
-        //Write header
         fwrite( (void*)(&header), sizeof(bundleHeader_t),1, f );
+        fwrite( (void*)be, sizeof(bundleFileEntry12), entryList->count, f );
 
-        //Write entries
-        while( LISTFWD(entryList,it) )
+        //Write names and file data
+        i=0;
+        while( LISTFWD(entryList,it) && ok )
         {
           e = (entity*)it->data;
-          be = malloc( sizeof(bundleFileEntry) );
-          be->type = e->type;
-          be->nameLen = strlen( e->name );
-
-          be->dataOffset = dataOffset;
-          be->dataLen = e->dataSize;
-          dataOffset += be->dataLen+be->nameLen;
-
-          if(debugTestSwapBytes)
-          {
-            swapBundleEntry(be);
-          }
-
-
-          fwrite( (void*)be, sizeof(bundleFileEntry), 1, f );
-
+          be[i].type = e->type;
+          be[i].nameLen = strlen( e->name );
+          be[i].dataOffset = dataOffset;
 
-          free(be);
-        }
+          fwrite( e->name, be[i].nameLen, 1, f);
 
-        it=&entryList->begin;
-        //Write file data
-        while( LISTFWD(entryList,it) )
-        {
-          e = (entity*)it->data;
-          //Write file-name
           if( e->type == TYPE_DIR )
           {
-            fwrite( e->name, strlen(e->name), 1, f);
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Added Dir: %s\n", e->name);
           }
           //If it's a file, write content
           if( e->type == TYPE_FILE )
           {
-            fwrite( e->data, e->dataSize+strlen(e->name), 1, f);
-            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Added File: %s\n", e->name);
+            be[i].method = METHOD_DEFLATE;
+            packed = bundleDeflateFile( &stream, e, f, &be[i].origLen, &be[i].crc );
+            if( packed < 0 )
+            {
+              ok=0;
+            }
+            be[i].dataLen = packed;
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Added File: %s (%u -> %u bytes)\n", e->name, be[i].origLen, be[i].dataLen);
           }
+
+          dataOffset += be[i].nameLen+be[i].dataLen;
+          i++;
         }
 
         fwrite( (void*)&endMark, strlen(endMark), 1, f );
 
+        //Now the entries are known
+        if(debugTestSwapBytes)
+        {
+          for(i=0; i < entryList->count; i++)
+          {
+            swapBundleEntry12(&be[i]);
+          }
+        }
+        fseek( f, sizeof(bundleHeader_t), SEEK_SET );
+        fwrite( (void*)be, sizeof(bundleFileEntry12), entryList->count, f );
+
         fclose(f);
 
+        if( !ok )
+        {
+          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Bundling failed, removing %s\n", file);
+          unlink( file );
+        }
+
       } else {
+        if(f)
+          fclose(f);
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Could not open outputfile %s for writing.\n", file);
       }
+      bundleStreamFree( &stream );
+      free(be);
     } else {
       SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "fileScan of %s failed.\n", inDir);
     }
   } else {
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "dirScan of %s failed.\n", inDir);
   }
+
+  listFree( entryList );
 }
 
 //Get a string telling the path to the last extracted bundle (or NULL if no bundle was extracted).
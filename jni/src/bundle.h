@@ -26,7 +26,29 @@
 #define BUNDLE_FAIL_UNSUPPORTED_VERSION 32
 #define BUNDLE_FAIL_NOT_BUNDLEFILE 64
 
-#define BUNDLE_FILE_VERSION 0x11
+//Bundles are written as 0x12 (deflated entries with CRC32), 0x11 (stored) can still be read.
+#define BUNDLE_FILE_VERSION 0x12
+#define BUNDLE_FILE_VERSION_11 0x11
+
+//Size of the chunks files are streamed through when bundling and extracting
+#ifndef BUNDLE_CHUNK
+  #define BUNDLE_CHUNK 16384
+#endif
+
+//Number of threads extracting entries of a 0x12 bundle (the calling thread also helps)
+#ifndef BUNDLE_WORKERS
+  #define BUNDLE_WORKERS 3
+#endif
+
+//Chunks a reader thread keeps ahead of the deflater when bundling, 0 or 1 reads files in the writing thread
+#ifndef BUNDLE_READAHEAD
+  #define BUNDLE_READAHEAD 4
+#endif
+
+//tdefl probes per dictionary search, 128 is the same as zlib level 6
+#ifndef BUNDLE_DEFLATE_PROBES
+  #define BUNDLE_DEFLATE_PROBES 128
+#endif
 
 int debundle( const char* file, const char* outDir );
 void bundle( const char* file, const char* inDir);
@@ -0,0 +1,546 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL_image.h>
+
+#include "capture.h"
+#include "defs.h"
+#include "userfiles.h"
+
+typedef struct {
+  uint8_t* pixels; //Copy of the frame, in the format of the screen
+  int format;
+  int seq; //Sequence id, or -1 for a single shot
+  int frame; //Frame in the sequence
+} captureSlot_t;
+
+static const char* captureExt[] = { "tga", "qoi", "png", "rgb" };
+
+//Ring between the main thread (head) and the encoder (tail)
+static captureSlot_t slots[CAPTURE_RING];
+static int head=0, tail=0;
+static SDL_sem* freeSlots=NULL;
+static SDL_sem* fullSlots=NULL;
+static SDL_Thread* encThread=NULL;
+static SDL_atomic_t quit;
+
+//Geometry of the frames in the ring
+static int capW, capH, capPitch;
+static Uint32 capFmt=0;
+
+//Main thread
+static int shotFormat=-1;
+static int seqFormat=-1;
+static int seqId=0;
+static int seqFrame=0;
+static int seqSkipped=0;
+static Uint32 seqEnd=0;
+
+//Encoder thread
+static char seqName[512];
+static FILE* seqFile=NULL;
+
+void captureTga(uint8_t* out, int w, int h, Uint32 format, const void* pixels, int pitch)
+{
+  //Header, then BGR from the top left corner
+  memset( out, 0, 18 );
+  out[2] = 2;
+  out[12] = w%256;
+  out[13] = w/256;
+  out[14] = h%256;
+  out[15] = h/256;
+  out[16] = 24;
+  out[17] = 32;
+  SDL_ConvertPixels( w, h, format, pixels, pitch, SDL_PIXELFORMAT_BGR24, out+18, w*3 );
+}
+
+static int qoiEncode(const uint8_t* rgb, int w, int h, uint8_t* out)
+{
+  uint8_t index[64][4]; //RGBA like the decoder's, which starts out all zero, not opaque
+  uint8_t pr=0, pg=0, pb=0;
+  int i, n=0, run=0, num=w*h;
+
+  memset( index, 0, sizeof(index) );
+
+  memcpy( out, "qoif", 4 );
+  out[4]=w>>24; out[5]=w>>16; out[6]=w>>8; out[7]=w;
+  out[8]=h>>24; out[9]=h>>16; out[10]=h>>8; out[11]=h;
+  out[12]=3;
+  out[13]=0;
+  n=14;
+
+  for(i=0; i < num; i++, rgb+=3)
+  {
+    if( rgb[0]==pr && rgb[1]==pg && rgb[2]==pb )
+    {
+      run++;
+      if( run==62 || i==num-1 )
+      {
+        out[n++] = 0xc0 | (run-1);
+        run=0;
+      }
+      continue;
+    }
+
+    if( run )
+    {
+      out[n++] = 0xc0 | (run-1);
+      run=0;
+    }
+
+    //Alpha is always 255
+    int hash = (rgb[0]*3 + rgb[1]*5 + rgb[2]*7 + 255*11) % 64;
+    if( index[hash][0]==rgb[0] && index[hash][1]==rgb[1] && index[hash][2]==rgb[2] && index[hash][3]==255 )
+    {
+      out[n++] = hash;
+    } else {
+      int vr = (int8_t)(rgb[0]-pr);
+      int vg = (int8_t)(rgb[1]-pg);
+      int vb = (int8_t)(rgb[2]-pb);
+      int vgr = vr-vg;
+      int vgb = vb-vg;
+
+      memcpy( index[hash], rgb, 3 );
+      index[hash][3]=255;
+      if( vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2 )
+      {
+        out[n++] = 0x40 | (vr+2)<<4 | (vg+2)<<2 | (vb+2);
+      } else if( vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8 )
+      {
+        out[n++] = 0x80 | (vg+32);
+        out[n++] = (vgr+8)<<4 | (vgb+8);
+      } else {
+        out[n++] = 0xfe;
+        out[n++] = rgb[0];
+        out[n++] = rgb[1];
+        out[n++] = rgb[2];
+      }
+    }
+    pr=rgb[0];
+    pg=rgb[1];
+    pb=rgb[2];
+  }
+
+  memset( out+n, 0, 7 );
+  out[n+7]=1;
+  return(n+8);
+}
+
+//Decodes to RGBA the way the spec does, to check qoiEncode against
+static int qoiDecode(const uint8_t* in, int len, uint8_t* rgba, int w, int h)
+{
+  uint8_t index[64][4];
+  uint8_t px[4]={0,0,0,255};
+  int i, b1, b2, vg, p=14, run=0, num=w*h;
+
+  if( len < 22 || memcmp(in, "qoif", 4) ||
+      (in[4]<<24|in[5]<<16|in[6]<<8|in[7]) != w || (in[8]<<24|in[9]<<16|in[10]<<8|in[11]) != h )
+    return(0);
+
+  memset( index, 0, sizeof(index) );
+
+  for(i=0; i < num; i++, rgba+=4)
+  {
+    if( run )
+    {
+      run--;
+    } else {
+      if( p > len-8 )
+        return(0);
+
+      b1=in[p++];
+      if( b1==0xfe )
+      {
+        px[0]=in[p++];
+        px[1]=in[p++];
+        px[2]=in[p++];
+      } else if( b1==0xff )
+      {
+        memcpy( px, in+p, 4 );
+        p+=4;
+      } else if( (b1&0xc0)==0x00 )
+      {
+        memcpy( px, index[b1], 4 );
+      } else if( (b1&0xc0)==0x40 )
+      {
+        px[0] += ((b1>>4)&3)-2;
+        px[1] += ((b1>>2)&3)-2;
+        px[2] += (b1&3)-2;
+      } else if( (b1&0xc0)==0x80 )
+      {
+        b2=in[p++];
+        vg=(b1&0x3f)-32;
+        px[0] += vg-8+((b2>>4)&0xf);
+        px[1] += vg;
+        px[2] += vg-8+(b2&0xf);
+      } else {
+        run=b1&0x3f;
+      }
+      memcpy( index[(px[0]*3+px[1]*5+px[2]*7+px[3]*11)%64], px, 4 );
+    }
+    memcpy( rgba, px, 4 );
+  }
+
+  return(1);
+}
+
+int captureQoiCheck(SDL_Surface* surf)
+{
+  int w=surf->w, h=surf->h;
+  uint8_t* rgb = malloc( w*h*3 );
+  uint8_t* enc = malloc( w*h*4+22 );
+  uint8_t* dec = malloc( w*h*4 );
+  int i, len, ok=0;
+
+  if( rgb && enc && dec &&
+      SDL_ConvertPixels( w, h, surf->format->format, surf->pixels, surf->pitch, SDL_PIXELFORMAT_RGB24, rgb, w*3 )==0 )
+  {
+    len = qoiEncode( rgb, w, h, enc );
+    ok = qoiDecode( enc, len, dec, w, h );
+    for(i=0; ok && i < w*h; i++)
+    {
+      if( memcmp( rgb+i*3, dec+i*4, 3 ) || dec[i*4+3] != 255 )
+      {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "capture: QOI pixel %i,%i is %i,%i,%i,%i after decoding, should be %i,%i,%i,255\n",
+                     i%w, i/w, dec[i*4], dec[i*4+1], dec[i*4+2], dec[i*4+3], rgb[i*3], rgb[i*3+1], rgb[i*3+2]);
+        ok=0;
+      }
+    }
+  }
+
+  free(rgb);
+  free(enc);
+  free(dec);
+  return(ok);
+}
+
+static int captureWrite(const char* fileName, const uint8_t* data, int len)
+{
+  FILE* f = fopen(fileName, "wb");
+  int ok;
+  if( !f )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "capture: Couldn't open '%s' for writing.\n", fileName);
+    return(0);
+  }
+  ok = ( fwrite(data, len, 1, f) == 1 );
+  if( fclose(f) != 0 )
+    ok=0;
+  return(ok);
+}
+
+//Name of the next file or dir that doesn't exist yet, from a pattern with one %i
+static void captureNextName(char* buf, int len, const char* pattern, const char* ext)
+{
+  struct stat st;
+  char fmt[128];
+  int num=0;
+
+  snprintf( fmt, sizeof(fmt), "%%s/%s%s%s", pattern, (ext)?".":"", (ext)?ext:"" );
+  do
+  {
+    snprintf( buf, len, fmt, getConfigDir(), num++ );
+  } while( stat(buf, &st)==0 );
+}
+
+static void captureEncode(captureSlot_t* s, uint8_t* conv, uint8_t* enc)
+{
+  char fileName[600];
+  int len, ok=0;
+
+  //First frame of a sequence, find a name for it.
+  if( s->seq != -1 && s->frame==0 )
+  {
+    if( seqFile )
+    {
+      fclose(seqFile);
+      seqFile=NULL;
+    }
+
+    if( s->format == CAPTURE_RAW )
+    {
+      char pattern[64];
+      snprintf( pattern, sizeof(pattern), "capture_%%03i_%ix%i", capW, capH );
+      captureNextName( seqName, sizeof(seqName), pattern, captureExt[CAPTURE_RAW] );
+      seqFile = fopen( seqName, "wb" );
+    } else {
+      captureNextName( seqName, sizeof(seqName), "capture_%03i", NULL );
+      PLATFORM_MKDIR( seqName );
+    }
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "capture: Writing sequence to %s\n", seqName);
+  }
+
+  if( s->seq == -1 )
+  {
+    captureNextName( fileName, sizeof(fileName), "Wizznic_%04i", captureExt[s->format] );
+  } else {
+    snprintf( fileName, sizeof(fileName), "%s/%05i.%s", seqName, s->frame, captureExt[s->format] );
+  }
+
+  switch( s->format )
+  {
+    case CAPTURE_TGA:
+      captureTga( enc, capW, capH, capFmt, s->pixels, capPitch );
+      ok = captureWrite( fileName, enc, CAPTURE_TGA_LEN(capW, capH) );
+    break;
+
+    case CAPTURE_QOI:
+      SDL_ConvertPixels( capW, capH, capFmt, s->pixels, capPitch, SDL_PIXELFORMAT_RGB24, conv, capW*3 );
+      len = qoiEncode( conv, capW, capH, enc );
+      ok = captureWrite( fileName, enc, len );
+    break;
+
+    case CAPTURE_PNG:
+    {
+      int bpp;
+      Uint32 r, g, b, a;
+      SDL_Surface* surf;
+      SDL_PixelFormatEnumToMasks( capFmt, &bpp, &r, &g, &b, &a );
+      //PNG has no use for the alpha of the screen
+      surf = SDL_CreateRGBSurfaceFrom( s->pixels, capW, capH, bpp, capPitch, r, g, b, 0 );
+      if( surf )
+      {
+        ok = ( IMG_SavePNG( surf, fileName ) == 0 );
+        SDL_FreeSurface( surf );
+      }
+    }
+    break;
+
+    case CAPTURE_RAW:
+      SDL_ConvertPixels( capW, capH, capFmt, s->pixels, capPitch, SDL_PIXELFORMAT_RGB24, conv, capW*3 );
+      if( s->seq == -1 )
+      {
+        ok = captureWrite( fileName, conv, capW*capH*3 );
+      } else if( seqFile )
+      {
+        ok = ( fwrite( conv, capW*capH*3, 1, seqFile ) == 1 );
+      }
+    break;
+  }
+
+  if( !ok )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "capture: Couldn't write %s\n", (s->seq==-1 || s->format!=CAPTURE_RAW)?fileName:seqName );
+  } else if( s->seq == -1 )
+  {
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "capture: Saved %s\n", fileName);
+  }
+}
+
+static int captureThread(void* data)
+{
+  //Worst case for QOI is 4 bytes per pixel plus header and end marker
+  uint8_t* conv = malloc( capW*capH*3 );
+  uint8_t* enc = malloc( capW*capH*4+22 );
+
+  for(;;)
+  {
+    SDL_SemWait( fullSlots );
+    if( SDL_AtomicGet(&quit) )
+    {
+      break;
+    }
+
+    captureEncode( &slots[tail], conv, enc );
+    tail = (tail+1)%CAPTURE_RING;
+    SDL_SemPost( freeSlots );
+  }
+
+  if( seqFile )
+  {
+    fclose(seqFile);
+    seqFile=NULL;
+  }
+  free(conv);
+  free(enc);
+  return(0);
+}
+
+//The ring is made for the first frame captured, and kept.
+static int captureInit(SDL_Surface* screen)
+{
+  int i;
+
+  if( encThread )
+  {
+    if( screen->w==capW && screen->h==capH && screen->pitch==capPitch && screen->format->format==capFmt )
+      return(1);
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "capture: The screen changed, can't capture it.\n");
+    return(0);
+  }
+
+  capW = screen->w;
+  capH = screen->h;
+  capPitch = screen->pitch;
+  capFmt = screen->format->format;
+
+  for(i=0; i < CAPTURE_RING; i++)
+  {
+    slots[i].pixels = malloc( capPitch*capH );
+    if( !slots[i].pixels )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "capture: Not enough memory for %i frames.\n", CAPTURE_RING);
+      while( i-- )
+      {
+        free( slots[i].pixels );
+        slots[i].pixels=NULL;
+      }
+      return(0);
+    }
+  }
+
+  head=tail=0;
+  SDL_AtomicSet( &quit, 0 );
+  freeSlots = SDL_CreateSemaphore( CAPTURE_RING );
+  fullSlots = SDL_CreateSemaphore( 0 );
+  encThread = SDL_CreateThread( captureThread, "capture", NULL );
+  if( !encThread )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "capture: Couldn't start encoder: %s\n", SDL_GetError());
+    for(i=0; i < CAPTURE_RING; i++)
+    {
+      free( slots[i].pixels );
+      slots[i].pixels=NULL;
+    }
+    SDL_DestroySemaphore( freeSlots );
+    SDL_DestroySemaphore( fullSlots );
+    return(0);
+  }
+  return(1);
+}
+
+void captureShot(int format)
+{
+  shotFormat=format;
+}
+
+void captureSequence(int format, int seconds)
+{
+  if( seqFormat != -1 )
+  {
+    seqEnd=SDL_GetTicks();
+    return;
+  }
+  seqFormat=format;
+  seqFrame=0;
+  seqSkipped=0;
+  seqId++;
+  seqEnd=SDL_GetTicks()+seconds*1000;
+}
+
+int captureActive()
+{
+  return( seqFormat != -1 );
+}
+
+void captureFrame(SDL_Surface* screen)
+{
+  captureSlot_t* s;
+  int y;
+
+  if( shotFormat == -1 && seqFormat == -1 )
+  {
+    return;
+  }
+
+  //Sequences end on time, not frame count, so they match what was seen.
+  if( seqFormat != -1 && (Sint32)(SDL_GetTicks()-seqEnd) >= 0 )
+  {
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "capture: Sequence done, %i frames, %i skipped.\n", seqFrame, seqSkipped);
+    seqFormat=-1;
+    if( shotFormat == -1 )
+      return;
+  }
+
+  if( !captureInit(screen) )
+  {
+    shotFormat=-1;
+    seqFormat=-1;
+    return;
+  }
+
+  //Never wait for the encoder, skip the frame instead (a shot is taken next frame).
+  if( SDL_SemTryWait( freeSlots ) != 0 )
+  {
+    if( seqFormat != -1 )
+      seqSkipped++;
+    return;
+  }
+
+  s = &slots[head];
+  if( SDL_MUSTLOCK(screen) )
+    SDL_LockSurface(screen);
+  if( screen->pitch == capPitch )
+  {
+    memcpy( s->pixels, screen->pixels, capPitch*capH );
+  } else {
+    for(y=0; y < capH; y++)
+      memcpy( s->pixels+y*capPitch, (uint8_t*)screen->pixels+y*screen->pitch, capPitch );
+  }
+  if( SDL_MUSTLOCK(screen) )
+    SDL_UnlockSurface(screen);
+
+  if( shotFormat != -1 )
+  {
+    s->format = shotFormat;
+    s->seq = -1;
+    s->frame = 0;
+    shotFormat=-1;
+  } else {
+    s->format = seqFormat;
+    s->seq = seqId;
+    s->frame = seqFrame++;
+  }
+
+  head = (head+1)%CAPTURE_RING;
+  SDL_SemPost( fullSlots );
+}
+
+void captureQuit()
+{
+  int i;
+
+  if( !encThread )
+  {
+    return;
+  }
+
+  //When every slot is free again, the encoder has written them all.
+  for(i=0; i < CAPTURE_RING; i++)
+  {
+    SDL_SemWait( freeSlots );
+  }
+
+  SDL_AtomicSet( &quit, 1 );
+  SDL_SemPost( fullSlots );
+  SDL_WaitThread( encThread, NULL );
+  encThread=NULL;
+
+  for(i=0; i < CAPTURE_RING; i++)
+  {
+    free( slots[i].pixels );
+    slots[i].pixels=NULL;
+  }
+  SDL_DestroySemaphore( freeSlots );
+  SDL_DestroySemaphore( fullSlots );
+  shotFormat=-1;
+  seqFormat=-1;
+}
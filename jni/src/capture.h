@@ -0,0 +1,56 @@
+#ifndef CAPTURE_H_INCLUDED
+#define CAPTURE_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <SDL.h>
+
+//Frame capture. A finished frame is copied into a ring of buffers and written by an
+//encoder thread, so capturing every frame doesn't disturb the frame pacing.
+
+#define CAPTURE_TGA 0
+#define CAPTURE_QOI 1
+#define CAPTURE_PNG 2
+#define CAPTURE_RAW 3 //One file of RGB24 frames per sequence
+
+//Frames waiting to be written, when they're all in use frames are skipped
+#ifndef CAPTURE_RING
+  #define CAPTURE_RING 6
+#endif
+#ifndef CAPTURE_SHOT_FORMAT
+  #define CAPTURE_SHOT_FORMAT CAPTURE_PNG
+#endif
+#ifndef CAPTURE_SEQ_FORMAT
+  #define CAPTURE_SEQ_FORMAT CAPTURE_QOI
+#endif
+#ifndef CAPTURE_SEQ_SECONDS
+  #define CAPTURE_SEQ_SECONDS 10
+#endif
+
+void captureShot(int format); //Write the next frame to Wizznic_NNNN in the config dir
+void captureSequence(int format, int seconds); //Write every frame for a while to capture_NNN, or stop if capturing
+int captureActive(); //1 while a sequence is being captured
+void captureFrame(SDL_Surface* screen); //Call with each finished frame
+void captureQuit(); //Writes what's left in the ring
+int captureQoiCheck(SDL_Surface* surf); //Encodes surf as QOI and decodes it again, 1 if every pixel survives
+
+//24 bit TGA of w*h pixels in format, written to out which holds CAPTURE_TGA_LEN(w,h) bytes.
+#define CAPTURE_TGA_LEN(w,h) ((w)*(h)*3+18)
+void captureTga(uint8_t* out, int w, int h, Uint32 format, const void* pixels, int pitch);
+
+#endif // CAPTURE_H_INCLUDED
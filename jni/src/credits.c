@@ -41,8 +41,8 @@ struct msg_s {
 typedef struct msg_s msg_t;
 
 static msg_t* cm; //Current msg.
-static int currentMsgIndex; //in list
-static list_t* msgList;
+static int currentMsgIndex; //in msgList
+static array_t* msgList;
 static int ticksToNextPs=0;
 static psysSet_t ps;
 SDL_Rect r; //Used to shake the name
@@ -86,7 +86,7 @@ msg_t* initMsg(const char* strTitle, const char* strName,SDL_Surface* screen)
 
 void setCurrent()
 {
-  cm=(msg_t*)listGetItemAt(msgList,currentMsgIndex)->data;
+  cm=(msg_t*)arrayGetAt(msgList,currentMsgIndex);
 
   cm->stateTicks=0;
   cm->state=MSGSTATE_TITLE_SLIDING_IN;
@@ -127,29 +127,29 @@ void _freeCreditListItem(void* data)
 
 void initCredits(SDL_Surface* screen)
 {
-  msgList=listInit(_freeCreditListItem);
+  msgList=arrayInit(_freeCreditListItem);
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initCredits 0");
   if(msgList == NULL) {
 	  SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "msgList is NULL - initCredits()"); 
   }  
-  listAppendData(msgList, (void*)initMsg("Website","wizznic.org", screen));SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initCredits 1"); 
-  listAppendData(msgList, (void*)initMsg("Code/Gfx/Sfx","Jimmy Christensen", screen));SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initCredits 2"); 
-  listAppendData(msgList, (void*)initMsg("Gfx","ViperMD", screen));
-  listAppendData(msgList, (void*)initMsg("Music","Sean Hawk", screen));
-
-  listAppendData(msgList, (void*)initMsg("Thx","Qubodup", screen));
-  listAppendData(msgList, (void*)initMsg("Thx","Farox", screen));
-  listAppendData(msgList, (void*)initMsg("Thx","bMan", screen));
-  listAppendData(msgList, (void*)initMsg("Thx","KML", screen));
-  listAppendData(msgList, (void*)initMsg("Thx","Neil L", screen));
-  listAppendData(msgList, (void*)initMsg("Thx","Zear", screen));
-  listAppendData(msgList, (void*)initMsg("Thx","ReactorScram", screen));
-  listAppendData(msgList, (void*)initMsg("Thx","torpor", screen));
-  listAppendData(msgList, (void*)initMsg("Thx","klopsi", screen));
-
-  listAppendData(msgList, (void*)initMsg("Greetings","GP32X.com", screen));
-  listAppendData(msgList, (void*)initMsg("Greetings","freegamedev.net", screen));
-  listAppendData(msgList, (void*)initMsg("Greetings","gcw-zero.com", screen));
+  arrayAppendData(msgList, (void*)initMsg("Website","wizznic.org", screen));SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initCredits 1"); 
+  arrayAppendData(msgList, (void*)initMsg("Code/Gfx/Sfx","Jimmy Christensen", screen));SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initCredits 2"); 
+  arrayAppendData(msgList, (void*)initMsg("Gfx","ViperMD", screen));
+  arrayAppendData(msgList, (void*)initMsg("Music","Sean Hawk", screen));
+
+  arrayAppendData(msgList, (void*)initMsg("Thx","Qubodup", screen));
+  arrayAppendData(msgList, (void*)initMsg("Thx","Farox", screen));
+  arrayAppendData(msgList, (void*)initMsg("Thx","bMan", screen));
+  arrayAppendData(msgList, (void*)initMsg("Thx","KML", screen));
+  arrayAppendData(msgList, (void*)initMsg("Thx","Neil L", screen));
+  arrayAppendData(msgList, (void*)initMsg("Thx","Zear", screen));
+  arrayAppendData(msgList, (void*)initMsg("Thx","ReactorScram", screen));
+  arrayAppendData(msgList, (void*)initMsg("Thx","torpor", screen));
+  arrayAppendData(msgList, (void*)initMsg("Thx","klopsi", screen));
+
+  arrayAppendData(msgList, (void*)initMsg("Greetings","GP32X.com", screen));
+  arrayAppendData(msgList, (void*)initMsg("Greetings","freegamedev.net", screen));
+  arrayAppendData(msgList, (void*)initMsg("Greetings","gcw-zero.com", screen));
 
   //Set current
   currentMsgIndex=0;
@@ -159,7 +159,7 @@ void initCredits(SDL_Surface* screen)
 
 void clearCredits()
 {
-  listFree(msgList);
+  arrayFree(msgList);
 }
 
 
@@ -93,6 +93,30 @@
   #define PLATFORM_CRUDE_TIMING_TICKS 20
 #endif
 
+//Frame scheduler, default target rate. Brick movement is stepped once per frame, so the game is tuned for 50 fps.
+#ifndef FRAMESCHED_DEFAULT_RATE
+  #define FRAMESCHED_DEFAULT_RATE (1000/PLATFORM_CRUDE_TIMING_TICKS)
+#endif
+
+//Milliseconds before the frame deadline where we stop sleeping and spin.
+#ifndef FRAMESCHED_SPIN_MS
+  #if defined(CRUDE_TIMING)
+    #define FRAMESCHED_SPIN_MS PLATFORM_CRUDE_TIMING_TICKS //SDL_Delay is too coarse here, spin the whole frame
+  #else
+    #define FRAMESCHED_SPIN_MS 2
+  #endif
+#endif
+
+//Late input: milliseconds left for presenting on top of the longest recent frame.
+#ifndef FRAMESCHED_LATE_MARGIN_MS
+  #define FRAMESCHED_LATE_MARGIN_MS 2
+#endif
+
+//Frames between frame time reports
+#ifndef FRAMESCHED_REPORT_FRAMES
+  #define FRAMESCHED_REPORT_FRAMES 500
+#endif
+
 //Half the resolution is practical for centering content
 #define HSCREENW  SCREENW/2
 #define HSCREENH  SCREENH/2
@@ -124,10 +148,12 @@
 #define PSYS_LAYER_UNDERDEATHANIM 3
 
 //To avoid crashing a new version trying to read old highscore files (hmm, as if it's ever gonna happen)
-#define STATS_FILE_FORMAT_VERSION 1
+#define STATS_FILE_FORMAT_VERSION 2
 
 //Url where stats are
-#define API_URL "http://wizznic.org/api"
+#ifndef API_URL
+  #define API_URL "http://wizznic.org/api"
+#endif
 
 #ifndef STR_PLATFORM
   #ifndef STR_PLATFORM
@@ -20,6 +20,7 @@
 #include "defs.h"
 #include "settings.h"
 #include "input.h"
+#include "profiler.h"
 
 struct boardGraphics_t graphics;
 
@@ -29,7 +30,7 @@ int initDraw(levelInfo_t* li, SDL_Surface* screen)
   int i;
 
   //Background image
-  graphics.boardImg = loadImg( packGetFile("themes",li->bgFile) );
+  graphics.boardImg = imgCacheGet( packGetFile("themes",li->bgFile) );
   if(!graphics.boardImg)
   {
 	SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "Couldn't load board file:'%s'\n", packGetFile("themes",li->bgFile));
@@ -51,7 +52,7 @@ int initDraw(levelInfo_t* li, SDL_Surface* screen)
 
   //Tileset
   sprintf(tempStr, "%s.png", li->tileBase);
-  graphics.tileImg = loadImg( packGetFile("themes",tempStr) );
+  graphics.tileImg = imgCacheGet( packGetFile("themes",tempStr) );
   if(!graphics.tileImg)
   {
 	SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "Couldn't load tile file:'%s'\n", packGetFile("themes",tempStr));
@@ -66,7 +67,7 @@ int initDraw(levelInfo_t* li, SDL_Surface* screen)
   }
 
   sprintf(tempStr, "%s.png", li->wallBase);
-  graphics.wallsImg = loadImg( packGetFile("themes",tempStr) );
+  graphics.wallsImg = imgCacheGet( packGetFile("themes",tempStr) );
   if(graphics.wallsImg)
   {
     for(i=0; i < 13; i++)
@@ -85,7 +86,7 @@ int initDraw(levelInfo_t* li, SDL_Surface* screen)
   {
     //Open explosion
     sprintf(tempStr, "%s%02i.png", li->explBase, i);
-    graphics.explImg[i] = loadImg( packGetFile("themes",tempStr) );
+    graphics.explImg[i] = imgCacheGet( packGetFile("themes",tempStr) );
 
     if(!graphics.explImg[i] && i==0) 
 			SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "Couldn't open '%s'\n",packGetFile("themes",tempStr));
@@ -100,14 +101,14 @@ int initDraw(levelInfo_t* li, SDL_Surface* screen)
   for(i=0; i < NUMTILES; i++)
   {
     sprintf(tempStr, "%s-tile%02i.png", li->tileBase, i);
-    graphics.aniImg[i] = loadImg( packGetFile("themes",tempStr) );
+    graphics.aniImg[i] = imgCacheGet( packGetFile("themes",tempStr) );
 
     graphics.tileAni[i] = mkAni(graphics.aniImg[i], 30,30, 80);
 
   }
 
   //Cursor
-  graphics.curImg = loadImg( packGetFile( "themes/cursors",li->cursorFile) );
+  graphics.curImg = imgCacheGet( packGetFile( "themes/cursors",li->cursorFile) );
   if( !graphics.curImg )
   {
 	  SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "Warning: Couldn't find cursor '%s'\n", packGetFile( "themes/cursors",li->cursorFile));
@@ -117,7 +118,7 @@ int initDraw(levelInfo_t* li, SDL_Surface* screen)
 
 
   //Load countdown
-  graphics.countDownImg = loadImg( packGetFile(NULL,"countdown.png") );
+  graphics.countDownImg = imgCacheGet( packGetFile(NULL,"countdown.png") );
   if(!graphics.countDownImg)
   {
 	SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "Error(5): couldn't load '%s'\n",packGetFile(".","countdown.png"));
@@ -194,6 +195,17 @@ void cleanUpDraw()
     graphics.explImg[i]=0;
 
     freeAni( graphics.brickExpl[i]);
+    graphics.brickExpl[i]=0;
+  }
+
+  //Per-Tile animations
+  for(i=0; i < NUMTILES; i++)
+  {
+    if( graphics.aniImg[i] ) SDL_FreeSurface( graphics.aniImg[i] );
+    graphics.aniImg[i]=0;
+
+    freeAni( graphics.tileAni[i] );
+    graphics.tileAni[i]=0;
   }
 
   //Countdown
@@ -205,6 +217,10 @@ void cleanUpDraw()
     if(graphics.countDownSpr[i]) free(graphics.countDownSpr[i]);
     graphics.countDownSpr[i]=0;
   }
+
+  //Images are kept for the next level, unless that puts the cache over budget
+  imgCacheTrim();
+  imgCacheLogStats();
 }
 
 /* Permanently disables cursor, used for generating preview images */
@@ -224,6 +240,9 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
   int x,y;
   listItem* t; //general purpose, reusable
   psysSet_t ps;
+  telePort_t* path=NULL; //Switch or teleport path to draw on top
+
+  profBegin(PROF_DRAW);
 
   //Check if we should draw walls
   if( pf->newWalls )
@@ -245,19 +264,20 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
           {
             int i;
             //Draw middle wall (idx 0)
-            drawSprite(graphics.background, graphics.walls[0], pf->board[x][y]->pxx-(HSCREENW-160), pf->board[x][y]->pxy-(HSCREENH-120) );
+            batchSprite(graphics.background, graphics.walls[0], pf->board[x][y]->pxx-(HSCREENW-160), pf->board[x][y]->pxy-(HSCREENH-120) );
             //Draw edges (if any)
             for(i=1; i < 13; i++)
             {
               if(pf->board[x][y]->edges & (1<<i) )
               {
-                drawSprite(graphics.background, graphics.walls[i], pf->board[x][y]->pxx-(HSCREENW-160), pf->board[x][y]->pxy-(HSCREENH-120) );
+                batchSprite(graphics.background, graphics.walls[i], pf->board[x][y]->pxx-(HSCREENW-160), pf->board[x][y]->pxy-(HSCREENH-120) );
               }
             }
           }
         }
       }
     }
+    batchFlush();
   }
 
 
@@ -285,27 +305,27 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
           {
             if( !isSwitch( pf->board[x][y] ) )
             {
-              drawAni(screen, graphics.tileAni[pf->board[x][y]->type-1], pf->board[x][y]->pxx-5, pf->board[x][y]->pxy-5);
+              batchAni(screen, graphics.tileAni[pf->board[x][y]->type-1], pf->board[x][y]->pxx-5, pf->board[x][y]->pxy-5);
             } else {
               //We only end here when it's a switch
               if( (pf->board[x][y]->type==SWON)?pf->board[x][y]->isActive:!pf->board[x][y]->isActive)
               {
-                drawAni(screen, graphics.tileAni[SWON-1], pf->board[x][y]->pxx-5, pf->board[x][y]->pxy-5);
+                batchAni(screen, graphics.tileAni[SWON-1], pf->board[x][y]->pxx-5, pf->board[x][y]->pxy-5);
               } else {
-                drawAni(screen, graphics.tileAni[SWOFF-1], pf->board[x][y]->pxx-5, pf->board[x][y]->pxy-5);
+                batchAni(screen, graphics.tileAni[SWOFF-1], pf->board[x][y]->pxx-5, pf->board[x][y]->pxy-5);
               }
             }
           //Fall back to the static non-moving tiles if no animation is found.
           } else {
             if( !isSwitch( pf->board[x][y] ) )
             {
-              drawSprite(screen, graphics.tiles[pf->board[x][y]->type-1], pf->board[x][y]->pxx, pf->board[x][y]->pxy);
+              batchSprite(screen, graphics.tiles[pf->board[x][y]->type-1], pf->board[x][y]->pxx, pf->board[x][y]->pxy);
             } else {
               if( (pf->board[x][y]->type==SWON)?pf->board[x][y]->isActive:!pf->board[x][y]->isActive)
               {
-                drawSprite(screen, graphics.tiles[SWON-1], pf->board[x][y]->pxx, pf->board[x][y]->pxy);
+                batchSprite(screen, graphics.tiles[SWON-1], pf->board[x][y]->pxx, pf->board[x][y]->pxy);
               } else {
-                drawSprite(screen, graphics.tiles[SWOFF-1], pf->board[x][y]->pxx, pf->board[x][y]->pxy);
+                batchSprite(screen, graphics.tiles[SWOFF-1], pf->board[x][y]->pxx, pf->board[x][y]->pxy);
               }
             }
           }
@@ -325,7 +345,7 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
           telePort_t* tp = (telePort_t*)it->data;
           if(tp->sx==x && tp->sy==y)
           {
-            drawTelePath( screen, tp, 1 );
+            path=tp;
             break;
           }
         }
@@ -335,6 +355,11 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
     }
   } //xy loop
 
+  batchFlush();
+  if(path)
+    drawTelePath( screen, path, 1 );
+  path=NULL; //Each drawTelePath() advances the colour animation, draw it once
+
   //Draw moving bricks
   t=&pf->movingList->begin;
   brickType* b;
@@ -344,11 +369,12 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
 
     if(graphics.tileAni[b->type-1])
     {
-      drawAni(screen, graphics.tileAni[b->type-1], b->pxx-5, b->pxy-5);
+      batchAni(screen, graphics.tileAni[b->type-1], b->pxx-5, b->pxy-5);
     } else {
-      drawSprite(screen, graphics.tiles[b->type-1], b->pxx, b->pxy);
+      batchSprite(screen, graphics.tiles[b->type-1], b->pxx, b->pxy);
     }
   }
+  batchFlush();
 
   //Particle systems that are between bricks and die animantion
   runParticlesLayer(screen, PSYS_LAYER_UNDERDEATHANIM);
@@ -357,6 +383,7 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
   //Draw dying bricks, animation?
   t=&pf->removeList->begin;
 
+  //Base bricks first, so all explosions go on top
   while( LISTFWD(pf->removeList,t) )
   {
     b=(brickType*)t->data;
@@ -365,16 +392,22 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
     {
       if(graphics.tileAni[b->type-1])
       {
-        drawAni(screen, graphics.tileAni[b->type-1], b->pxx-5, b->pxy-5);
+        batchAni(screen, graphics.tileAni[b->type-1], b->pxx-5, b->pxy-5);
       } else {
-        drawSprite(screen, graphics.tiles[b->type-1], b->pxx, b->pxy);
+        batchSprite(screen, graphics.tiles[b->type-1], b->pxx, b->pxy);
       }
     }
+  }
+  batchFlush();
 
+  t=&pf->removeList->begin;
+  while( LISTFWD(pf->removeList,t) )
+  {
+    b=(brickType*)t->data;
 
     int explFrame = 16*(pf->levelInfo->brick_die_ticks-b->tl)/pf->levelInfo->brick_die_ticks;
 
-    drawAniFrame(screen, graphics.brickExpl[b->type-1], b->pxx-5, b->pxy-5,explFrame);
+    batchAniFrame(screen, graphics.brickExpl[b->type-1], b->pxx-5, b->pxy-5,explFrame);
 
     //Spawn particles for brick death
     if(explFrame==8 && pf->levelInfo->brickDieParticles)
@@ -393,6 +426,7 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
     }
 
   }
+  batchFlush();
 
   //Teleport overlay
   t = &pf->levelInfo->teleList->begin;
@@ -403,18 +437,21 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
 
     if(graphics.tileAni[TELESRC-1])
     {
-      drawAni(screen, graphics.tileAni[TELESRC-1], boardOffsetX+20*tp->sx-5, boardOffsetY+20*tp->sy-5);
+      batchAni(screen, graphics.tileAni[TELESRC-1], boardOffsetX+20*tp->sx-5, boardOffsetY+20*tp->sy-5);
     } else {
-      drawSprite(screen, graphics.tiles[TELESRC-1], boardOffsetX+20*tp->sx, boardOffsetY+20*tp->sy);
+      batchSprite(screen, graphics.tiles[TELESRC-1], boardOffsetX+20*tp->sx, boardOffsetY+20*tp->sy);
     }
 
 
     //if cursor is on it, draw the path too
     if( cur->x == tp->sx && cur->y == tp->sy && pf->levelInfo->showTelePath )
     {
-      drawTelePath( screen, tp, 1 );
+      path=tp;
     }
   }
+  batchFlush();
+  if(path)
+    drawTelePath( screen, path, 1 );
 
 
 
@@ -444,6 +481,7 @@ void draw(cursorType* cur, playField* pf, SDL_Surface* screen)
     spawnParticleSystem(&ps);
   }
 
+  profEnd(PROF_DRAW);
 }
 
 static int lastShown=0;
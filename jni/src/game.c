@@ -20,6 +20,8 @@
 #include "settings.h"
 #include "defs.h"
 #include "transition.h"
+#include "profiler.h"
+#include "memtrack.h"
 #include "switch.h"
 #include "skipleveldialog.h"
 
@@ -55,6 +57,13 @@ static int mouseGrab=0;
 
 static int justWon=0; //Used to detect the moment when the player won
 
+//The numbers in the ui change often, they get their own surfaces instead of churning the text cache.
+static txtField_t uiTimeField, uiScoreField, uiLivesField;
+
+#if defined(WANT_MEMTRACK)
+static Uint32 levelMark; //What is still allocated from the level at cleanup is reported
+#endif
+
 int initGame(SDL_Surface* screen)
 {
     if(player()->gameStarted)
@@ -74,14 +83,17 @@ int initGame(SDL_Surface* screen)
     	ptrRestartRect.h=ptrRestartRect.y+ptrRestart->h;
     }
 
+    #if defined(WANT_MEMTRACK)
+    levelMark=memMark();
+    #endif
+
     debugNumInit++;
     initCursor(&cur);
     restartConfirm=0;
 
     //Read info's for level. (this is done instead of using the one in packInfo so it don't need resetting)
-    pf.levelInfo = mkLevelInfo( player()->levelFile );
-
-    if(!loadField(&pf, player()->levelFile ))
+    //Loads the compiled form of the level, the .wzp is only parsed when that's stale.
+    if(!loadLevel(&pf, player()->levelFile ))
     {
       SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: Couldn't init playfield.\n");
       return(0);
@@ -141,6 +153,14 @@ void cleanUpGame()
 
     //Free memory used for levelInfo
     freeLevelInfo( &pf.levelInfo );
+
+    txtFieldFree( &uiTimeField );
+    txtFieldFree( &uiScoreField );
+    txtFieldFree( &uiLivesField );
+
+    #if defined(WANT_MEMTRACK)
+    memReport("level exit", levelMark);
+    #endif
 }
 
 static void setGameOver()
@@ -166,17 +186,17 @@ void drawUi(SDL_Surface* screen)
   } else {
     sprintf(tempStr,"%i",secLeft);
   }
-  txtWriteCenter(screen, GAMEFONTMEDIUM, tempStr,HSCREENW-113, HSCREENH-26);
+  txtFieldWriteCenter(screen, &uiTimeField, GAMEFONTMEDIUM, tempStr,HSCREENW-113, HSCREENH-26);
 
   txtWriteCenter(screen, GAMEFONTSMALL, "Score:", HSCREENW-114,HSCREENH+5);
   sprintf(tempStr, "%i", player()->hsEntry.score );
-  txtWriteCenter(screen, GAMEFONTMEDIUM, tempStr, HSCREENW-113, HSCREENH+15);
+  txtFieldWriteCenter(screen, &uiScoreField, GAMEFONTMEDIUM, tempStr, HSCREENW-113, HSCREENH+15);
 
   if( player()->lives != -1)
   {
     txtWriteCenter(screen, GAMEFONTSMALL, "Lives:", HSCREENW-113,HSCREENH+48);
     sprintf(tempStr, "%i", player()->lives );
-    txtWriteCenter(screen, GAMEFONTMEDIUM, tempStr, HSCREENW-113, HSCREENH+58);
+    txtFieldWriteCenter(screen, &uiLivesField, GAMEFONTMEDIUM, tempStr, HSCREENW-113, HSCREENH+58);
   }
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "drawUi end"); 
 }
@@ -473,11 +493,15 @@ int runGame(SDL_Surface* screen)
 	
 	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "runGame 10");
     //Sim first, so moving blocks get evaluated before getting moved again
+    profBegin(PROF_SIM);
     simField(&pf, &cur);
+    profEnd(PROF_SIM);
 	
 	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "runGame 11");
     //Do rules
+    profBegin(PROF_RULES);
     int ret=doRules(&pf);
+    profEnd(PROF_RULES);
 	
 	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "runGame 12");
     //Draw scene
@@ -798,8 +822,12 @@ SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "runGame 30");
   } else if(gameState==GAMESTATESKIPLEVEL)
   {
 
+    profBegin(PROF_RULES);
     doRules(&pf);
+    profEnd(PROF_RULES);
+    profBegin(PROF_SIM);
     simField(&pf, &cur);
+    profEnd(PROF_SIM);
     draw(&cur,&pf, screen);
 
     countdown-=getTicks();
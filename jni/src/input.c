@@ -21,10 +21,13 @@
 #include "platform/dumplevelimages.h"
 
 #include "settings.h"
+#include "stats.h"
+#include "capture.h"
 
 static int inputChar=0;
 static int joyCanMoveX=0;
 static int joyCanMoveY=0;
+static Uint32 inputStamp=0;
 
 int getChar()
 {
@@ -85,11 +88,17 @@ int getBtnTime(int btn)
   return(button[btn].time);
 }
 
+Uint32 getInputStamp()
+{
+  return(inputStamp);
+}
+
 int runControls()
 {
   SDL_Event event;
   int i;
   inputChar=0;
+  inputStamp=0;
   //Loop through buttons to update hold-down time
   for(i=0; i < C_NUM; i++)
   {
@@ -104,6 +113,13 @@ int runControls()
 
   while(SDL_PollEvent(&event))
   {
+    //Keys, mouse, joysticks and touch, the oldest says how long input waited for this frame
+    if( event.type >= SDL_KEYDOWN && event.type < SDL_CLIPBOARDUPDATE &&
+        ( !inputStamp || (Sint32)(event.common.timestamp-inputStamp) < 0 ) )
+    {
+      inputStamp=event.common.timestamp;
+    }
+
     switch(event.type)
     {
         #if defined (GP2X) || defined (WIZ)
@@ -346,6 +362,12 @@ int runControls()
           } else if( event.key.keysym.sym == SDLK_BACKSPACE || event.key.keysym.sym == SDLK_RETURN || event.key.keysym.sym == SDLK_AC_BACK)
           {
             inputChar=event.key.keysym.sym;
+          } else if( event.key.keysym.sym == SDLK_F12 && !event.key.repeat )
+          {
+            captureShot(CAPTURE_SHOT_FORMAT);
+          } else if( event.key.keysym.sym == SDLK_F11 && !event.key.repeat )
+          {
+            captureSequence(CAPTURE_SEQ_FORMAT, CAPTURE_SEQ_SECONDS);
           }
         break;
         case SDL_KEYUP:
@@ -391,6 +413,12 @@ int runControls()
         break;
 
 
+        //We may not be back, what's journaled must be on disk.
+        case SDL_APP_WILLENTERBACKGROUND:
+        case SDL_APP_TERMINATING:
+          statsFlush();
+        break;
+
         case SDL_QUIT:
           return(1);
         break;
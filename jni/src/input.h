@@ -51,6 +51,7 @@ void resetBtn(int btn);
 void resetMouseBtn();
 void resetBtnAll();
 int runControls();
+Uint32 getInputStamp(); //SDL timestamp of the oldest input event handled by the last runControls(), 0 for none
 void initControls();
 int isBackButtonPressed();
 void resetChar();
@@ -0,0 +1,234 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <SDL.h>
+
+#include "levelbin.h"
+#include "levelindex.h"
+#include "board.h"
+#include "userfiles.h"
+
+typedef struct {
+  char ident[4];
+  uint32_t version;
+  uint32_t build; //Hash of getAppStamp()
+  uint32_t srcStr; //Offset of the source file name in the strings
+  uint32_t numTele; //Teleports and switches
+  uint32_t strLen;
+  levelIndexRecord_t r; //mtime and size are the stamp of the source
+  uint8_t cells[FIELDSIZE][FIELDSIZE];
+} levelBinHeader_t;
+
+static void levelBinFileName(char* buf, size_t len, const char* file)
+{
+  snprintf( buf, len, "%s/"LEVELBIN_DIR"/%08x.wzb", getConfigDir(), levelIndexHash(file) );
+}
+
+//Levels that can't be stat()'ed (assets, archives) are as fresh as their dir.
+static void levelBinStamp(const char* file, int64_t* mtime, int64_t* size)
+{
+  char buf[1024];
+  char* p;
+  levelIndexStamp( file, mtime, size );
+  if( !*mtime )
+  {
+    snprintf( buf, sizeof(buf), "%s", file );
+    p = strrchr( buf, '/' );
+    if( p )
+    {
+      *p=0;
+      levelIndexDirStamp( buf, mtime, size );
+    }
+  }
+}
+
+//Parse the level in file, returns the compiled level in a new buffer or NULL.
+static uint8_t* levelBinBuild(const char* file, size_t* len)
+{
+  levelBinHeader_t h;
+  levelIndexStrings_t strs;
+  levelInfo_t* li;
+  int32_t* tele;
+  int32_t* t;
+  uint8_t* bin=NULL;
+
+  memset( &h, 0, sizeof(h) );
+  memset( &strs, 0, sizeof(strs) );
+
+  //Info and cells in one pass over the file.
+  li = mkLevelInfoCells( file, h.cells );
+  if( !li )
+    return(NULL);
+
+  memcpy( h.ident, LEVELBIN_IDENT, 4 );
+  h.version = LEVELBIN_VERSION;
+  h.build = levelIndexHash(getAppStamp());
+  h.srcStr = levelIndexAddStr( &strs, file );
+  h.numTele = li->teleList->count + li->switchList->count;
+
+  t = tele = malloc( sizeof(int32_t)*4*h.numTele+1 );
+  levelIndexFillRecord( &h.r, li, &strs, &t );
+  levelBinStamp( file, &h.r.mtime, &h.r.size );
+  h.strLen = strs.len;
+
+  *len = sizeof(h) + sizeof(int32_t)*4*h.numTele + strs.len;
+  bin = malloc( *len );
+  if( bin )
+  {
+    memcpy( bin, &h, sizeof(h) );
+    memcpy( bin+sizeof(h), tele, sizeof(int32_t)*4*h.numTele );
+    memcpy( bin+sizeof(h)+sizeof(int32_t)*4*h.numTele, strs.data, strs.len );
+  }
+
+  free( tele );
+  free( strs.data );
+  freeLevelInfo( &li );
+  return(bin);
+}
+
+//Write through a temporary file so a crash never leaves half a level.
+static int levelBinWrite(const char* outFile, const uint8_t* bin, size_t len)
+{
+  char tmpName[1024];
+  FILE* f;
+  int ok;
+
+  if( snprintf( tmpName, sizeof(tmpName), "%s.tmp", outFile ) >= (int)sizeof(tmpName) )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Compiled level name %s is too long.\n", outFile);
+    return(0);
+  }
+  f = fopen( tmpName, "wb" );
+  if( !f )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Could not open %s for writing.\n", tmpName);
+    return(0);
+  }
+
+  ok = ( fwrite( bin, len, 1, f ) == 1 );
+  if( fclose(f) != 0 )
+    ok=0;
+
+  if( !ok || rename( tmpName, outFile ) != 0 )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Could not write compiled level %s\n", outFile);
+    remove( tmpName );
+    return(0);
+  }
+  return(1);
+}
+
+//Read the compiled level with one read, returns NULL if it's missing, stale or broken.
+static uint8_t* levelBinRead(const char* binFile, const char* file)
+{
+  FILE* f;
+  struct stat st;
+  uint8_t* bin=NULL;
+  levelBinHeader_t* h;
+  const char* strs;
+  int64_t mtime, size;
+
+  f = fopen( binFile, "rb" );
+  if( !f )
+    return(NULL);
+
+  if( fstat( fileno(f), &st ) == 0 && st.st_size >= (off_t)sizeof(levelBinHeader_t) )
+  {
+    bin = malloc( st.st_size );
+    if( bin && fread( bin, st.st_size, 1, f ) != 1 )
+    {
+      free(bin);
+      bin=NULL;
+    }
+  }
+  fclose(f);
+
+  if( !bin )
+    return(NULL);
+
+  h = (levelBinHeader_t*)bin;
+  strs = (const char*)(bin+st.st_size-h->strLen);
+
+  if( memcmp( h->ident, LEVELBIN_IDENT, 4 ) != 0 || h->version != LEVELBIN_VERSION || h->build != levelIndexHash(getAppStamp()) ||
+      h->numTele != (uint32_t)h->r.numTele+h->r.numSwitch || h->strLen == 0 ||
+      (uint64_t)sizeof(levelBinHeader_t) + (uint64_t)h->numTele*sizeof(int32_t)*4 + h->strLen != (uint64_t)st.st_size ||
+      strs[h->strLen-1] != 0 || h->srcStr >= h->strLen || !levelIndexRecordOk( &h->r, h->strLen ) )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Compiled level %s is broken or from another version, rebuilding.\n", binFile);
+    free(bin);
+    return(NULL);
+  }
+
+  //Another level with the same hash, or the source changed
+  levelBinStamp( file, &mtime, &size );
+  if( strcmp( strs+h->srcStr, file ) != 0 || h->r.mtime != mtime || h->r.size != size )
+  {
+    free(bin);
+    return(NULL);
+  }
+
+  return(bin);
+}
+
+levelInfo_t* levelBinLoad(const char* file, uint8_t cells[FIELDSIZE][FIELDSIZE])
+{
+  char binFile[1024];
+  uint8_t* bin;
+  size_t len;
+  levelBinHeader_t* h;
+  levelInfo_t* li;
+
+  levelBinFileName( binFile, sizeof(binFile), file );
+  bin = levelBinRead( binFile, file );
+  if( !bin )
+  {
+    bin = levelBinBuild( file, &len );
+    if( !bin )
+      return(NULL);
+
+    //The level still loads if the cache can't be written
+    sprintf( binFile, "%s/"LEVELBIN_DIR, getConfigDir() );
+#ifdef WIN32
+    mkdir( binFile );
+#else
+    mkdir( binFile, S_IRWXU );
+#endif
+    levelBinFileName( binFile, sizeof(binFile), file );
+    if( levelBinWrite( binFile, bin, len ) )
+      SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Compiled %s to %s\n", file, binFile);
+  }
+
+  h = (levelBinHeader_t*)bin;
+  memcpy( cells, h->cells, sizeof(h->cells) );
+  li = levelIndexMkInfo( &h->r, (const int32_t*)(bin+sizeof(levelBinHeader_t)),
+                         (const char*)(bin+sizeof(levelBinHeader_t)+sizeof(int32_t)*4*h->numTele) );
+  free( bin );
+  return(li);
+}
+
+void levelBinInvalidate(const char* file)
+{
+  char binFile[1024];
+  levelBinFileName( binFile, sizeof(binFile), file );
+  remove( binFile );
+}
@@ -0,0 +1,42 @@
+#ifndef LEVELBIN_H_INCLUDED
+#define LEVELBIN_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdint.h>
+#include "defs.h"
+#include "levels.h"
+
+//Compiled levels: The header, teleports, switches, strings and one byte per cell of a level,
+//loaded with a single read and no parsing. The .wzp stays the source, compiled levels are kept
+//in a cache in the config dir and rebuilt when the .wzp or the build changes.
+//File: header (with the levelIndexRecord_t of the level), cells, teleports and switches (4 int32 each), strings.
+//Like the level index it never leaves the device, so it's in host byte order.
+
+#define LEVELBIN_IDENT "WZLB"
+#define LEVELBIN_VERSION 1
+#define LEVELBIN_DIR "levelbin"
+
+//Load a level and its cells (brick type of each cell, [x][y]) from the compiled level in the cache,
+//compiling it first if it's missing or stale. Returns a new levelInfo_t, or NULL if the level couldn't be loaded.
+levelInfo_t* levelBinLoad(const char* file, uint8_t cells[FIELDSIZE][FIELDSIZE]);
+
+//Drop the compiled level for file, call after writing file.
+void levelBinInvalidate(const char* file);
+
+#endif // LEVELBIN_H_INCLUDED
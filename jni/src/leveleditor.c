@@ -32,6 +32,9 @@
 
 #include "transition.h"
 #include "defs.h"
+#include "pack.h"
+#include "preview.h"
+#include "solver.h"
 
 #define EDITOR_MAIN 0
 #define EDITOR_BRICKS_SELECTION 1
@@ -60,14 +63,12 @@ void editorLoad(const char* fn, SDL_Surface* screen)
 
   //Init cursor
   initCursor(&cur);
-  //Read info's for level.
-  pf.levelInfo = mkLevelInfo( fn );
-  //Load field
-  loadField(&pf, fn);
+  //Read info's and field in one pass, from the .wzp that is saved to.
+  loadLevelWzp(&pf, fn);
 
   initDraw(pf.levelInfo, screen);
   SDL_FreeSurface(stealGfxPtr()->boardImg);
-  stealGfxPtr()->boardImg = loadImg( "data/editbg.png" );
+  stealGfxPtr()->boardImg = imgCacheGet( "data/editbg.png" );
 
   selBrickBG = loadImg( "data/editselbrick.png" );
 
@@ -95,6 +96,9 @@ void editorCleanUp()
   resetBtn(C_BTNX);
   resetBtn(C_BTNB);
 
+  //The search works on a copy, but there's no board to check anymore.
+  solverQuit();
+
   //Free memory used for levelInfo
   freeLevelInfo( &pf.levelInfo );
   //Free board and graphics here
@@ -161,6 +165,45 @@ void editAddToBoard(int s)
 }
 
 
+static void editorDrawSolver(SDL_Surface* screen)
+{
+  solverResult_t r;
+  char buf[32];
+  const char* state=NULL;
+
+  solverGetResult(&r);
+  buf[0]=0;
+  switch(r.state)
+  {
+    case SOLVER_RUNNING:
+      state=STR_EDIT_SOLVER_CHECKING;
+      if(r.best)
+        sprintf(buf, STR_EDIT_SOLVER_AT_MOST, r.best);
+      else if(r.moves)
+        sprintf(buf, STR_EDIT_SOLVER_MORE_THAN, r.moves);
+    break;
+    case SOLVER_SOLVABLE:
+      state=STR_EDIT_SOLVER_SOLVABLE;
+      sprintf(buf, STR_EDIT_SOLVER_MOVES, r.moves);
+    break;
+    case SOLVER_UNSOLVABLE:
+      state=STR_EDIT_SOLVER_UNSOLVABLE;
+    break;
+    case SOLVER_UNKNOWN:
+      state=STR_EDIT_SOLVER_UNKNOWN;
+      if(r.moves)
+        sprintf(buf, STR_EDIT_SOLVER_MORE_THAN, r.moves);
+    break;
+  }
+
+  if(state)
+  {
+    txtWriteCenter(screen, FONTSMALL, STR_EDIT_SOLVER, HSCREENW-115,HSCREENH-25);
+    txtWriteCenter(screen, FONTSMALL, state, HSCREENW-115,HSCREENH-16);
+    txtWriteCenter(screen, FONTSMALL, buf, HSCREENW-115,HSCREENH-7);
+  }
+}
+
 int runEditor(SDL_Surface* screen)
 {
   SDL_Rect selBrickRect;
@@ -342,6 +385,9 @@ int runEditor(SDL_Surface* screen)
       pf.levelInfo->completable=0;
       if( saveLevel(fileName, &pf) )
       {
+        //The level selector shows fileName.png, drawn with the themes of the current pack.
+        previewMake(fileName, packState()->cp->path);
+
         //Refresh the list of userLevels.
         addUserLevel(fileName);
         changed=0;
@@ -352,6 +398,8 @@ int runEditor(SDL_Surface* screen)
 
   } //Editor in main state, don't ignore input
 
+  //Each edit starts a new search in the background
+  solverCheckField(&pf);
 
   draw(&cur, &pf, screen);
 
@@ -369,6 +417,8 @@ int runEditor(SDL_Surface* screen)
 
   txtWriteCenter(screen, FONTSMALL,fileName, HSCREENW,HSCREENH+110);
 
+  editorDrawSolver(screen);
+
   //Draw the currently selected brick.
   drawBrick(screen, selBrick,HSCREENW-125,HSCREENH-85);
 
@@ -0,0 +1,448 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <SDL.h>
+
+#include "levelindex.h"
+#include "levels.h"
+#include "teleport.h"
+#include "strings.h"
+#include "userfiles.h"
+
+//The strings of a levelInfo_t that are kept in the index (musicFile is set by pack.c)
+static const size_t strFields[] = {
+  offsetof(levelInfo_t, file),
+  offsetof(levelInfo_t, imgFile),
+  offsetof(levelInfo_t, author),
+  offsetof(levelInfo_t, levelName),
+  offsetof(levelInfo_t, tileBase),
+  offsetof(levelInfo_t, explBase),
+  offsetof(levelInfo_t, wallBase),
+  offsetof(levelInfo_t, bgFile),
+  offsetof(levelInfo_t, soundDir),
+  offsetof(levelInfo_t, fontName),
+  offsetof(levelInfo_t, cursorFile),
+  offsetof(levelInfo_t, startImg),
+  offsetof(levelInfo_t, stopImg)
+};
+//Fails to compile if LEVELINDEX_NUM_STR doesn't match the table
+typedef char levelIndexNumStrCheck[ (sizeof(strFields)/sizeof(strFields[0]) == LEVELINDEX_NUM_STR)?1:-1 ];
+
+#define INFOSTR(LI, N) (*(char**)( ((char*)(LI))+strFields[N] ))
+
+//The index is a cache that never leaves the device, so it's in host byte order.
+//File: header, records, teleports and switches (4 int32 each, in record order), strings.
+typedef struct {
+  char ident[4];
+  uint32_t version;
+  uint32_t build; //Hash of getAppStamp()
+  uint32_t dirStr; //Offset of the level dir name in the strings
+  int64_t stampTime; //Stamp of the level dir
+  int64_t stampSize;
+  uint32_t numLevels;
+  uint32_t numTele;
+  uint32_t strLen;
+  uint32_t pad;
+} levelIndexHeader_t;
+
+typedef struct {
+  levelInfo_t* li;
+  int64_t mtime;
+  int64_t size;
+} levelIndexEntry_t;
+
+uint32_t levelIndexHashMem(const void* data, size_t len)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  uint32_t h=2166136261u;
+  while( len-- )
+  {
+    h ^= *p++;
+    h *= 16777619u;
+  }
+  return(h);
+}
+
+uint32_t levelIndexHash(const char* str)
+{
+  return( levelIndexHashMem(str, strlen(str)) );
+}
+
+static void levelIndexFileName(char* buf, size_t len, const char* levelDir)
+{
+  snprintf( buf, len, "%s/levelindex_%08x.bin", getConfigDir(), levelIndexHash(levelDir) );
+}
+
+//mtime and size of path, both 0 if it can't be stat()'ed.
+void levelIndexStamp(const char* path, int64_t* mtime, int64_t* size)
+{
+  struct stat st;
+  *mtime=0;
+  *size=0;
+  if( stat(path, &st)==0 )
+  {
+    *mtime = st.st_mtime;
+    *size = st.st_size;
+  }
+}
+
+//Levels in an archive can't be stat()'ed, but the archive can, it's the parent of the levels dir.
+void levelIndexDirStamp(const char* levelDir, int64_t* mtime, int64_t* size)
+{
+  char buf[1024];
+  char* p;
+  levelIndexStamp( levelDir, mtime, size );
+  if( !*mtime )
+  {
+    snprintf( buf, sizeof(buf), "%s", levelDir );
+    p = strrchr( buf, '/' );
+    if( p )
+    {
+      *p=0;
+      levelIndexStamp( buf, mtime, size );
+    }
+  }
+}
+
+//Read and validate the index, returns NULL if it's missing, stale or broken.
+static uint8_t* levelIndexRead(const char* fileName, const char* levelDir)
+{
+  FILE* f;
+  long len;
+  uint8_t* idx=NULL;
+  levelIndexHeader_t* h;
+  levelIndexRecord_t* r;
+  const char* strs;
+  uint32_t i, numTele=0;
+
+  f = fopen( fileName, "rb" );
+  if( !f )
+    return(NULL);
+
+  fseek( f, 0L, SEEK_END );
+  len = ftell( f );
+  fseek( f, 0L, SEEK_SET );
+
+  if( len >= (long)sizeof(levelIndexHeader_t) )
+  {
+    idx = malloc( len );
+    if( idx && fread( idx, len, 1, f ) != 1 )
+    {
+      free(idx);
+      idx=NULL;
+    }
+  }
+  fclose(f);
+
+  if( !idx )
+    return(NULL);
+
+  h = (levelIndexHeader_t*)idx;
+  r = (levelIndexRecord_t*)(idx+sizeof(levelIndexHeader_t));
+  strs = (const char*)(idx+len-h->strLen);
+
+  if( memcmp( h->ident, LEVELINDEX_IDENT, 4 ) != 0 || h->version != LEVELINDEX_VERSION || h->build != levelIndexHash(getAppStamp()) )
+  {
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Level index for %s is from another version, rebuilding.\n", levelDir);
+    free(idx);
+    return(NULL);
+  }
+
+  //Sizes must add up, strings must end with a terminator and it must be the index for this dir.
+  if( h->numLevels > (uint32_t)len/sizeof(levelIndexRecord_t) || h->numTele > (uint32_t)len/(sizeof(int32_t)*4) || h->strLen == 0 ||
+      (uint64_t)sizeof(levelIndexHeader_t) + (uint64_t)h->numLevels*sizeof(levelIndexRecord_t) + (uint64_t)h->numTele*sizeof(int32_t)*4 + h->strLen != (uint64_t)len ||
+      strs[h->strLen-1] != 0 || h->dirStr >= h->strLen || strcmp( strs+h->dirStr, levelDir ) != 0 )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Level index %s is broken, rebuilding.\n", fileName);
+    free(idx);
+    return(NULL);
+  }
+
+  for( i=0; i < h->numLevels; i++ )
+  {
+    numTele += r[i].numTele + r[i].numSwitch;
+    if( !levelIndexRecordOk( &r[i], h->strLen ) )
+      numTele = h->numTele+1;
+  }
+
+  if( numTele != h->numTele )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Level index %s is broken, rebuilding.\n", fileName);
+    free(idx);
+    return(NULL);
+  }
+
+  return(idx);
+}
+
+int levelIndexRecordOk(const levelIndexRecord_t* r, uint32_t strLen)
+{
+  uint32_t n;
+  for( n=0; n < LEVELINDEX_NUM_STR; n++ )
+  {
+    if( r->str[n] != LEVELINDEX_NO_STR && r->str[n] >= strLen )
+      return(0);
+  }
+  return(1);
+}
+
+//Make a levelInfo_t from a record, tele points to its teleports followed by its switches.
+levelInfo_t* levelIndexMkInfo(const levelIndexRecord_t* r, const int32_t* tele, const char* strs)
+{
+  uint32_t n;
+  levelInfo_t* tl = malloc( sizeof(levelInfo_t) );
+  memset( tl, 0, sizeof(levelInfo_t) );
+
+  for( n=0; n < LEVELINDEX_NUM_STR; n++ )
+  {
+    if( r->str[n] != LEVELINDEX_NO_STR )
+      INFOSTR(tl,n) = levelInfoStr( strFields[n], strs+r->str[n] );
+  }
+
+  tl->time = r->time;
+  tl->brick_die_ticks = r->brickDieTicks;
+  tl->brickDieParticles = r->brickDieParticles;
+  tl->showTelePath = r->showTelePath;
+  tl->showSwitchPath = r->showSwitchPath;
+  tl->completable = r->completable;
+
+  tl->teleList = listInit(free);
+  for( n=0; n < r->numTele; n++, tele+=4 )
+    teleAddToList( tl->teleList, tele[0], tele[1], tele[2], tele[3] );
+
+  tl->switchList = listInit(free);
+  for( n=0; n < r->numSwitch; n++, tele+=4 )
+    teleAddToList( tl->switchList, tele[0], tele[1], tele[2], tele[3] );
+
+  return(tl);
+}
+
+uint32_t levelIndexAddStr(levelIndexStrings_t* s, const char* str)
+{
+  uint32_t ofs=s->len;
+  uint32_t l;
+  if( !str )
+    return(LEVELINDEX_NO_STR);
+
+  l = strlen(str)+1;
+  if( s->len+l > s->size )
+  {
+    s->size = (s->size+l)*2;
+    s->data = realloc( s->data, s->size );
+  }
+  memcpy( s->data+s->len, str, l );
+  s->len += l;
+  return(ofs);
+}
+
+static void levelIndexAddTele(list_t* l, int32_t** tele)
+{
+  listItem* it=&l->begin;
+  telePort_t* t;
+  while( LISTFWD(l,it) )
+  {
+    t = (telePort_t*)it->data;
+    (*tele)[0]=t->sx;
+    (*tele)[1]=t->sy;
+    (*tele)[2]=t->dx;
+    (*tele)[3]=t->dy;
+    (*tele) += 4;
+  }
+}
+
+void levelIndexFillRecord(levelIndexRecord_t* r, levelInfo_t* li, levelIndexStrings_t* strs, int32_t** tele)
+{
+  uint32_t n;
+  r->time = li->time;
+  r->brickDieTicks = li->brick_die_ticks;
+  r->brickDieParticles = li->brickDieParticles;
+  r->showTelePath = li->showTelePath;
+  r->showSwitchPath = li->showSwitchPath;
+  r->completable = li->completable;
+  r->numTele = li->teleList->count;
+  r->numSwitch = li->switchList->count;
+  for( n=0; n < LEVELINDEX_NUM_STR; n++ )
+    r->str[n] = levelIndexAddStr( strs, INFOSTR(li,n) );
+  levelIndexAddTele( li->teleList, tele );
+  levelIndexAddTele( li->switchList, tele );
+}
+
+//Write a new index, through a temporary file so a crash never leaves half an index.
+static void levelIndexWrite(const char* fileName, const char* levelDir, int64_t stampTime, int64_t stampSize, levelIndexEntry_t* e, int num)
+{
+  char tmpName[1024];
+  levelIndexHeader_t h;
+  levelIndexRecord_t* r;
+  levelIndexStrings_t strs;
+  int32_t* tele;
+  int32_t* t;
+  int i, ok;
+  FILE* f;
+
+  if( snprintf( tmpName, sizeof(tmpName), "%s.tmp", fileName ) >= (int)sizeof(tmpName) )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Level index name %s is too long.\n", fileName);
+    return;
+  }
+
+  memset( &h, 0, sizeof(h) );
+  memset( &strs, 0, sizeof(strs) );
+  memcpy( h.ident, LEVELINDEX_IDENT, 4 );
+  h.version = LEVELINDEX_VERSION;
+  h.build = levelIndexHash(getAppStamp());
+  h.stampTime = stampTime;
+  h.stampSize = stampSize;
+  h.numLevels = num;
+  h.dirStr = levelIndexAddStr( &strs, levelDir );
+
+  for( i=0; i < num; i++ )
+    h.numTele += e[i].li->teleList->count + e[i].li->switchList->count;
+
+  r = malloc( sizeof(levelIndexRecord_t)*num+1 );
+  t = tele = malloc( sizeof(int32_t)*4*h.numTele+1 );
+
+  for( i=0; i < num; i++ )
+  {
+    memset( &r[i], 0, sizeof(levelIndexRecord_t) );
+    r[i].mtime = e[i].mtime;
+    r[i].size = e[i].size;
+    levelIndexFillRecord( &r[i], e[i].li, &strs, &t );
+  }
+  h.strLen = strs.len;
+
+  f = fopen( tmpName, "wb" );
+  if( f )
+  {
+    ok = ( fwrite( &h, sizeof(h), 1, f ) == 1 );
+    if( ok && num )
+      ok = ( fwrite( r, sizeof(levelIndexRecord_t), num, f ) == (size_t)num );
+    if( ok && h.numTele )
+      ok = ( fwrite( tele, sizeof(int32_t)*4, h.numTele, f ) == h.numTele );
+    if( ok )
+      ok = ( fwrite( strs.data, strs.len, 1, f ) == 1 );
+    if( fclose(f) != 0 )
+      ok=0;
+
+    if( ok && rename( tmpName, fileName ) == 0 )
+    {
+      SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Wrote level index for %s (%i levels).\n", levelDir, num);
+    } else {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Could not write level index %s\n", fileName);
+      remove( tmpName );
+    }
+  } else {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Could not open %s for writing.\n", tmpName);
+  }
+
+  free( r );
+  free( tele );
+  free( strs.data );
+}
+
+int levelIndexLoad(const char* levelDir, array_t* list)
+{
+  char idxFile[1024];
+  char buf[1024];
+  uint8_t* idx;
+  levelIndexHeader_t* h=NULL;
+  levelIndexRecord_t* r=NULL;
+  const int32_t* tele=NULL;
+  const char* strs=NULL;
+  levelIndexEntry_t* e=NULL;
+  levelInfo_t* tl;
+  int64_t dirTime, dirSize, mtime, size;
+  int num=0, size_e=0, parsed=0, trustCount=0, dirty=0;
+
+  levelIndexFileName( idxFile, sizeof(idxFile), levelDir );
+  levelIndexDirStamp( levelDir, &dirTime, &dirSize );
+
+  idx = levelIndexRead( idxFile, levelDir );
+  if( idx )
+  {
+    h = (levelIndexHeader_t*)idx;
+    r = (levelIndexRecord_t*)(idx+sizeof(levelIndexHeader_t));
+    tele = (const int32_t*)(r+h->numLevels);
+    strs = (const char*)(tele+4*h->numTele);
+    //If the dir is unchanged, no levels were added or removed.
+    trustCount = ( h->stampTime == dirTime && h->stampSize == dirSize );
+  } else {
+    dirty=1;
+  }
+
+  while(1)
+  {
+    if( h && trustCount && (uint32_t)num >= h->numLevels )
+      break;
+
+    sprintf( buf, "%s/level%03i.wzp", levelDir, num );
+    levelIndexStamp( buf, &mtime, &size );
+
+    tl=NULL;
+    //Levels without a stamp of their own are only as fresh as the dir.
+    if( h && (uint32_t)num < h->numLevels && r->mtime == mtime && r->size == size && (mtime || trustCount) )
+    {
+      tl = levelIndexMkInfo( r, tele, strs );
+    }
+
+    if( !tl )
+    {
+      tl = mkLevelInfo( buf );
+      dirty=1;
+      if( !tl )
+        break;
+      parsed++;
+    }
+
+    if( num == size_e )
+    {
+      size_e = (size_e)?size_e*2:64;
+      e = realloc( e, sizeof(levelIndexEntry_t)*size_e );
+    }
+    e[num].li = tl;
+    e[num].mtime = mtime;
+    e[num].size = size;
+    arrayAppendData( list, (void*)tl );
+
+    if( h && (uint32_t)num < h->numLevels )
+    {
+      tele += 4*(r->numTele+r->numSwitch);
+      r++;
+    }
+    num++;
+  }
+
+  //Less levels than the index knew about also changes the index
+  if( h && (uint32_t)num != h->numLevels )
+    dirty=1;
+
+  if( dirty )
+  {
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Level index for %s: %i levels, %i parsed.\n", levelDir, num, parsed);
+    levelIndexWrite( idxFile, levelDir, dirTime, dirSize, e, num );
+  }
+
+  free( e );
+  free( idx );
+  return(num);
+}
@@ -0,0 +1,77 @@
+#ifndef LEVELINDEX_H_INCLUDED
+#define LEVELINDEX_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "list/list.h"
+#include "levels.h"
+
+//Binary cache of the level headers in a level dir, so a warm startup reads one file
+//instead of parsing every level. Kept in the config dir, one file per level dir.
+//Levels are checked against their mtime and size, levels that can't be stat()'ed
+//(apk assets, archives) against the stamp of the dir and of the install, see getAppStamp().
+
+#define LEVELINDEX_IDENT "WZLI"
+#define LEVELINDEX_VERSION 1
+
+//A level header as a fixed size record, its strings are offsets into a string table.
+//Also used by the compiled levels in levelbin.c
+#define LEVELINDEX_NUM_STR 13
+#define LEVELINDEX_NO_STR 0xFFFFFFFFu
+
+typedef struct {
+  int64_t mtime; //0 if the level could not be stat()'ed
+  int64_t size;
+  int32_t time;
+  int32_t brickDieTicks;
+  int32_t brickDieParticles;
+  uint8_t showTelePath;
+  uint8_t showSwitchPath;
+  uint8_t completable;
+  uint8_t pad;
+  uint16_t numTele;
+  uint16_t numSwitch;
+  uint32_t str[LEVELINDEX_NUM_STR];
+} levelIndexRecord_t;
+
+//String table being collected
+typedef struct {
+  char* data;
+  uint32_t len;
+  uint32_t size;
+} levelIndexStrings_t;
+
+//FNV-1a, the one hash for names, checksums and the like everywhere in the game.
+uint32_t levelIndexHashMem(const void* data, size_t len);
+uint32_t levelIndexHash(const char* str);
+void levelIndexStamp(const char* path, int64_t* mtime, int64_t* size); //Both 0 if it can't be stat()'ed
+void levelIndexDirStamp(const char* levelDir, int64_t* mtime, int64_t* size); //Stamp of the dir, or its parent if it can't be stat()'ed
+uint32_t levelIndexAddStr(levelIndexStrings_t* s, const char* str); //Returns offset of str in the table
+//Fill r from li, adds its strings to strs and writes its teleports, then switches, at *tele (4 int32 each) and advances it.
+void levelIndexFillRecord(levelIndexRecord_t* r, levelInfo_t* li, levelIndexStrings_t* strs, int32_t** tele);
+int levelIndexRecordOk(const levelIndexRecord_t* r, uint32_t strLen); //String offsets are inside the table
+//Make a levelInfo_t from a record, tele points to its teleports followed by its switches.
+levelInfo_t* levelIndexMkInfo(const levelIndexRecord_t* r, const int32_t* tele, const char* strs);
+
+//Appends a levelInfo_t* for each levelNNN.wzp in levelDir to list, like mkLevelInfo would,
+//and brings the index up to date. Returns the number of levels added.
+int levelIndexLoad(const char* levelDir, array_t* list);
+
+#endif // LEVELINDEX_H_INCLUDED
@@ -19,253 +19,364 @@
 #include "list/list.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "strings.h"
 #include "teleport.h"
 #include "pack.h"
 #include "platform/androidUtils.h"
 #include "userfiles.h"
+#include "levelindex.h"
+
+static array_t* userLevelFiles;
+
+//Keys of a level file, dispatched through a perfect hash of exactly these keys.
+enum {
+  LVLKEY_NONE=0,
+  LVLKEY_SECONDS,
+  LVLKEY_BGFILE,
+  LVLKEY_TILEBASE,
+  LVLKEY_EXPLBASE,
+  LVLKEY_WALLBASE,
+  LVLKEY_AUTHOR,
+  LVLKEY_LEVELNAME,
+  LVLKEY_SOUNDDIR,
+  LVLKEY_CHARBASE,
+  LVLKEY_CURSORFILE,
+  LVLKEY_STARTIMAGE,
+  LVLKEY_STOPIMAGE,
+  LVLKEY_BRICKDIETIME,
+  LVLKEY_BRICKDIEPARTICLES,
+  LVLKEY_TELEPORT,
+  LVLKEY_SWITCH,
+  LVLKEY_SHOWTELEPATH,
+  LVLKEY_SHOWSWITCHPATH,
+  LVLKEY_COMPLETABLE
+};
+
+//Length, first and last char give each key its own slot, adding a key means finding new factors.
+#define LVLKEY_HASH(KEY, LEN) ( ((LEN) + 11*(uint8_t)(KEY)[0] + 17*(uint8_t)(KEY)[(LEN)-1]) & 31 )
+
+static const struct { const char* key; int id; } levelKeys[32] = {
+  [0]  = { "cursorfile", LVLKEY_CURSORFILE },
+  [1]  = { "completable", LVLKEY_COMPLETABLE },
+  [2]  = { "levelname", LVLKEY_LEVELNAME },
+  [3]  = { "author", LVLKEY_AUTHOR },
+  [5]  = { "showtelepath", LVLKEY_SHOWTELEPATH },
+  [7]  = { "showswitchpath", LVLKEY_SHOWSWITCHPATH },
+  [10] = { "brickdieparticles", LVLKEY_BRICKDIEPARTICLES },
+  [11] = { "sounddir", LVLKEY_SOUNDDIR },
+  [15] = { "stopimage", LVLKEY_STOPIMAGE },
+  [16] = { "startimage", LVLKEY_STARTIMAGE },
+  [17] = { "bgfile", LVLKEY_BGFILE },
+  [20] = { "explbase", LVLKEY_EXPLBASE },
+  [23] = { "brickdietime", LVLKEY_BRICKDIETIME },
+  [24] = { "teleport", LVLKEY_TELEPORT },
+  [25] = { "tilebase", LVLKEY_TILEBASE },
+  [26] = { "wallbase", LVLKEY_WALLBASE },
+  [27] = { "seconds", LVLKEY_SECONDS },
+  [30] = { "charbase", LVLKEY_CHARBASE },
+  [31] = { "switch", LVLKEY_SWITCH }
+};
+
+static int levelKey(const char* key)
+{
+  size_t len = strlen(key);
+  int h;
+  if( !len )
+    return(LVLKEY_NONE);
+  h = LVLKEY_HASH(key, len);
+  if( levelKeys[h].key && strcmp( levelKeys[h].key, key )==0 )
+    return( levelKeys[h].id );
+  return(LVLKEY_NONE);
+}
 
-static list_t* userLevelFiles;
+//Strings of a levelInfo_t that are interned. Levels of a pack share a handful of themes,
+//so each distinct value is kept once, and never freed.
+static const size_t internedStr[] = {
+  offsetof(levelInfo_t, author),
+  offsetof(levelInfo_t, tileBase),
+  offsetof(levelInfo_t, explBase),
+  offsetof(levelInfo_t, wallBase),
+  offsetof(levelInfo_t, bgFile),
+  offsetof(levelInfo_t, musicFile),
+  offsetof(levelInfo_t, soundDir),
+  offsetof(levelInfo_t, fontName),
+  offsetof(levelInfo_t, cursorFile),
+  offsetof(levelInfo_t, startImg),
+  offsetof(levelInfo_t, stopImg)
+};
+
+char* levelInfoStr(size_t field, const char* str)
+{
+  unsigned int i;
+  char* s;
+  for(i=0; i < sizeof(internedStr)/sizeof(internedStr[0]); i++)
+  {
+    if( internedStr[i]==field )
+      return( (char*)strIntern(str) );
+  }
+  s = malloc( sizeof(char)*(strlen(str)+1) );
+  strcpy( s, str );
+  return(s);
+}
 
-//Returns pointr to levelInfo_t if level successfully opened, returns nullptr if not.
-levelInfo_t* mkLevelInfo(const char* fileName)
+//All of fileName in a new 0 terminated buffer, read in one go.
+static char* levelReadFile(const char* fileName)
 {
-  int gotData=0; //If this is still 0 after the loop, level has no [data]
-  FILE *f;
-  levelInfo_t* tl; //Temp levelInfo.
-  char* buf = malloc(sizeof(char)*256); //Read line buffer
-  char* set = malloc(sizeof(char)*128); //Buffer for storing setting
-  char* val = malloc(sizeof(char)*128); //Buffer for storing value
+  FILE* f;
+  long len;
+  char* buf=NULL;
 
-  tl=0; //Return null ptr if no file is found (malloc won't get called then)
   f = android_fopen(fileName, "r");
   if(f == NULL) {
 	  f = fopen(fileName, "r");
   }
-  if(f)
+  if(!f)
   {
-    //Allocate memory for level info.
-    tl=malloc(sizeof(levelInfo_t));
+    return(NULL);
+  }
 
-    //Set everything 0.
-    memset(tl, 0, sizeof(levelInfo_t));
+  fseek( f, 0L, SEEK_END );
+  len = ftell( f );
+  fseek( f, 0L, SEEK_SET );
 
-    //Level file name
-    tl->file=malloc( sizeof(char)*( strlen(fileName)+1 ) );
-    strcpy(tl->file, fileName);
+  if( len >= 0 )
+  {
+    buf = malloc( len+1 );
+    if( buf )
+    {
+      len = fread( buf, 1, len, f );
+      buf[len]=0;
+    }
+  }
+  fclose(f);
+  return(buf);
+}
 
-    //preview file name
-    sprintf( buf, "%s.png", fileName);
-    tl->imgFile=malloc( sizeof(char)*( strlen(buf)+1 ) );
-    strcpy(tl->imgFile, buf);
+//The grid after [data], two digits per cell, one line per row.
+static int levelParseCells(const char* p, uint8_t cells[FIELDSIZE][FIELDSIZE])
+{
+  char temp[3];
+  int x=0,y=0;
 
-    //default char map
-    strcpy( buf, "charmap" );
-    tl->fontName=malloc( sizeof(char)*( strlen(buf)+1) );
-    strcpy( tl->fontName, buf );
+  temp[2]=0;
+  memset( cells, 0, sizeof(uint8_t)*FIELDSIZE*FIELDSIZE );
 
-    //Default cursor
-    strcpy( buf, "cursor.png" );
-    tl->cursorFile=malloc( sizeof(char)*(strlen(buf)+1) );
-    strcpy( tl->cursorFile, buf );
+  while( *p )
+  {
+    if( *p=='\n' )
+    {
+      y++;
+      x=0;
+      if(y == FIELDSIZE)
+      {
+        break;
+      }
+      p++;
+    } else if( *p=='\r' )
+    {
+      //Ignore windows wanting to run on a typewriter.
+      p++;
+    } else {
+      if(x==FIELDSIZE)
+      {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Error loading level, bail before accesing invalid index");
+        return(0);
+      }
+      temp[0]=p[0];
+      temp[1]=p[1];
+      cells[x][y]=atoi(temp);
+      p += (p[1])?2:1;
+      x++;
+    }
+  }
+  return(1);
+}
 
-    //start/stop images
-    tl->startImg=0;
-    tl->stopImg=0;
+//Returns pointr to levelInfo_t if level successfully opened, returns nullptr if not.
+levelInfo_t* mkLevelInfo(const char* fileName)
+{
+  return( mkLevelInfoCells(fileName, NULL) );
+}
 
-    //Default brick die time
-    tl->brick_die_ticks=500;
+levelInfo_t* mkLevelInfoCells(const char* fileName, uint8_t cells[FIELDSIZE][FIELDSIZE])
+{
+  int gotData=0; //If this is still 0 after the loop, level has no [data]
+  levelInfo_t* tl; //Temp levelInfo.
+  char* data;
+  char* line;
+  char* next;
+  char* val;
+  char buf[1024];
+
+  //The whole file is read at once, lines are cut in place and values point into it.
+  data = levelReadFile(fileName);
+  if(!data)
+  {
+    return(NULL);
+  }
 
-    tl->brickDieParticles=1;
+  //Allocate memory for level info, everything 0.
+  tl=malloc(sizeof(levelInfo_t));
+  memset(tl, 0, sizeof(levelInfo_t));
+
+  //Level file name
+  tl->file=malloc( sizeof(char)*( strlen(fileName)+1 ) );
+  strcpy(tl->file, fileName);
+
+  //preview file name
+  snprintf( buf, sizeof(buf), "%s.png", fileName);
+  tl->imgFile=malloc( sizeof(char)*( strlen(buf)+1 ) );
+  strcpy(tl->imgFile, buf);
 
-    //Initialize teleList
-    tl->teleList = listInit(free);
+  //default char map and cursor
+  tl->fontName=(char*)strIntern("charmap");
+  tl->cursorFile=(char*)strIntern("cursor.png");
 
-    //Initialize switchlist
-    tl->switchList = listInit(free);
+  //Default brick die time
+  tl->brick_die_ticks=500;
+  tl->brickDieParticles=1;
 
-    //Show the teleport destination
-    tl->showTelePath = 1;
+  tl->teleList = listInit(free);
+  tl->switchList = listInit(free);
 
-    tl->showSwitchPath = 0;
+  //Show the teleport destination
+  tl->showTelePath = 1;
 
-    tl->completable = 0;
+  for( line=data; *line; line=next )
+  {
+    //Cut the line at its end, we don't want \r or \n in it.
+    next = strchr( line, '\n' );
+    next = (next)?next+1:line+strlen(line);
+    line[ strcspn( line, "\r\n" ) ] = 0;
 
-    //Loop through file
-    while(fgets(buf, 255, f))
+    //Stop reading when we reach [data]
+    if(strcmp(line,"[data]")==0)
     {
-      //We don't want \r or \n in the end of the string.
-      stripNewLine(buf);
-      //Stop reading when we reach [data]
-      if(strcmp(buf,"[data]")==0)
-      {
-        gotData=1;
-        break;
-      } else {
-        //Try and split string at =
-        if(splitVals('=',buf, set,val) )
-        {
-          //Check what we got.
-          //Time left?
-          if(strcmp("seconds",set)==0)
-          {
-            tl->time=atoi(val);
-          } else
-          if(strcmp("bgfile",set)==0)
-          {
-            tl->bgFile=malloc( sizeof(char)*( strlen(val)+1 ) );
-            strcpy(tl->bgFile, val);
-          } else
-          if(strcmp("tilebase",set)==0)
-          {
-            tl->tileBase=malloc( sizeof(char)*( strlen(val)+1 ) );
-            strcpy(tl->tileBase, val);
-          } else
-          if(strcmp("explbase",set)==0)
-          {
-            tl->explBase=malloc( sizeof(char)*( strlen(val)+1 ) );
-            strcpy(tl->explBase, val);
-          } else
-          if(strcmp("wallbase",set)==0)
-          {
-            tl->wallBase=malloc( sizeof(char)*( strlen(val)+1 ) );
-            strcpy(tl->wallBase, val);
-          } else
-          if(strcmp("author",set)==0)
-          {
-            tl->author=malloc( sizeof(char)*( strlen(val)+1 ) );
-            strcpy(tl->author, val);
-          } else
-          if(strcmp("levelname",set)==0)
-          {
-            tl->levelName=malloc( sizeof(char)*( strlen(val)+1 ) );
-            strcpy(tl->levelName, val);
-          } else
-          if(strcmp("sounddir",set)==0)
-          {
-            tl->soundDir=malloc( sizeof(char)*( strlen(val)+1 ) );
-            strcpy(tl->soundDir, val);
-          } else
-          if(strcmp("charbase",set)==0)
-          {
-            free(tl->fontName);
-            tl->fontName=malloc( sizeof(char)*( strlen(val)+1 ) );
-            strcpy(tl->fontName, val);
-          } else
-          if(strcmp("cursorfile",set)==0)
-          {
-            free( tl->cursorFile );
-            tl->cursorFile=malloc( sizeof(char)*( strlen(val)+1 ) );
-            strcpy(tl->cursorFile, val);
-          } else
-          if(strcmp("startimage",set)==0)
-          {
-            //Ignore none keyword for start image
-            if( strcmp( "none", val) != 0)
-            {
-              tl->startImg=malloc( sizeof(char)*( strlen(val)+1 ) );
-              strcpy(tl->startImg, val);
-            }
-          } else
-          if(strcmp("stopimage", set)==0)
-          {
-            //Ignore none keyword for stop image
-            if( strcmp( "none", val) != 0)
-            {
-              tl->stopImg=malloc( sizeof(char)*( strlen(val)+1 ) );
-              strcpy(tl->stopImg, val);
-            }
-          } else
-          if(strcmp("brickdietime", set)==0)
-          {
-            tl->brick_die_ticks=atoi(val);
-          } else
-          if(strcmp("brickdieparticles", set)==0)
-          {
-            tl->brickDieParticles=atoi(val);
-          } else
-          if(strcmp("teleport", set)==0)
-          {
-            teleAddFromString(tl->teleList, val);
-          } else
-          if(strcmp("switch", set)==0)
-          {
-            //Yes, it's the same format, how neat.
-            teleAddFromString(tl->switchList, val);
-          } else
-          if(strcmp("showtelepath", set)==0)
-          {
-            tl->showTelePath=atoi(val);
-          } else
-          if(strcmp("showswitchpath", set)==0)
-          {
-            tl->showSwitchPath=atoi(val);
-          } else
-          if(strcmp("completable", set)==0)
-          {
-            tl->completable=atoi(val);
-          }
-        } //Got a = in the line
-      } //Not [data]
-    } //Reading file
-    //Close file
-    fclose(f);
+      gotData=1;
+      break;
+    }
+
+    //setting=value, # is a comment
+    val = (line[0]!='#')?strchr( line, '=' ):NULL;
+    if(!val)
+    {
+      continue;
+    }
+    *val++ = 0;
+
+    switch( levelKey(line) )
+    {
+      case LVLKEY_SECONDS:
+        tl->time=atoi(val);
+      break;
+      case LVLKEY_BGFILE:
+        tl->bgFile=(char*)strIntern(val);
+      break;
+      case LVLKEY_TILEBASE:
+        tl->tileBase=(char*)strIntern(val);
+      break;
+      case LVLKEY_EXPLBASE:
+        tl->explBase=(char*)strIntern(val);
+      break;
+      case LVLKEY_WALLBASE:
+        tl->wallBase=(char*)strIntern(val);
+      break;
+      case LVLKEY_AUTHOR:
+        tl->author=(char*)strIntern(val);
+      break;
+      case LVLKEY_LEVELNAME:
+        free(tl->levelName);
+        tl->levelName=malloc( sizeof(char)*( strlen(val)+1 ) );
+        strcpy(tl->levelName, val);
+      break;
+      case LVLKEY_SOUNDDIR:
+        tl->soundDir=(char*)strIntern(val);
+      break;
+      case LVLKEY_CHARBASE:
+        tl->fontName=(char*)strIntern(val);
+      break;
+      case LVLKEY_CURSORFILE:
+        tl->cursorFile=(char*)strIntern(val);
+      break;
+      case LVLKEY_STARTIMAGE:
+        //Ignore none keyword for start image
+        if( strcmp( "none", val) != 0)
+          tl->startImg=(char*)strIntern(val);
+      break;
+      case LVLKEY_STOPIMAGE:
+        //Ignore none keyword for stop image
+        if( strcmp( "none", val) != 0)
+          tl->stopImg=(char*)strIntern(val);
+      break;
+      case LVLKEY_BRICKDIETIME:
+        tl->brick_die_ticks=atoi(val);
+      break;
+      case LVLKEY_BRICKDIEPARTICLES:
+        tl->brickDieParticles=atoi(val);
+      break;
+      case LVLKEY_TELEPORT:
+        teleAddFromString(tl->teleList, val);
+      break;
+      case LVLKEY_SWITCH:
+        //Yes, it's the same format, how neat.
+        teleAddFromString(tl->switchList, val);
+      break;
+      case LVLKEY_SHOWTELEPATH:
+        tl->showTelePath=atoi(val);
+      break;
+      case LVLKEY_SHOWSWITCHPATH:
+        tl->showSwitchPath=atoi(val);
+      break;
+      case LVLKEY_COMPLETABLE:
+        tl->completable=atoi(val);
+      break;
+    }
+  }
+
+  //The grid follows in the same buffer.
+  if( gotData && cells && !levelParseCells( next, cells ) )
+  {
+    gotData=0;
   }
 
+  free(data);
+
   if(!gotData)
   {
     //The reason we don't tell that there's no [data] section is because this
     //function is also used to check for the existance of levels, so it'd always
     //Return "no [data] found for the levelfile name just after the last level in a pack.
-    free(tl);
-    tl=0;
+    freeLevelInfo(&tl);
   }
 
-
-  free(set);
-  free(val);
-  free(buf);
-  set=0;
-  val=0;
-  buf=0;
-
   //Return ptr, is null if file couldnt be opened.
   return(tl);
-
 }
 
-list_t* makeLevelList(const char* dir)
+array_t* makeLevelList(const char* dir)
 {
-  int i=0;
   char* buf = malloc(sizeof(char)*1024);
 
-  //Init the list to hold the filenames
-  list_t * list = listInit(NULL);
+  //Init the array to hold the levels
+  array_t* list = arrayInit(NULL);
   levelInfo_t* tl;
 
-  //List all levels in dir.
-  while(1)
-  {
-    sprintf(buf, "%s/levels/level%03i.wzp",dir, i);
-    tl=mkLevelInfo( buf );
-    if(tl)
-    {
-      listAppendData(list, (void*)tl);
-    } else {
-      break;
-    }
-    i++; //Increment file-number.
-  }
+  //List all levels in dir, from the level index when it's up to date.
+  sprintf(buf, "%s/levels",dir);
+  levelIndexLoad( buf, list );
 
   // Add a "Completed" level at the very end of the list
   tl=malloc(sizeof(levelInfo_t));
   memset(tl, 0, sizeof(levelInfo_t));
 
-  sprintf( buf, packGetFile(NULL,"complete.png"),dir );
+  //Not packGetFile, levels are listed while the pack is loaded in the background.
+  sprintf( buf, "%s/complete.png", dir );
   tl->imgFile = malloc( sizeof(char)*(strlen(buf)+1) );
   strcpy(tl->imgFile, buf);
 
-  listAppendData(list, (void*)tl);
+  arrayAppendData(list, (void*)tl);
 
   free(buf);
   buf=0;
@@ -275,32 +386,8 @@ list_t* makeLevelList(const char* dir)
 void makeUserLevelList()
 {
    //List userlevels
-  userLevelFiles = listInit(NULL);
-  int i=0;
-
-  levelInfo_t* tl;
-  char* buf = malloc(sizeof(char)*256);
-  while(1)
-  {
-    sprintf(buf, "%s/level%03i.wzp", getUserLevelDir(), i);
-
-    tl=mkLevelInfo( buf );
-    if( tl )
-    {
-      listAppendData(userLevelFiles, (void*)tl);
-    } else {
-      break;
-    }
-    i++;
-  }
-
-  free(buf);
-
-  listItem* it = &userLevelFiles->begin;
-  while( LISTFWD(userLevelFiles, it) )
-  {
-    tl = (levelInfo_t*)it->data;
-  }
+  userLevelFiles = arrayInit(NULL);
+  levelIndexLoad( getUserLevelDir(), userLevelFiles );
 }
 
 
@@ -314,11 +401,11 @@ int getNumUserLevels()
 void addUserLevel(const char* fn)
 {
   levelInfo_t* tl;
-  listItem* it=&userLevelFiles->begin;
+  int i;
   //Check if it's there
-  while( LISTFWD(userLevelFiles,it) )
+  for(i=0; i < userLevelFiles->count; i++)
   {
-    if(strcmp( ((levelInfo_t*)it->data)->file, fn )==0)
+    if(strcmp( ((levelInfo_t*)ARRAYAT(userLevelFiles,i))->file, fn )==0)
     {
       return;
     }
@@ -329,7 +416,7 @@ void addUserLevel(const char* fn)
 
   if(tl)
   {
-    listAppendData(userLevelFiles, (void*)tl);
+    arrayAppendData(userLevelFiles, (void*)tl);
   } else {
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Strange error, couldn't open saved level.\n");
   }
@@ -339,10 +426,9 @@ char* userLevelFile(int num)
 {
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Asked for userLevelFile: %i\n", num);
 
-  listItem* it = listGetItemAt(userLevelFiles,num);
-  if( it )
+  levelInfo_t* linfo = (levelInfo_t*)arrayGetAt(userLevelFiles,num);
+  if( linfo )
   {
-    levelInfo_t* linfo = (levelInfo_t*)it->data;
     return(linfo->file);
   } else {
     SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Something wrong..\n");
@@ -355,21 +441,10 @@ char* userLevelFile(int num)
 //given a pointer to the pointer, so it can dereference it properly.
 void freeLevelInfo(levelInfo_t** p)
 {
-  //Free all strings that are allocated
+  //Free the strings that are not interned (see internedStr)
   if( (*p)->file ) free( (*p)->file );
   if( (*p)->imgFile ) free( (*p)->imgFile );
-  if( (*p)->author ) free( (*p)->author );
   if( (*p)->levelName ) free( (*p)->levelName );
-  if( (*p)->tileBase ) free( (*p)->tileBase );
-  if( (*p)->explBase ) free( (*p)->explBase );
-  if( (*p)->wallBase ) free( (*p)->wallBase );
-  if( (*p)->bgFile ) free( (*p)->bgFile );
-  if( (*p)->musicFile ) free( (*p)->musicFile );
-  if( (*p)->soundDir ) free( (*p)->soundDir );
-  if( (*p)->fontName ) free( (*p)->fontName );
-  if( (*p)->cursorFile ) free( (*p)->cursorFile );
-  if( (*p)->startImg ) free( (*p)->startImg );
-  if( (*p)->stopImg ) free( (*p)->stopImg );
 
   if( (*p)->teleList ) listFree( (*p)->teleList );
   if( (*p)->switchList) listFree( (*p)->switchList );
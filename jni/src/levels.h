@@ -18,6 +18,9 @@
  * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
  ************************************************************************/
 
+#include <stddef.h>
+#include <stdint.h>
+#include "defs.h"
 #include "list/list.h"
 #include "stats.h"
 
@@ -51,10 +54,14 @@ struct levelInfo_s
 typedef struct levelInfo_s levelInfo_t;
 
 
-list_t* makeLevelList(const char* dir);
+array_t* makeLevelList(const char* dir);
 void makeUserLevelList();
 void addUserLevel(const char* fn);
 levelInfo_t* mkLevelInfo(const char* fileName);
+//Same, also fills cells from the [data] section when cells is not NULL.
+levelInfo_t* mkLevelInfoCells(const char* fileName, uint8_t cells[FIELDSIZE][FIELDSIZE]);
+//A string for the levelInfo_t member at offset field, interned or malloc'd as freeLevelInfo expects.
+char* levelInfoStr(size_t field, const char* str);
 void freeLevelInfo(levelInfo_t** p); //given a pointer to the pointer, so it can dereference it properly.
 char* userLevelFile(int num);
 int getNumUserLevels();
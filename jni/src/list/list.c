@@ -18,6 +18,100 @@
 #include "list.h"
 #include <SDL.h>
 
+struct listPoolSlab_s
+{
+  struct listPoolSlab_s* next;
+  listItem items[LIST_POOL_SLAB];
+};
+typedef struct listPoolSlab_s listPoolSlab;
+
+listPool_t* listPoolInit()
+{
+  return( memset(malloc(sizeof(listPool_t)), 0, sizeof(listPool_t)) );
+}
+
+void listPoolFree(listPool_t* pool)
+{
+  listPoolSlab* slab = (listPoolSlab*)pool->slabs;
+  listPoolSlab* next;
+  if( pool->used )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "listPoolFree Error: Pool %p still has %i nodes in lists.\n", pool, pool->used);
+  }
+  while( slab )
+  {
+    next=slab->next;
+    free(slab);
+    slab=next;
+  }
+  free(pool);
+}
+
+void listPoolDebugShow(listPool_t* pool, const char* name)
+{
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "List pool %s: %i nodes used, high-water %i, capacity %i (%i slabs)\n", name, pool->used, pool->highWater, pool->capacity, pool->capacity/LIST_POOL_SLAB );
+}
+
+//Get a node for list, from its pool if it has one.
+static listItem* listNodeAlloc(list_t* list)
+{
+  listPool_t* pool = list->pool;
+  listPoolSlab* slab;
+  listItem* t;
+  int i;
+
+  if( list->intrusive )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "listNodeAlloc Error: List %p is intrusive, add items with listAppendItem.\n", list);
+  }
+
+  if( !pool )
+  {
+    return( malloc(sizeof(listItem)) );
+  }
+
+  //Out of free nodes, add a slab
+  if( !pool->freeItems )
+  {
+    slab = malloc(sizeof(listPoolSlab));
+    slab->next = (listPoolSlab*)pool->slabs;
+    pool->slabs = slab;
+    for(i=0; i < LIST_POOL_SLAB; i++)
+    {
+      slab->items[i].next = (i+1 < LIST_POOL_SLAB)?&slab->items[i+1]:NULL;
+    }
+    pool->freeItems = &slab->items[0];
+    pool->capacity += LIST_POOL_SLAB;
+  }
+
+  t = pool->freeItems;
+  pool->freeItems = t->next;
+  pool->used++;
+  if( pool->used > pool->highWater )
+  {
+    pool->highWater = pool->used;
+  }
+  return(t);
+}
+
+//Give a node back to where listNodeAlloc got it.
+static void listNodeFree(list_t* list, listItem* item)
+{
+  listPool_t* pool = list->pool;
+  if( list->intrusive )
+  {
+    return;
+  }
+  if( !pool )
+  {
+    free(item);
+    return;
+  }
+  item->next = pool->freeItems;
+  pool->freeItems = item;
+  pool->used--;
+}
+
 void listDebugShow(list_t* list, uint_fast8_t all )
 {
   listItem* it;
@@ -76,7 +170,7 @@ listItem* listPrependData(list_t* list, void* data)
   list->count++;
 
   //Allocate new item structure
-  listItem* t = malloc(sizeof(listItem));
+  listItem* t = listNodeAlloc(list);
 
   //Assign data pointer
   t->data=data;
@@ -103,7 +197,7 @@ listItem* listAppendData(list_t* list, void* data)
   list->count++;
 
   //Allocate new item structure
-  listItem* t=malloc(sizeof(listItem));
+  listItem* t=listNodeAlloc(list);
   
   //Assign data pointer
   t->data=data;
@@ -123,13 +217,24 @@ listItem* listAppendData(list_t* list, void* data)
   return(t);
 }
 
+//Same as listAppendData, but the item is provided by the caller
+listItem* listAppendItem(list_t* list, listItem* item, void* data)
+{
+  list->count++;
+  item->data=data;
+  item->next=&list->end;
+  item->prev=list->end.prev;
+  list->end.prev->next=item;
+  list->end.prev=item;
+  return(item);
+}
+
 //Inserts item at pos p, returns a pointer to item or 0 if p is out of bounds.
 //Worst case it takes n/2 iterations to find position to insert into
 listItem* listInsertAtIdx(list_t* list, void* data, int p)
 {
-  listItem* t = malloc(sizeof(listItem));
+  listItem* t;
   listItem* it;
-  t->data=data;
   int pos;
 
   if(p<0 || p > list->count)
@@ -137,6 +242,8 @@ listItem* listInsertAtIdx(list_t* list, void* data, int p)
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,"listInsertData Error: Position %i unacceptable for list %p with %i items.\n",p,list,list->count);
     return(0);
   }
+  t = listNodeAlloc(list);
+  t->data=data;
 
   if( p <= list->count/2)
   {
@@ -172,7 +279,7 @@ listItem* listInsertAtIdx(list_t* list, void* data, int p)
 listItem* listInsertAfterItem(list_t* list, listItem* item, void* data)
 {
   list->count++;
-  listItem* t = malloc(sizeof(listItem));
+  listItem* t = listNodeAlloc(list);
   t->data = data;
   t->prev = item;
   t->next = item->next;
@@ -207,7 +314,7 @@ listItem* listRemoveItem(list_t* list, listItem* item, uint_fast8_t direction)
       {
         list->freeFunc(it->data);
       }
-      free(it);
+      listNodeFree(list, it);
       return(ret);
     }
   }
@@ -227,6 +334,20 @@ list_t* listInit(listFreeFunc freeFunc)
   return(list);
 }
 
+list_t* listInitPooled(listFreeFunc freeFunc, listPool_t* pool)
+{
+  list_t* list = listInit(freeFunc);
+  list->pool=pool;
+  return(list);
+}
+
+list_t* listInitIntrusive(listFreeFunc freeFunc)
+{
+  list_t* list = listInit(freeFunc);
+  list->intrusive=1;
+  return(list);
+}
+
 
 void listFree(list_t* list)
 {
@@ -236,12 +357,13 @@ void listFree(list_t* list)
 
   while( it != &list->end )
   {
+    //Read next before freeFunc, an intrusive item is gone with its data
+    next=it->next;
     if( list->freeFunc )
     {
 	list->freeFunc(it->data);
     }
-    next=it->next;
-    free(it);
+    listNodeFree(list, it);
     it=next;
   }
   free(list);
@@ -312,3 +434,100 @@ list_t* listAddFromArray(list_t* list, void** data, int count )
   }
   return(list);
 }
+
+
+array_t* arrayInit(listFreeFunc freeFunc)
+{
+  array_t* arr = memset(malloc(sizeof(array_t)), 0, sizeof(array_t));
+  arr->freeFunc=freeFunc;
+  return(arr);
+}
+
+void arrayFree(array_t* arr)
+{
+  int i;
+  if( arr->freeFunc )
+  {
+    for(i=0; i < arr->count; i++)
+    {
+      arr->freeFunc(arr->data[i]);
+    }
+  }
+  free(arr->data);
+  free(arr);
+}
+
+//Make room for one more element, doubling the allocation so appends stay O(1) on average.
+static int arrayGrow(array_t* arr)
+{
+  int size;
+  void** data;
+  if( arr->count < arr->size )
+  {
+    return(1);
+  }
+
+  size = (arr->size)?arr->size*2:16;
+  data = realloc( arr->data, sizeof(void*)*size );
+  if(!data)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "arrayGrow Error: Couldn't grow array %p to %i elements.\n", arr, size);
+    return(0);
+  }
+  arr->data=data;
+  arr->size=size;
+  return(1);
+}
+
+int arrayAppendData(array_t* arr, void* data)
+{
+  if( !arrayGrow(arr) )
+  {
+    return(-1);
+  }
+  arr->data[arr->count]=data;
+  return(arr->count++);
+}
+
+int arrayInsertAtIdx(array_t* arr, void* data, int p)
+{
+  if(p<0 || p > arr->count)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,"arrayInsertAtIdx Error: Position %i unacceptable for array %p with %i elements.\n",p,arr,arr->count);
+    return(-1);
+  }
+  if( !arrayGrow(arr) )
+  {
+    return(-1);
+  }
+  memmove( &arr->data[p+1], &arr->data[p], sizeof(void*)*(arr->count-p) );
+  arr->data[p]=data;
+  arr->count++;
+  return(p);
+}
+
+int arrayRemoveAt(array_t* arr, int index)
+{
+  if(index > arr->count-1 || index < 0 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "arrayRemoveAt Error: Index %i invalid for array %p of size %i\n", index,arr,arr->count );
+    return(0);
+  }
+  if( arr->freeFunc )
+  {
+    arr->freeFunc(arr->data[index]);
+  }
+  arr->count--;
+  memmove( &arr->data[index], &arr->data[index+1], sizeof(void*)*(arr->count-index) );
+  return(1);
+}
+
+void* arrayGetAt(array_t* arr, int index)
+{
+  if(index > arr->count-1 || index < 0 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "\n----\narrayGetAt Error: Requested data for index %i in array %p of size %i\n----\n", index,arr,arr->count );
+    return(NULL);
+  }
+  return(arr->data[index]);
+}
@@ -37,12 +37,31 @@ typedef struct listItemStruct listItem;
 
 typedef void (*listFreeFunc)(void*);
 
+//Nodes per slab in a node pool
+#ifndef LIST_POOL_SLAB
+  #define LIST_POOL_SLAB 64
+#endif
+
+//Pool of list nodes, allocated a slab at a time and recycled through a free list,
+//so lists that churn don't hit malloc/free per item. Can be shared by any number of lists,
+//but isn't thread safe, so only by lists used from the same thread.
+typedef struct
+{
+  listItem* freeItems; //Free list, linked through next
+  void* slabs; //All slabs, freed by listPoolFree
+  int used; //Nodes currently in lists
+  int highWater; //Most nodes that were in lists at once
+  int capacity; //Nodes allocated in slabs
+} listPool_t;
+
 typedef struct
 {
     struct listItemStruct begin;
     struct listItemStruct end;
     int count;
     listFreeFunc freeFunc;
+    listPool_t* pool; //Nodes come from here, or from malloc if NULL
+    uint_fast8_t intrusive; //Nodes are embedded in the data, the list never allocates or frees them
 } list_t;
 
 
@@ -70,6 +89,23 @@ listItem* listRemoveItem(list_t* list, listItem* item, uint_fast8_t direction);
 //Initialize a new empty list
 list_t* listInit(listFreeFunc freeFunc);
 
+//Initialize a new empty list which takes its nodes from pool
+list_t* listInitPooled(listFreeFunc freeFunc, listPool_t* pool);
+
+//Initialize a new empty intrusive list, items are added with listAppendItem and
+//the listItem is owned by the caller (usually embedded in the data it points to).
+list_t* listInitIntrusive(listFreeFunc freeFunc);
+
+//Add a caller owned item with data to end of an intrusive list, returns item
+listItem* listAppendItem(list_t* list, listItem* item, void* data);
+
+//Create and free a node pool. Lists using the pool must be freed first.
+listPool_t* listPoolInit();
+void listPoolFree(listPool_t* pool);
+
+//Show pool counters (for tuning)
+void listPoolDebugShow(listPool_t* pool, const char* name);
+
 //Frees memory used by list - If the freeFunc pointer is not null, this is called with the pointer for each data element.
 void listFree(list_t* list );
 
@@ -82,6 +118,38 @@ void** listAddToArray(void** array, list_t* list);
 //Add data from array to list
 list_t* listAddFromArray(list_t* list, void** data, int count );
 
+//Growable array of data pointers, for lists that are mostly appended to and read by index.
+//Indexing and appending are O(1), iterate with a plain for loop from 0 to count-1.
+typedef struct
+{
+  void** data;
+  int count;
+  int size; //Number of allocated slots
+  listFreeFunc freeFunc;
+} array_t;
+
+//Initialize a new empty array
+array_t* arrayInit(listFreeFunc freeFunc);
+
+//Frees memory used by array - If the freeFunc pointer is not null, this is called with the pointer for each data element.
+void arrayFree(array_t* arr);
+
+//Add data to end of array, returns the index or -1 if out of memory
+int arrayAppendData(array_t* arr, void* data);
+
+//Add data at index p, moving later elements one up, returns p or -1 if p is out of bounds.
+int arrayInsertAtIdx(array_t* arr, void* data, int p);
+
+//Removes element at index, moving later elements one down. If freeFunc is not null it's called with the data.
+//Returns 0 if index is invalid.
+int arrayRemoveAt(array_t* arr, int index);
+
+//Returns data at index or NULL if index is invalid.
+void* arrayGetAt(array_t* arr, int index);
+
+//Unchecked access, for loops that already know the index is valid.
+#define ARRAYAT(ARR, IDX) ((ARR)->data[(IDX)])
+
 #define LIST_DEBUG_SHOW_FORWARD 1
 #define LIST_DEBUG_SHOW_BACKWARD 2
 #define LIST_DEBUG_SHOW_SHORT 0
@@ -136,6 +136,77 @@ int main()
   listFree(list);
   listFree(list2);
 
+
+  printf("\nTest: New array, appending 40 items (grows past the first allocation).\n");
+  array_t* array = arrayInit(freeItem);
+  char name[16];
+  for(i=0; i < 40; i++)
+  {
+    sprintf(name, "Elem %i", i);
+    arrayAppendData(array, mkItem(i, name) );
+  }
+  printf("  count = %i, size = %i\n", array->count, array->size);
+
+  printf("\nTest: Inserting at 0, 20 and the end.\n");
+  arrayInsertAtIdx(array, mkItem(100, "New Pos 0"), 0 );
+  arrayInsertAtIdx(array, mkItem(120, "New Pos 20"), 20 );
+  arrayInsertAtIdx(array, mkItem(array->count, "New Last Pos"), array->count );
+
+  printf("\nTest: Removing index 1 and the last element.\n");
+  arrayRemoveAt(array, 1);
+  arrayRemoveAt(array, array->count-1);
+
+  printf("\nTest: Getting data, out of bounds should print an error.\n");
+  for(i=0; i < array->count; i++)
+  {
+    showItem( (item*)arrayGetAt(array, i) );
+  }
+  printf("  Idx %i Got data: %p\n", array->count, arrayGetAt(array, array->count) );
+
+  printf("\nTest: Freeing array.\n");
+  arrayFree(array);
+
+
+  printf("\nTest: Two lists sharing a node pool, 100 appends, remove every other, 100 more appends.\n");
+  listPool_t* pool = listPoolInit();
+  list_t* pl1 = listInitPooled(NULL, pool);
+  list_t* pl2 = listInitPooled(NULL, pool);
+  for(i=0; i < 100; i++)
+  {
+    listAppendData( (i%2)?pl1:pl2, (void*)(intptr_t)i );
+  }
+  it=&pl1->begin;
+  while( LISTFWD(pl1,it) )
+  {
+    it=listRemoveItem(pl1, it, LIST_PREV);
+    //Skip one
+    if( !(LISTFWD(pl1,it)) ) break;
+  }
+  listPoolDebugShow(pool, "test");
+  for(i=0; i < 100; i++)
+  {
+    listPrependData( pl1, (void*)(intptr_t)i );
+  }
+  listDebugShow(pl1,LIST_DEBUG_SHOW_SHORT);
+  listPoolDebugShow(pool, "test");
+  listFree(pl1);
+  listFree(pl2);
+  listPoolDebugShow(pool, "test (should have 0 used)");
+  listPoolFree(pool);
+
+  printf("\nTest: Intrusive list, items embed their node.\n");
+  typedef struct { item i; listItem link; } linkedItem;
+  list_t* il = listInitIntrusive(free);
+  for(i=0; i < 4; i++)
+  {
+    linkedItem* li = malloc(sizeof(linkedItem));
+    li->i.num=i;
+    li->i.name="Linked";
+    listAppendItem(il, &li->link, (void*)li);
+  }
+  showItems(il);
+  listFree(il);
+
   printf("\nTests done, it's up to you to figure out if they passed, <nelson>hahaaa!</nelson>\n");
 
   return(0);
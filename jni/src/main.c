@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include <SDL.h>
@@ -38,15 +39,29 @@
 #include "settings.h"
 #include "pack.h"
 #include "stats.h"
+#include "statsupload.h"
+#include "capture.h"
+#include "preview.h"
+#include "bench.h"
+#include "archive.h"
 #include "credits.h"
 #include "userfiles.h"
 #include "strings.h"
 #include "swscale.h"
 #include "pointer.h"
 #include "transition.h"
+#include "ticks.h"
+#include "profiler.h"
+#include "memtrack.h"
+#include "startup.h"
 #include "platform/libDLC.h"
 
 
+//Created by the video startup job
+static SDL_Window* sdlWindow=NULL;
+static SDL_Renderer* sdlRenderer=NULL;
+static SDL_Texture* sdlTexture=NULL;
+
 SDL_Surface* swScreen()
 {
   SDL_Surface *screen = SDL_CreateRGBSurface(0, 1024, 600, 32,
@@ -65,16 +80,96 @@ SDL_Surface* swScreen()
   return (screen);
 }
 
+//Startup jobs, data is the screen surface.
+//Streams a frame to the window, the texture follows the size of the frame
+static void presentSurface(SDL_Surface* s)
+{
+  int w=0, h=0;
+
+  SDL_QueryTexture(sdlTexture, NULL, NULL, &w, &h);
+  if( w != s->w || h != s->h )
+  {
+    SDL_DestroyTexture(sdlTexture);
+    sdlTexture = SDL_CreateTexture(sdlRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, s->w, s->h);
+  }
+
+  SDL_UpdateTexture(sdlTexture, NULL, s->pixels, s->pitch);
+  SDL_RenderClear(sdlRenderer);
+  SDL_RenderCopy(sdlRenderer, sdlTexture, NULL, NULL);
+  SDL_RenderPresent(sdlRenderer);
+}
+
+static int initVideo(void* data)
+{
+  sdlWindow = SDL_CreateWindow("Wizznic Android",
+							SDL_WINDOWPOS_UNDEFINED,
+							SDL_WINDOWPOS_UNDEFINED,
+                            0, 0,
+                            SDL_WINDOW_FULLSCREEN_DESKTOP);
+  if( !sdlWindow )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_CreateWindow failed: %s\n", SDL_GetError());
+    return(0);
+  }
+
+  sdlRenderer = SDL_CreateRenderer(sdlWindow, -1, (setting()->vsync)?SDL_RENDERER_PRESENTVSYNC:0);
+
+  sdlTexture = SDL_CreateTexture(sdlRenderer,
+                                            SDL_PIXELFORMAT_ARGB8888,
+                                            SDL_TEXTUREACCESS_STREAMING,
+                                            320, 240);
+
+  SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");  // make the scaled rendering look smoother.
+  SDL_RenderSetLogicalSize(sdlRenderer, 320, 240);
+
+  setting()->bpp = SDL_GetWindowPixelFormat(sdlWindow);
+  setAlphaCol( setting()->bpp );
+  return(1);
+}
+
+static int initFonts(void* data) { txtInit(); return(1); }
+static int initMenuGfx(void* data) { return( initMenu((SDL_Surface*)data) ); }
+static int initInput(void* data) { initControls(); return(1); }
+static int initStats(void* data) { statsInit(); return(1); }
+static int initPacks(void* data) { packInit(); return(1); }
+static int initAudio(void* data) { return( initSound() ); }
+static int initMenuSounds(void* data) { loadMenuSamples(); return(1); }
+static int initUserLevels(void* data) { makeUserLevelList(); return(1); }
+static int initParticleSys(void* data) { initParticles((SDL_Surface*)data); return(1); }
+static int initStarField(void* data) { initStars((SDL_Surface*)data); return(1); }
+static int initPtr(void* data) { initPointer((SDL_Surface*)data); return(1); }
+static int initCreditList(void* data) { initCredits((SDL_Surface*)data); return(1); }
+static int initTransitions(void* data) { initTransition((SDL_Surface*)data); return(1); }
+
 int main(int argc, char *argv[]) {
   int doScale = 0; // 0=Undefined, 1=320x240, -1=OpenGL, >1=SwScale
   char* dumpPack = NULL;
   int state = 1; //Game, Menu, Editor, Quit
   int sdlVideoModeFlags = SDL_SWSURFACE;
   int i;
+  int jobFonts, jobPacks, jobAudio;
 
   //initialize path strings
   initUserPaths();
 
+  //Level previews for pack makers, nothing else is set up for this.
+  if( argc > 1 && strcmp(argv[1], "-previews")==0 )
+  {
+    return( previewMain(argc-2, argv+2) );
+  }
+
+  //Pack archives for pack makers.
+  if( argc > 1 && strcmp(argv[1], "-archive")==0 )
+  {
+    return( archiveMain(argc-2, argv+2) );
+  }
+
+  //Performance regression runs, headless like the previews.
+  if( argc > 1 && strcmp(argv[1], "-bench")==0 )
+  {
+    return( benchMain(argc-2, argv+2) );
+  }
+
   //Read settings
   initSettings();
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initSettings() completed");
@@ -98,23 +193,7 @@ int main(int argc, char *argv[]) {
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "SDL_Init is ok");
 
   SDL_Surface* screen = NULL;
-  
-  SDL_Window *sdlWindow = SDL_CreateWindow("Wizznic Android",
-							SDL_WINDOWPOS_UNDEFINED,
-							SDL_WINDOWPOS_UNDEFINED,
-                            0, 0,
-                            SDL_WINDOW_FULLSCREEN_DESKTOP);
-  
-  SDL_Renderer *sdlRenderer = SDL_CreateRenderer(sdlWindow, -1, 0);
-  
-  SDL_Texture *sdlTexture = SDL_CreateTexture(sdlRenderer,
-                                            SDL_PIXELFORMAT_ARGB8888,
-                                            SDL_TEXTUREACCESS_STREAMING,
-                                            320, 240);
-  
-  SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");  // make the scaled rendering look smoother.
-  SDL_RenderSetLogicalSize(sdlRenderer, 320, 240);
-  
+
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "Parameters passed ok.");
 
   if(doScale)
@@ -160,62 +239,35 @@ int main(int argc, char *argv[]) {
     return(-1);
   }
  
-  setting()->bpp = SDL_GetWindowPixelFormat(sdlWindow);
-  setAlphaCol( setting()->bpp );
-  
-  //Load fonts
-  txtInit();
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "Fonts init ok.");
+  //Decoders are set up once here, the startup jobs use them from several threads.
+  IMG_Init( IMG_INIT_PNG );
 
-  //Menu Graphics
-  if(!initMenu(screen))
-  {
-	SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "Couldn't load menu graphics");
-    return(-1);
-  }
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initMenu() ok.");
+  //Seed the pseudo random number generator (for particles 'n' stuff)
+  srand( (int)time(NULL) );
 
-  //Init controls
-  initControls();
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initControls() ok.");
-	
-  //Init stats
-  statsInit();
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "statsInit() ok.");
-  
-  //Init packs
-  packInit();
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "packInit() ok.");
- 
-  //Load sounds
-  if(!initSound())
+  //The window is created on the main thread while the workers load and decode assets.
+  startupAdd( "video", initVideo, screen, STARTUP_MAIN_THREAD, 0 );
+  jobFonts = startupAdd( "fonts", initFonts, screen, STARTUP_ANY_THREAD, 0 );
+  jobPacks = startupAdd( "packs", initPacks, screen, STARTUP_ANY_THREAD, 0 );
+  jobAudio = startupAdd( "audio", initAudio, screen, STARTUP_MAIN_THREAD, 0 );
+  startupAdd( "menu", initMenuGfx, screen, STARTUP_ANY_THREAD, STARTUP_DEP(jobFonts) );
+  startupAdd( "credits", initCreditList, screen, STARTUP_ANY_THREAD, STARTUP_DEP(jobFonts) );
+  //Menu samples come from the first pack, see packGetFile
+  startupAdd( "menusounds", initMenuSounds, screen, STARTUP_ANY_THREAD, STARTUP_DEP(jobAudio)|STARTUP_DEP(jobPacks) );
+  startupAdd( "userlevels", initUserLevels, screen, STARTUP_ANY_THREAD, 0 );
+  startupAdd( "pointer", initPtr, screen, STARTUP_ANY_THREAD, 0 );
+  startupAdd( "transition", initTransitions, screen, STARTUP_ANY_THREAD, 0 );
+  startupAdd( "stars", initStarField, screen, STARTUP_ANY_THREAD, 0 );
+  startupAdd( "particles", initParticleSys, screen, STARTUP_ANY_THREAD, 0 );
+  startupAdd( "controls", initInput, screen, STARTUP_ANY_THREAD, 0 );
+  startupAdd( "stats", initStats, screen, STARTUP_ANY_THREAD, 0 );
+
+  if( !startupRun() )
   {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "Could not init sound.");
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,  "Startup failed. Time to exit ...");
     return(-1);
   }
-  
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initSound() ok.");
-
-  //Scan userlevels dir
-  makeUserLevelList(screen);
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "makeUserLevelList() ok.");
-	
-  //Init particles
-  initParticles(screen);
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initParticles() ok.");
-
-  //Seed the pseudo random number generator (for particles 'n' stuff)
-  srand( (int)time(NULL) );
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "srand( (int)time(NULL) );() ok.");
-
-  //init starfield
-  initStars(screen);
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initStars() ok.");
 
-  //Init pointer
-  initPointer(screen);
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initPointer() ok.");
-  
   //Apply settings (has to be done after packs are inited)
   applySettings();
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "applySettings() ok.");
@@ -225,6 +277,7 @@ int main(int argc, char *argv[]) {
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "packSetByPath() ok.");
 
   #if defined( PLATFORM_SUPPORTS_STATSUPLOAD )
+  statsUpInit();
   if( (setting()->uploadStats) && !(setting()->firstRun) )
   {
     statsUpload(0,0,0,0,0,"check",1, &(setting()->session) );
@@ -238,13 +291,6 @@ int main(int argc, char *argv[]) {
   //Start playing music (has to be done after readong settings)
   soundSetMusic();
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "soundSetMusic() ok.");
-
-  //Initialize credits
-  initCredits(screen);
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initCredits(screen) ok."); 
-  
-  initTransition();
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "initTransition() ok."); 
 	
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "Screen size is %dx%d", SCREENW, SCREENH); 	
 	
@@ -269,15 +315,33 @@ int main(int argc, char *argv[]) {
 
 #endif
 
-  int lastTick;
+  //Only let vsync pace us if the renderer actually got it
+  SDL_RendererInfo renInfo;
+  SDL_DisplayMode dispMode;
+  int refreshRate=0;
+  if( doScale==0 && SDL_GetRendererInfo(sdlRenderer, &renInfo)==0 && (renInfo.flags & SDL_RENDERER_PRESENTVSYNC) )
+  {
+    if( SDL_GetCurrentDisplayMode( SDL_GetWindowDisplayIndex(sdlWindow), &dispMode)==0 && dispMode.refresh_rate > 0 )
+    {
+      refreshRate=dispMode.refresh_rate;
+    } else {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Vsync is on but the refresh rate is unknown, assuming 60 Hz.");
+      refreshRate=60;
+    }
+  }
+  frameSchedInit(setting()->frameRate, refreshRate, setting()->lateInput);
+  profInit(setting()->profiler);
+
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "start main loop ... :D"); 
   while(state!=STATEQUIT)
   {
-    lastTick=SDL_GetTicks();
-
     frameStart();
+    profFrameBegin();
 
+    profBegin(PROF_INPUT);
     if(runControls()) state=STATEQUIT;
+    profEnd(PROF_INPUT);
+    profInput(getInputStamp());
     switch(state)
     {
       case STATEPLAY:
@@ -295,13 +359,24 @@ int main(int argc, char *argv[]) {
 
     drawPointer(screen);
 
+    profBegin(PROF_AUDIO);
     soundRun(screen,state);
+    profEnd(PROF_AUDIO);
 
+    profBegin(PROF_TRANSITION);
     runTransition(screen);
+    profEnd(PROF_TRANSITION);
+
+    //Before the overlays, so they are not in the capture
+    captureFrame(screen);
 
     if(setting()->showFps)
       drawFPS(screen);
 
+    profDraw(screen);
+
+    frameSchedPresent();
+    profBegin(PROF_PRESENT);
     switch( doScale )
     {
       #if defined(HAVE_ACCELERATION)
@@ -310,14 +385,11 @@ int main(int argc, char *argv[]) {
         break;
       #endif
       case 0:
-		  SDL_UpdateTexture(sdlTexture, NULL, screen->pixels, screen->pitch);
-		  SDL_RenderClear(sdlRenderer);
-		  SDL_RenderCopy(sdlRenderer, sdlTexture, NULL, NULL);
-		  SDL_RenderPresent(sdlRenderer);
+        presentSurface(screen);
         break;
       #if defined(WANT_SWSCALE)
       default:
-        swScale(screen,doScale);
+        presentSurface( swScale(screen,doScale) );
         break;
       #else
       default:
@@ -326,25 +398,36 @@ int main(int argc, char *argv[]) {
       #endif
     }
 
-    #if defined(CRUDE_TIMING)
-    //Oh how I loathe this, is there no better way?
-    while(SDL_GetTicks()-lastTick <= PLATFORM_CRUDE_TIMING_TICKS)
-    {
-      //Burn, burn baby burn!
-    }
-    #else
-    int t=SDL_GetTicks()-lastTick;
-    if(t < 20)
-    {
-      SDL_Delay( 20 -t);
-    }
+    profEnd(PROF_PRESENT);
+    profFrameEnd();
+    #if defined(WANT_MEMTRACK)
+    memFrameEnd();
     #endif
+
+    frameSchedWait();
+  }
+
+  captureQuit();
+  statsFlush();
+  #if defined( PLATFORM_SUPPORTS_STATSUPLOAD )
+  statsUpQuit();
+  #endif
+
+  if( profEnabled() )
+  {
+    char traceFile[512];
+    snprintf(traceFile, sizeof(traceFile), "%s/trace.json", getConfigDir());
+    profTraceWrite(traceFile);
   }
  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "after main loop ... time to leave wizznic :D"); 
   #if defined(PLATFORM_NEEDS_EXIT)
   platformExit();
   #endif
   releaseMusic();
+  #if defined(WANT_MEMTRACK)
+  memReport("shutdown", 0);
+  memReportSites();
+  #endif
   SDL_Quit();
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "SDL_Quit after"); 
   return(0);
@@ -20,6 +20,8 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <SDL.h>
 #include "mbrowse.h"
 
 #ifdef WIN32
@@ -30,50 +32,75 @@
   #define cwd getcwd
 #endif
 
-static list_t* fl=0;
+//A scanned directory
+typedef struct {
+  char* path;
+  time_t mtime;
+  array_t* items; //fileListItem_t, ".." first
+  array_t* songs; //The songs in items, in the same order
+  Uint32 lastUse;
+} fileDir_t;
 
-static void fileListFreeItem(fileListItem_t* i)
+static fileDir_t* cache[MBROWSE_CACHE_DIRS];
+static fileDir_t* cur=NULL; //The list in use, it's in the cache
+static char* wantPath=NULL; //Last path given to fileListMake
+static array_t emptyList; //What fileList() returns while scanning
+
+//The scan in progress, the worker only touches scanResult and scanDone.
+static SDL_Thread* scanThread=NULL;
+static SDL_atomic_t scanDone;
+static char* scanPath=NULL;
+static time_t scanKnownMtime=0;
+static int scanKnown=0; //If the directory is cached, with scanKnownMtime
+static fileDir_t* scanResult=NULL; //NULL if the directory didn't change
+
+static void fileListFreeItem(void* data)
 {
+  fileListItem_t* i = (fileListItem_t*)data;
   free(i->name);
   free(i->fullName);
   free(i);
 }
 
-void fileListFree()
+static void fileDirFree(fileDir_t* d)
 {
-  listItem* it=&fl->begin;
-  if(it)
-  {
-    while( LISTFWD(fl,it) )
-    {
-      fileListFreeItem( (fileListItem_t*)(it->data) );
-    }
-    listFree(fl);
-    fl=0;
-  }
+  arrayFree(d->songs);
+  arrayFree(d->items);
+  free(d->path);
+  free(d);
 }
 
-void fileListMake(const char* path)
+static char* fileListStrDup(const char* str)
 {
+  char* s = malloc( sizeof(char)*(strlen(str)+1) );
+  strcpy(s, str);
+  return(s);
+}
 
+static fileDir_t* fileListScan(const char* path, time_t mtime)
+{
   DIR *pdir=0;
   struct dirent *pent;
   struct stat st;
   char* buf=malloc(sizeof(char)*512);
   fileListItem_t* fi;
+  fileDir_t* d;
+  int isDir;
 
-  if(fl) fileListFree();
-  fl=listInit(NULL);
+  d = malloc(sizeof(fileDir_t));
+  d->path = fileListStrDup(path);
+  d->mtime = mtime;
+  d->items = arrayInit(fileListFreeItem);
+  d->songs = arrayInit(NULL);
+  d->lastUse = 0;
 
   //Add ".."
   fi=malloc(sizeof(fileListItem_t));
-  fi->name=malloc(sizeof(char)*(strlen("[..]")+1));
-  strcpy(fi->name, "[..]");
-
+  fi->name=fileListStrDup("[..]");
   fi->fullName=(char*)0;
   fi->dir=1;
 
-  listAppendData(fl,(void*)fi);
+  arrayAppendData(d->items,(void*)fi);
 
 
 
@@ -90,33 +117,47 @@ void fileListMake(const char* path)
       {
         sprintf(buf, "%s/%s", path, pent->d_name);
 
-        if(stat(buf, &st)==0)
+        //The entry type usually comes with the name, only stat if it didn't.
+        isDir=-1;
+        #ifdef _DIRENT_HAVE_D_TYPE
+        if( pent->d_type == DT_DIR )
+          isDir=1;
+        else if( pent->d_type == DT_REG )
+          isDir=0;
+        #endif
+        if( isDir == -1 && stat(buf, &st)==0 )
+        {
+          isDir = ((st.st_mode&S_IFDIR)==S_IFDIR );
+        }
+
+        if( isDir != -1 )
         {
           fi=malloc(sizeof(fileListItem_t));
-          fi->fullName=malloc(sizeof(char)*(strlen(buf)+1));
-          strcpy(fi->fullName, buf);
+          fi->fullName=fileListStrDup(buf);
 
-          if((st.st_mode&S_IFDIR)==S_IFDIR )
+          if( isDir )
           {
             fi->dir=1;
             sprintf(buf, "[%s]", pent->d_name);
           } else {
             //Only add ogg or mp3's
             fi->dir=-1;
-            if( strcmp( ".mp3", pent->d_name+(strlen(pent->d_name)-4))==0 ||
-                strcmp( ".ogg", pent->d_name+(strlen(pent->d_name)-4))==0)
+            if( strlen(pent->d_name) > 4 &&
+                ( strcmp( ".mp3", pent->d_name+(strlen(pent->d_name)-4))==0 ||
+                  strcmp( ".ogg", pent->d_name+(strlen(pent->d_name)-4))==0) )
                 {
                   fi->dir=0;
                 }
             strcpy(buf, pent->d_name);
           }
 
-          fi->name=malloc(sizeof(char)*(strlen(buf)+1));
-          strcpy(fi->name, buf);
+          fi->name=fileListStrDup(buf);
 
           if(fi->dir!=-1)
           {
-            listAppendData(fl, (void*)fi);
+            arrayAppendData(d->items, (void*)fi);
+            if(!fi->dir)
+              arrayAppendData(d->songs, (void*)fi);
           } else {
             fileListFreeItem(fi);
           }
@@ -124,13 +165,176 @@ void fileListMake(const char* path)
         }
       }
     }
+    closedir(pdir);
   }
 
-  closedir(pdir);
   free(buf);
+  return(d);
+}
+
+static int fileListScanThread(void* data)
+{
+  struct stat st;
+  time_t mtime = (stat(scanPath, &st)==0) ? st.st_mtime : 0;
+
+  //Nothing was added or removed since we saw it last.
+  if( scanKnown && mtime == scanKnownMtime )
+  {
+    scanResult=NULL;
+  } else {
+    scanResult=fileListScan(scanPath, mtime);
+  }
+
+  SDL_AtomicSet(&scanDone, 1);
+  return(0);
+}
+
+static fileDir_t* fileListCached(const char* path)
+{
+  int i;
+  for(i=0; i < MBROWSE_CACHE_DIRS; i++)
+  {
+    if( cache[i] && strcmp(cache[i]->path, path)==0 )
+      return(cache[i]);
+  }
+  return(NULL);
+}
+
+//Put d in the cache, replacing the old scan of its directory or the least recently used one.
+static void fileListCacheAdd(fileDir_t* d)
+{
+  int i, slot=-1;
+
+  for(i=0; i < MBROWSE_CACHE_DIRS && slot==-1; i++)
+  {
+    if( cache[i] && strcmp(cache[i]->path, d->path)==0 )
+      slot=i;
+  }
+
+  for(i=0; i < MBROWSE_CACHE_DIRS && slot==-1; i++)
+  {
+    if( !cache[i] )
+      slot=i;
+  }
+
+  //The one in use is never evicted, there's always another.
+  if( slot==-1 )
+  {
+    for(i=0; i < MBROWSE_CACHE_DIRS; i++)
+    {
+      if( cache[i] != cur && (slot==-1 || cache[i]->lastUse < cache[slot]->lastUse) )
+        slot=i;
+    }
+  }
+
+  if( cache[slot] )
+  {
+    if( cache[slot] == cur )
+      cur=d;
+    fileDirFree(cache[slot]);
+  }
+  d->lastUse=SDL_GetTicks();
+  cache[slot]=d;
+}
+
+static void fileListStartScan()
+{
+  fileDir_t* d = fileListCached(wantPath);
+
+  free(scanPath);
+  scanPath = fileListStrDup(wantPath);
+  scanKnown = (d!=NULL);
+  scanKnownMtime = (d) ? d->mtime : 0;
+  scanResult=NULL;
+  SDL_AtomicSet(&scanDone, 0);
+
+  scanThread = SDL_CreateThread(fileListScanThread, "fileListScan", NULL);
+  if( !scanThread )
+  {
+    //Do it here then.
+    fileListScanThread(NULL);
+  }
+}
+
+//Take the result of a finished scan, and start the next if the wanted path changed meanwhile.
+static void fileListPoll()
+{
+  if( !SDL_AtomicGet(&scanDone) )
+  {
+    return;
+  }
+
+  if( scanThread )
+  {
+    SDL_WaitThread(scanThread, NULL);
+    scanThread=NULL;
+  }
+  SDL_AtomicSet(&scanDone, 0);
+
+  if( scanResult )
+  {
+    fileListCacheAdd(scanResult);
+    scanResult=NULL;
+  }
+
+  if( wantPath )
+  {
+    if( strcmp(scanPath, wantPath)==0 && (cur=fileListCached(wantPath)) )
+    {
+      cur->lastUse=SDL_GetTicks();
+    } else {
+      fileListStartScan();
+    }
+  }
+}
+
+void fileListFree()
+{
+  free(wantPath);
+  wantPath=NULL;
+  cur=NULL;
+}
+
+void fileListMake(const char* path)
+{
+  free(wantPath);
+  wantPath=fileListStrDup(path);
+
+  //Show what we know right away, the scan checks if it's still right.
+  cur=fileListCached(path);
+  if(cur)
+  {
+    cur->lastUse=SDL_GetTicks();
+  }
+
+  fileListPoll();
+  if( !scanThread && !SDL_AtomicGet(&scanDone) )
+  {
+    fileListStartScan();
+    fileListPoll();
+  }
+}
+
+int fileListReady()
+{
+  fileListPoll();
+  return( cur!=NULL );
+}
+
+array_t* fileList()
+{
+  fileListPoll();
+  return( (cur)?cur->items:&emptyList );
+}
+
+int fileListNumSongs()
+{
+  return( (cur)?cur->songs->count:0 );
 }
 
-list_t* fileList()
+fileListItem_t* fileListSong(int num)
 {
-  return(fl);
+  if( !cur || num < 0 || num >= cur->songs->count )
+    return(NULL);
+  return( (fileListItem_t*)ARRAYAT(cur->songs, num) );
 }
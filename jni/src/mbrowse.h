@@ -20,6 +20,11 @@
 
 #include "list/list.h"
 
+//Directories scanned and kept for later visits, a visit only rescans if the mtime changed
+#ifndef MBROWSE_CACHE_DIRS
+  #define MBROWSE_CACHE_DIRS 8
+#endif
+
 struct fileListItem_s
 {
   char* fullName; //Full path
@@ -29,8 +34,11 @@ struct fileListItem_s
 
 typedef struct fileListItem_s fileListItem_t;
 
-void fileListFree();
-void fileListMake(const char* path);
-list_t* fileList();
+void fileListFree(); //Stop using the current list, scanned directories stay cached
+void fileListMake(const char* path); //Scan path on a worker thread, the cached list is used meanwhile if there is one
+int fileListReady(); //1 when there is a list for the last path given to fileListMake
+array_t* fileList(); //Directories and songs of the current list, empty while scanning
+int fileListNumSongs();
+fileListItem_t* fileListSong(int num); //NULL if there is no such song
 
 #endif // MBROWSE_H_INCLUDED
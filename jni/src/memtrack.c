@@ -0,0 +1,365 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include "memtrack.h"
+
+#if defined(WANT_MEMTRACK)
+
+//The tracker itself uses the real allocator, the header is force-included before this
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+#include <stdint.h>
+
+typedef struct {
+  const char* file;
+  int line;
+  Uint32 allocs; //Since start
+  Uint32 bytes;
+  Uint32 live;
+  Uint32 liveBytes;
+} memSite_t;
+
+typedef struct {
+  void* p;
+  Uint32 size;
+  Uint32 seq; //Allocation number, for the reports since a mark
+  Uint16 site;
+} memSlot_t;
+
+//The last site collects the call sites that did not fit
+static memSite_t sites[MEMTRACK_SITES+1];
+static memSlot_t slots[MEMTRACK_SLOTS];
+static SDL_SpinLock lock=0;
+static memStats_t st;
+static Uint32 seq=0;
+static Uint32 curAllocs=0, curBytes=0; //In the running frame
+
+//Scratch for the reports, filled under the lock
+static Uint32 repCount[MEMTRACK_SITES+1];
+static Uint32 repBytes[MEMTRACK_SITES+1];
+
+static Uint32 slotHash(void* p)
+{
+  return( (Uint32)(((uintptr_t)p>>4)*2654435761u) & (MEMTRACK_SLOTS-1) );
+}
+
+static int siteGet(const char* file, int line)
+{
+  Uint32 i = (Uint32)(((uintptr_t)file>>2)*31u+(Uint32)line)*2654435761u;
+  int n;
+
+  for(n=0; n < MEMTRACK_SITES; n++)
+  {
+    i &= MEMTRACK_SITES-1;
+    if( !sites[i].file )
+    {
+      sites[i].file=file;
+      sites[i].line=line;
+      return(i);
+    }
+    if( sites[i].file==file && sites[i].line==line )
+      return(i);
+    i++;
+  }
+
+  sites[MEMTRACK_SITES].file="(other)";
+  return(MEMTRACK_SITES);
+}
+
+//Backward shift, so lookups never need tombstones
+static void slotRemove(Uint32 i)
+{
+  memSite_t* s = &sites[slots[i].site];
+  Uint32 j=i, k;
+
+  s->live--;
+  s->liveBytes -= slots[i].size;
+  st.live--;
+  st.liveBytes -= slots[i].size;
+
+  for(;;)
+  {
+    j=(j+1)&(MEMTRACK_SLOTS-1);
+    if( !slots[j].p )
+      break;
+    k=slotHash(slots[j].p);
+    if( (i<=j) ? (i<k && k<=j) : (i<k || k<=j) )
+      continue;
+    slots[i]=slots[j];
+    i=j;
+  }
+  slots[i].p=NULL;
+}
+
+static int slotFind(void* p)
+{
+  Uint32 i=slotHash(p);
+
+  while( slots[i].p )
+  {
+    if( slots[i].p==p )
+      return(i);
+    i=(i+1)&(MEMTRACK_SLOTS-1);
+  }
+  return(-1);
+}
+
+static void track(void* p, size_t size, const char* file, int line)
+{
+  memSite_t* s = &sites[siteGet(file,line)];
+  Uint32 i;
+  int old;
+
+  s->allocs++;
+  s->bytes += (Uint32)size;
+  st.allocs++;
+  st.bytes += (Uint32)size;
+  curAllocs++;
+  curBytes += (Uint32)size;
+
+  //Freed by something that was not tracked, the address is reused
+  if( (old=slotFind(p)) != -1 )
+    slotRemove(old);
+
+  if( st.live >= MEMTRACK_SLOTS-1 )
+  {
+    st.untracked++;
+    return;
+  }
+
+  i=slotHash(p);
+  while( slots[i].p )
+    i=(i+1)&(MEMTRACK_SLOTS-1);
+
+  slots[i].p=p;
+  slots[i].size=(Uint32)size;
+  slots[i].seq=seq++;
+  slots[i].site=(Uint16)(s-sites);
+
+  s->live++;
+  s->liveBytes += (Uint32)size;
+  st.live++;
+  st.liveBytes += (Uint32)size;
+  if( st.liveBytes > st.peakBytes )
+    st.peakBytes = st.liveBytes;
+}
+
+//i is from slotFind(), looked up before the memory was given back
+static void untrack(int i)
+{
+  st.frees++;
+  if( i == -1 )
+    st.foreign++;
+  else
+    slotRemove(i);
+}
+
+void* memMalloc(size_t size, const char* file, int line)
+{
+  void* p;
+
+  SDL_AtomicLock(&lock);
+  if( (p=malloc(size)) )
+    track(p, size, file, line);
+  SDL_AtomicUnlock(&lock);
+  return(p);
+}
+
+void* memCalloc(size_t num, size_t size, const char* file, int line)
+{
+  void* p;
+
+  SDL_AtomicLock(&lock);
+  if( (p=calloc(num, size)) )
+    track(p, num*size, file, line);
+  SDL_AtomicUnlock(&lock);
+  return(p);
+}
+
+//Under the lock, so no other thread is handed the old address before it is untracked
+void* memRealloc(void* p, size_t size, const char* file, int line)
+{
+  void* n;
+  int i=-1, had=(p!=NULL);
+
+  SDL_AtomicLock(&lock);
+  if( had )
+    i=slotFind(p);
+  n=realloc(p, size);
+  if( had && (n || !size) )
+    untrack(i);
+  if( n )
+    track(n, size, file, line);
+  SDL_AtomicUnlock(&lock);
+  return(n);
+}
+
+void memFree(void* p)
+{
+  if( !p )
+    return;
+
+  SDL_AtomicLock(&lock);
+  untrack( slotFind(p) );
+  free(p);
+  SDL_AtomicUnlock(&lock);
+}
+
+void memFrameEnd()
+{
+  SDL_AtomicLock(&lock);
+  st.frameAllocs=curAllocs;
+  st.frameBytes=curBytes;
+  if( curAllocs )
+    st.allocFrames++;
+  st.frames++;
+  curAllocs=curBytes=0;
+  SDL_AtomicUnlock(&lock);
+}
+
+void memGetStats(memStats_t* s)
+{
+  SDL_AtomicLock(&lock);
+  *s=st;
+  SDL_AtomicUnlock(&lock);
+}
+
+Uint32 memMark()
+{
+  Uint32 m;
+
+  SDL_AtomicLock(&lock);
+  m=seq;
+  SDL_AtomicUnlock(&lock);
+  return(m);
+}
+
+//"dir/particles.c" is the "particles" subsystem
+static int subsystemLen(const char* file, const char** name)
+{
+  const char* c = strrchr(file, '/');
+  const char* e;
+
+  *name = (c)?c+1:file;
+  e = strrchr(*name, '.');
+  return( (e)?(int)(e-*name):(int)strlen(*name) );
+}
+
+//Logs the MEMTRACK_REPORT_LINES largest of val[], clears what it logged
+static void reportTop(Uint32* val, const char* valName, Uint32* other, const char* otherName)
+{
+  int i, n, best;
+
+  for(n=0; n < MEMTRACK_REPORT_LINES; n++)
+  {
+    best=-1;
+    for(i=0; i <= MEMTRACK_SITES; i++)
+    {
+      if( val[i] && (best==-1 || val[i] > val[best]) )
+        best=i;
+    }
+    if( best==-1 )
+      break;
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "  %s:%i %u %s, %u %s, %u live\n", sites[best].file, sites[best].line, val[best], valName, other[best], otherName, sites[best].live);
+    val[best]=0;
+  }
+}
+
+void memReport(const char* title, Uint32 mark)
+{
+  const char* name;
+  const char* subName[64];
+  int subLen[64];
+  Uint32 subBytes[64], subCount[64];
+  Uint32 count=0, bytes=0;
+  int i, j, len, numSub=0;
+
+  SDL_AtomicLock(&lock);
+
+  memset(repCount, 0, sizeof(repCount));
+  memset(repBytes, 0, sizeof(repBytes));
+  for(i=0; i < MEMTRACK_SLOTS; i++)
+  {
+    //seq wraps, compare the distance from the mark
+    if( slots[i].p && slots[i].seq-mark < seq-mark )
+    {
+      repCount[slots[i].site]++;
+      repBytes[slots[i].site] += slots[i].size;
+      count++;
+      bytes += slots[i].size;
+    }
+  }
+
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Memtrack %s: %u allocations (%u bytes) still live, %u live in total, peak %u bytes\n",
+              title, count, bytes, st.live, st.peakBytes);
+  if( st.frames )
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "  %u of %u frames allocated\n", st.allocFrames, st.frames);
+  if( st.untracked || st.foreign )
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "  %u allocations not tracked (table full), %u frees of unknown pointers\n", st.untracked, st.foreign);
+
+  //By subsystem
+  for(i=0; i <= MEMTRACK_SITES; i++)
+  {
+    if( !repCount[i] )
+      continue;
+    len=subsystemLen(sites[i].file, &name);
+    for(j=0; j < numSub; j++)
+    {
+      if( subLen[j]==len && !strncmp(subName[j], name, len) )
+        break;
+    }
+    if( j==numSub )
+    {
+      if( numSub==64 )
+        continue;
+      subName[j]=name;
+      subLen[j]=len;
+      subBytes[j]=subCount[j]=0;
+      numSub++;
+    }
+    subBytes[j]+=repBytes[i];
+    subCount[j]+=repCount[i];
+  }
+  for(j=0; j < numSub; j++)
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "  [%.*s] %u allocations, %u bytes\n", subLen[j], subName[j], subCount[j], subBytes[j]);
+
+  //By call site
+  reportTop(repBytes, "bytes", repCount, "allocations");
+
+  SDL_AtomicUnlock(&lock);
+}
+
+void memReportSites()
+{
+  int i;
+
+  SDL_AtomicLock(&lock);
+  for(i=0; i <= MEMTRACK_SITES; i++)
+  {
+    repCount[i]=sites[i].allocs;
+    repBytes[i]=sites[i].bytes;
+  }
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Memtrack call sites by allocations over %u frames:\n", st.frames);
+  reportTop(repCount, "allocations", repBytes, "bytes");
+  SDL_AtomicUnlock(&lock);
+}
+
+#endif
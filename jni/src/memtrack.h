@@ -0,0 +1,84 @@
+#ifndef MEMTRACK_H_INCLUDED
+#define MEMTRACK_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+//Allocation tracking, compiled in with WANT_MEMTRACK.
+//This header is force-included in every file (see Android.mk) so malloc,
+//calloc, realloc and free go through the tracker and carry their call site.
+//The subsystem of a call site is its source file.
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+
+//Live allocations that can be tracked, power of two
+#ifndef MEMTRACK_SLOTS
+  #define MEMTRACK_SLOTS 65536
+#endif
+
+//Distinct call sites, power of two
+#ifndef MEMTRACK_SITES
+  #define MEMTRACK_SITES 1024
+#endif
+
+//Lines per list in a report
+#ifndef MEMTRACK_REPORT_LINES
+  #define MEMTRACK_REPORT_LINES 16
+#endif
+
+typedef struct {
+  Uint32 allocs;    //Since start
+  Uint32 bytes;
+  Uint32 frees;
+  Uint32 foreign;   //Frees of pointers the tracker did not see allocated
+  Uint32 untracked; //Allocations made while the table was full
+  Uint32 live;
+  Uint32 liveBytes;
+  Uint32 peakBytes;
+  Uint32 frames;
+  Uint32 frameAllocs; //In the last finished frame
+  Uint32 frameBytes;
+  Uint32 allocFrames; //Frames with at least one allocation
+} memStats_t;
+
+#if defined(WANT_MEMTRACK)
+
+void* memMalloc(size_t size, const char* file, int line);
+void* memCalloc(size_t num, size_t size, const char* file, int line);
+void* memRealloc(void* p, size_t size, const char* file, int line);
+void memFree(void* p);
+
+void memFrameEnd();
+void memGetStats(memStats_t* s);
+
+//Allocations made after memMark() and still live are reported by memReport()
+Uint32 memMark();
+void memReport(const char* title, Uint32 mark);
+//The call sites that allocate most often, since start
+void memReportSites();
+
+#define malloc(s) memMalloc((s), __FILE__, __LINE__)
+#define calloc(n,s) memCalloc((n), (s), __FILE__, __LINE__)
+#define realloc(p,s) memRealloc((p), (s), __FILE__, __LINE__)
+//Not function-like, so free passed as a destructor is tracked as well
+#define free memFree
+
+#endif
+
+#endif // MEMTRACK_H_INCLUDED
@@ -197,8 +197,9 @@ int runMenu(SDL_Surface* screen)
   int scroll; //Generic scoll int (for scrolling lists)
   int ul=0;   //Userlevel (and used for scrolling)
   psysSet_t ps; //Particle system for particle effects in menu
-  listItem* it;
   fileListItem_t* fItem;
+  array_t* fl;
+  int fi;
   int sb;
 
   SDL_Rect r;
@@ -621,7 +622,7 @@ int runMenu(SDL_Surface* screen)
             //If in arcade-mode, clear progress before entering level-selection.
             if(setting()->arcadeMode)
             {
-              stats()->progress=-1;
+              statsSetProgress(-1);
             }
 
             startTransition(screen, TRANSITION_TYPE_CURTAIN_UP, 500 );
@@ -789,8 +790,7 @@ int runMenu(SDL_Surface* screen)
         //If in arcade mode, lose progress
         if(setting()->arcadeMode)
         {
-          stats()->progress=-1;
-          statsSave();
+          statsSetProgress(-1);
         }
 
         if(dir) txtWriteCenter(screen, FONTSMALL, STR_MENU_PRESS_B, HSCREENW, HSCREENH+60);
@@ -1632,12 +1632,20 @@ int runMenu(SDL_Surface* screen)
           x = menuPosY-10;
           scroll=x;
         }
+        //The directory is read on a worker, show that we're at it.
+        if( !fileListReady() )
+        {
+          txtWriteCenter(screen, FONTSMALL, STR_MENU_FILELIST_SCANNING, HSCREENW, HSCREENH-40);
+          menuMaxY=2;
+          break;
+        }
+
         //Run through list
-        it=&fileList()->begin;
+        fl=fileList();
 
-        while( LISTFWD(fileList(), it) )
+        for(fi=0; fi < fl->count; fi++)
         {
-          fItem=(fileListItem_t*)it->data;
+          fItem=(fileListItem_t*)ARRAYAT(fl, fi);
           if(fItem->dir)
           {
             y++;
@@ -1679,10 +1687,9 @@ int runMenu(SDL_Surface* screen)
         x++;
         menuMaxY=x;
 
-        it=&fileList()->begin;
-        while( LISTFWD(fileList(), it) )
+        for(fi=0; fi < fl->count; fi++)
         {
-          fItem=(fileListItem_t*)it->data;
+          fItem=(fileListItem_t*)ARRAYAT(fl, fi);
           if(!fItem->dir)
           {
             if(dir || menuPosY!=x+2) txtWriteCenter(screen, FONTSMALL, fItem->name, HSCREENW, (HSCREENH-40)+(x-scroll)*10);
@@ -1697,7 +1704,7 @@ int runMenu(SDL_Surface* screen)
         starField(screen,0);
         if( menuYesNo == 0)
         {
-          menuYesNo = mkAni(loadImg( "data/menu/yesno.png"), 36,42,0);
+          menuYesNo = mkAni(imgCacheGet( "data/menu/yesno.png"), 36,42,0);
         }
 
         r.y = (setting()->bgPos.y)+ 240-64-16;
@@ -1838,7 +1845,7 @@ int runMenu(SDL_Surface* screen)
 
         if( menuYesNo == 0)
         {
-          menuYesNo = mkAni(loadImg( "data/menu/yesno.png"), 36,42,0);
+          menuYesNo = mkAni(imgCacheGet( "data/menu/yesno.png"), 36,42,0);
         }
 
         r.y = (setting()->bgPos.y)+ 240-60;
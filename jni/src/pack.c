@@ -27,6 +27,7 @@
 #include "defs.h"
 #include "userfiles.h"
 #include "bundle.h"
+#include "archive.h"
 #include "platform/libDLC.h"
 #include "platform/androidUtils.h"
 
@@ -39,6 +40,14 @@
 
 static packStateType ps;
 
+//Packs waiting for the loader thread, in the order they were added.
+static SDL_mutex* loadLock=NULL;
+static packInfoType** loadQueue=NULL;
+static int loadQueueLen=0;
+static int loadQueueSize=0;
+static int loaderRunning=0;
+static SDL_atomic_t prioCounter;
+
 packStateType* packState() { return(&ps); }
 
 void _freePlaylistItem(void* data)
@@ -51,6 +60,10 @@ void _freePlaylistItem(void* data)
 int isFile(const char* fileName)
 {
   struct stat st;
+  if( archiveIsFile(fileName) )
+  {
+    return(1);
+  }
   if(stat(fileName, &st)==0)
   {
 	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "stat() return 0 for file %s",fileName);
@@ -66,6 +79,11 @@ int isFile(const char* fileName)
 int isDir(const char* dirName)
 {
   struct stat st;
+  //Also dirs inside mounted archives
+  if( archiveIsDir(dirName) )
+  {
+    return(1);
+  }
   if(stat(dirName, &st)==0)
   {
     if( (st.st_mode&S_IFDIR) == S_IFDIR )
@@ -76,8 +94,10 @@ int isDir(const char* dirName)
   return(0);
 }
 
-int packAdd(const char* packDir, int isDLC)
+//Read info.ini, icon and levels of a pack, may run on the loader thread so it must not touch ps.
+static void packLoad(packInfoType* ti)
 {
+  const char* packDir = ti->path;
   char* buf = malloc(sizeof(char)*2048);
   char* buf2= malloc(sizeof(char)*1024);
   char* val = malloc(sizeof(char)*1024);
@@ -90,9 +110,8 @@ int packAdd(const char* packDir, int isDLC)
   int i; //Counter
 
   FILE* f=0;
-  packInfoType* ti = malloc(sizeof(packInfoType));
+  levelInfo_t* lvl;
   ti->lives=3; //Default 3 lives, if pack do not define another number.
-  ti->isDLC=isDLC;
 
   //Any levels? (Packs are invalid without a levels folder and atleast one level)
   sprintf(buf, "%s/levels/level000.wzp", packDir);
@@ -161,10 +180,6 @@ int packAdd(const char* packDir, int isDLC)
   }
 
 
-  //Set path
-  ti->path = malloc( sizeof(char)*(strlen(packDir)+1) );
-  strcpy(ti->path,packDir);
-
   //Set pack icon
   sprintf(buf, "%s/icon.png", packDir);
   ti->icon = loadImg(buf);
@@ -176,9 +191,6 @@ int packAdd(const char* packDir, int isDLC)
   //Check if pack have a "finished" icon.
   sprintf(buf, "%s/finished.png", packDir);
 
-  //Set ps.cp before entering makeLevelist, it makes use of packGetFile
-  ps.cp = ti;
-
   //Add levels.
   ti->levels=0;
   ti->levels=makeLevelList(packDir); //makeLevelList looks in packDir/levels/
@@ -187,25 +199,16 @@ int packAdd(const char* packDir, int isDLC)
   ti->numLevels = ti->levels->count - 1  ; //The last level does not count (because it is just a "completed" screen).
 
 
-  //Add to list of packages
-  listAppendData( ps.packs, (void*)ti );
-
-  //Increase number of available packages
-  ps.numPacks++;
-
   //Put playlist songs into levelfiles.
   li=&playList->begin;
   while( LISTFWD(playList,li) )
   {
     pli=(playListItem*)li->data;
 
-    for(i=0; i<ti->numLevels;i++)
+    for(i=(pli->from>0)?pli->from:0; i <= pli->to && i < ti->numLevels; i++)
     {
-      if(i >= pli->from && i <= pli->to)
-      {
-        levelInfo(i)->musicFile = malloc( sizeof(char)*strlen(pli->song)+1 );
-        strcpy(levelInfo(i)->musicFile, pli->song);
-      }
+      lvl=(levelInfo_t*)ARRAYAT(ti->levels,i);
+      lvl->musicFile = (char*)strIntern( pli->song );
     }
   }
 
@@ -216,10 +219,156 @@ int packAdd(const char* packDir, int isDLC)
   free(buf2);
   free(val);
   free(set);
+}
+
+//Called with loadLock held. Claims the listed pack that was asked for most recently, or the first one.
+static packInfoType* packNextToLoad()
+{
+  packInfoType* best;
+  int i, prio, bestPrio;
+
+  do
+  {
+    best=NULL;
+    bestPrio=-1;
+    for(i=0; i < loadQueueLen; i++)
+    {
+      if( SDL_AtomicGet( &loadQueue[i]->state ) == PACK_STATE_LISTED )
+      {
+        prio = SDL_AtomicGet( &loadQueue[i]->prio );
+        if( prio > bestPrio )
+        {
+          best = loadQueue[i];
+          bestPrio = prio;
+        }
+      }
+    }
+    //The main thread may claim a pack between the check and here.
+  } while( best && !SDL_AtomicCAS( &best->state, PACK_STATE_LISTED, PACK_STATE_LOADING ) );
+
+  return(best);
+}
+
+static int packLoader(void* data)
+{
+  packInfoType* pi;
+  Uint32 start = SDL_GetTicks();
+  int num=0;
+
+  while(1)
+  {
+    SDL_LockMutex( loadLock );
+    pi = packNextToLoad();
+    if( !pi )
+    {
+      loaderRunning=0;
+      SDL_UnlockMutex( loadLock );
+      break;
+    }
+    SDL_UnlockMutex( loadLock );
+
+    packLoad( pi );
+    SDL_AtomicSet( &pi->state, PACK_STATE_READY );
+    num++;
+  }
+
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "packLoader(); Loaded %i packs in %u ms.\n", num, SDL_GetTicks()-start );
+  return(0);
+}
+
+//Ask the loader to take this pack next.
+static void packRequest(packInfoType* pi)
+{
+  SDL_AtomicSet( &pi->prio, SDL_AtomicAdd( &prioCounter, 1 )+1 );
+}
+
+void packWaitReady(packInfoType* pi)
+{
+  if( SDL_AtomicCAS( &pi->state, PACK_STATE_LISTED, PACK_STATE_LOADING ) )
+  {
+    packLoad( pi );
+    SDL_AtomicSet( &pi->state, PACK_STATE_READY );
+    return;
+  }
+
+  //The loader is busy with it
+  while( SDL_AtomicGet( &pi->state ) != PACK_STATE_READY )
+  {
+    SDL_Delay(1);
+  }
+}
+
+int packAdd(const char* packDir, int isDLC)
+{
+  SDL_Thread* thread;
+  packInfoType* ti = malloc(sizeof(packInfoType));
+  memset( ti, 0, sizeof(packInfoType) );
+  ti->isDLC=isDLC;
+
+  //Set path
+  ti->path = malloc( sizeof(char)*(strlen(packDir)+1) );
+  strcpy(ti->path,packDir);
+
+  SDL_AtomicSet( &ti->state, PACK_STATE_LISTED );
+  SDL_AtomicSet( &ti->prio, 0 );
+
+  //The pack selected last time is needed first
+  if( setting()->packDir && strcmp( setting()->packDir, packDir )==0 )
+  {
+    packRequest( ti );
+  }
+
+  //Add to list of packages
+  listAppendData( ps.packs, (void*)ti );
+
+  //Increase number of available packages
+  ps.numPacks++;
+
+  if( !loadLock )
+  {
+    loadLock = SDL_CreateMutex();
+  }
+
+  if( loadLock )
+  {
+    SDL_LockMutex( loadLock );
+    if( loadQueueLen == loadQueueSize )
+    {
+      loadQueueSize = (loadQueueSize)?loadQueueSize*2:32;
+      loadQueue = realloc( loadQueue, sizeof(packInfoType*)*loadQueueSize );
+    }
+    loadQueue[loadQueueLen++] = ti;
+
+    if( !loaderRunning )
+    {
+      thread = SDL_CreateThread( packLoader, "packLoader", NULL );
+      if( thread )
+      {
+        SDL_DetachThread( thread );
+        loaderRunning=1;
+      } else {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "packAdd(); Could not start pack loader: %s\n", SDL_GetError() );
+      }
+    }
+    SDL_UnlockMutex( loadLock );
+  }
 
   return(ps.numPacks-1);
 }
 
+//Packs without a loader are loaded when they are first drawn.
+static int packLoaderRunning()
+{
+  int running=0;
+  if( loadLock )
+  {
+    SDL_LockMutex( loadLock );
+    running = loaderRunning;
+    SDL_UnlockMutex( loadLock );
+  }
+  return(running);
+}
+
 
 
 int strCmp(const void* a, const void* b)
@@ -257,7 +406,19 @@ void packScanDir( const char* path, list_t* dirList )
           {
             //It's a file, let's try and see if it's a bundle.
             int l = strlen(buf);
-            if( l > 4 && strcasecmp( &buf[l-4] ,".wiz" )==0 )
+            if( l > 4 && SDL_strcasecmp( &buf[l-4], ARCHIVE_EXT )==0 )
+            {
+              //Archives are used in place, no need to extract them.
+              if( archiveMount(buf) )
+              {
+                char* pdstr = malloc( sizeof(char)*strlen(buf)+1 );
+                strcpy( pdstr, buf );
+                listAppendData( dirList, (void*)pdstr );
+              } else {
+                SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "The pack archive '%s' could not be opened.\n", buf);
+              }
+            } else
+            if( l > 4 && SDL_strcasecmp( &buf[l-4] ,".wiz" )==0 )
             {
 
               l = debundle( buf, getUsrPackDir() );
@@ -367,10 +528,12 @@ const char* packGetFile(const char* path,const char* fn)
 {
   //First, see if file exists in selected pack.
   static char buf[4096];
+  //Before a pack is selected (sound init), use the first pack, its path is known without loading it.
+  const char* packPath = (ps.cp)?ps.cp->path:((packInfoType*)listGetItemAt(ps.packs,0)->data)->path;
   if(path != NULL) {
-	sprintf( buf, "%s/%s/%s", ps.cp->path, path, fn );
+	sprintf( buf, "%s/%s/%s", packPath, path, fn );
   } else {
-	sprintf( buf, "%s/%s", ps.cp->path, fn );
+	sprintf( buf, "%s/%s", packPath, fn );
   }
   return(buf);
 }
@@ -378,7 +541,7 @@ const char* packGetFile(const char* path,const char* fn)
 
 levelInfo_t* levelInfo(int num)
 {
-  levelInfo_t* li = (levelInfo_t*)(listGetItemAt(ps.cp->levels,num)->data);
+  levelInfo_t* li = (levelInfo_t*)arrayGetAt(ps.cp->levels,num);
   return( li );
 }
 
@@ -400,6 +563,7 @@ void packSet(int packNum)
 
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "packSet(); Selecting pack %i...\n", ps.selected);
   ps.cp = (packInfoType*)listGetItemAt(ps.packs, ps.selected)->data;
+  packWaitReady( ps.cp );
 
   //Set finishedImg 0 when we select a pack, to make sure the correct image is loaded.
   ps.finishedImg=0;
@@ -449,6 +613,8 @@ void packFreeGfx()
   ps.packBoxSpr[2]=0;
   ps.packBoxSpr[3]=0;
   ps.packBoxSpr[4]=0;
+  SDL_FreeSurface(ps.noIcon);
+  ps.noIcon=0;
 }
 
 void drawPackBox(SDL_Surface* screen,int posx, int posy,int packNum)
@@ -514,6 +680,24 @@ void drawPackBox(SDL_Surface* screen,int posx, int posy,int packNum)
   
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "==== 20");
 
+  //Show the path until the loader is done with the pack
+  if( SDL_AtomicGet( &pi->state ) != PACK_STATE_READY )
+  {
+    if( packLoaderRunning() )
+    {
+      packRequest( pi );
+      if( !ps.noIcon )
+      {
+        ps.noIcon = loadImg( "data/noicon.png" );
+      }
+      SDL_BlitSurface(ps.noIcon,0,screen, &r);
+      txtWrite(screen, FONTSMALL, (strrchr(pi->path,'/'))?strrchr(pi->path,'/')+1:pi->path, posx+40, posy+4);
+      txtWrite(screen, FONTSMALL, STR_MENU_PACKLIST_LOADING, posx+40, posy+4+12);
+      return;
+    }
+    packWaitReady( pi );
+  }
+
   //Blit the icon image
   SDL_BlitSurface(pi->icon,0,screen, &r);
 
@@ -27,17 +27,25 @@
 #define PACK_IS_NOT_DLC 0
 #define PACK_IS_DLC 1
 
+//Packs are listed first, and loaded (info.ini, icon and levels) by a background thread,
+//or by the main thread when they're needed before the loader got to them.
+#define PACK_STATE_LISTED 0
+#define PACK_STATE_LOADING 1
+#define PACK_STATE_READY 2
+
 struct packInfo_s {
   char* name; //Name user sees
   char* author;
   char* comment;
   char* path; //Path to pack
   SDL_Surface* icon;
-  list_t* levels; //LevelInfo*'s
+  array_t* levels; //LevelInfo*'s
   int numLevels;
   int hasFinishedImg;
   int lives;
   int isDLC;
+  SDL_atomic_t state; //PACK_STATE_*, the fields above path are only valid when ready
+  SDL_atomic_t prio; //Packs asked for most recently are loaded first
 };
 typedef struct packInfo_s packInfoType;
 
@@ -50,6 +58,7 @@ struct packState_s {
   SDL_Surface* packBoxImg; //Graphics for the box
   SDL_Surface* finishedImg;; //Image shown when cp is completed (0 = not been loaded)
   spriteType* packBoxSpr[5];
+  SDL_Surface* noIcon; //Shown on packs that are still loading
 };
 typedef struct packState_s packStateType;
 
@@ -74,7 +83,9 @@ void drawPackBox(SDL_Surface* screen, int posx, int posy, int packNum);
 int isFile(const char* fileName);
 int isDir(const char* dirName);
 
-//Returns the number of the added pack.
+//Returns the number of the added pack, it is loaded in the background.
 int packAdd(const char* packDir, int isDLC);
+//Load the pack now if the loader hasn't got to it yet.
+void packWaitReady(packInfoType* pi);
 
 #endif // PACK_H_INCLUDED
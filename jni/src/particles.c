@@ -17,6 +17,7 @@
 
 #include "particles.h"
 #include "settings.h"
+#include "profiler.h"
 
 #define GRAVITYCONSTANT 2
 
@@ -110,7 +111,7 @@ void spawnParticleSystem(psysSet_t* settings)
 
 
   //Add to list of systems.
-  listAppendData(pSystems, (void*)tSystem);
+  listAppendItem(pSystems, &tSystem->link, (void*)tSystem);
 }
 
 
@@ -170,6 +171,8 @@ void runParticlesLayer(SDL_Surface* screen, int layer)
   pSystem_t* p; //psystem
   int i;
 
+  profBegin(PROF_PARTICLES);
+
   //Loop through systems
   listItem* it = &pSystems->begin;
   while( LISTFWD(pSystems,it) )
@@ -193,13 +196,15 @@ void runParticlesLayer(SDL_Surface* screen, int layer)
       p->settings.life -= getTicks();
       if(p->settings.life<0)
       {
-        //Remove system
-        clearSystem(p);
         //Remove from list. (removeItem returns the item just before current, if any)
         it=listRemoveItem(pSystems, it, LIST_PREV);
+        //Remove system, the list node goes with it
+        clearSystem(p);
       }
     } //System is on correct layer
   }
+
+  profEnd(PROF_PARTICLES);
 }
 
 //Frees one system
@@ -216,16 +221,19 @@ void clearParticles()
 {
   listItem* it = &pSystems->begin;
   //Loop through systems
+  pSystem_t* p;
   while( LISTFWD(pSystems,it) )
   {
-    clearSystem( (pSystem_t*)it->data );
+    p=(pSystem_t*)it->data;
     it=listRemoveItem(pSystems, it, LIST_PREV);
+    clearSystem( p );
   }
 }
 
 void initParticles(SDL_Surface* scr)
 {
-  pSystems = listInit(NULL);
+  //Systems carry their own list node, spawning one doesn't allocate a node too.
+  pSystems = listInitIntrusive(NULL);
   screen=scr;
 
   psysPresets[PSYS_PRESET_COLOR].layer=PSYS_LAYER_TOP;
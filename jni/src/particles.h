@@ -67,6 +67,7 @@ struct pSystem_s
 {
   particle_t *particles; //Array of particles
   psysSet_t settings;  //Settings for system
+  listItem link; //Node in the list of systems
 };
 typedef struct pSystem_s pSystem_t;
 
@@ -1,4 +1,5 @@
 #include "androidUtils.h"
+#include "../archive.h"
 
 AAssetManager* asset_mgr;
 
@@ -31,6 +32,10 @@ static int android_close(void* cookie) {
 FILE* android_fopen(const char* fname, const char* mode) {
   if(mode[0] == 'w') return NULL;
 
+  //Files inside mounted pack archives
+  FILE* f = archiveFopen(fname);
+  if(f) return f;
+
   AAsset* asset = AAssetManager_open(asset_mgr, fname, 0);
   if(!asset) return NULL;
 
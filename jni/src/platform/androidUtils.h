@@ -2,13 +2,21 @@
 #define ANDROID_H_UTILS
 
 #include <assert.h>
-#include <android/asset_manager_jni.h>
-#include <jni.h>
 #include <SDL.h>
 #include <errno.h>
 
+#if defined(__ANDROID__)
+#include <android/asset_manager_jni.h>
+#include <jni.h>
+
 extern AAssetManager* asset_mgr;
 
 FILE* android_fopen(const char* fname, const char* mode);
+#else
+//Elsewhere the assets are plain files, unless they are in a pack archive
+#include <stdio.h>
+#include "../archive.h"
+#define android_fopen archiveFopenAny
+#endif
 
 #endif
\ No newline at end of file
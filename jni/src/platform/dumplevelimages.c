@@ -15,6 +15,9 @@
  * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
  ************************************************************************/
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "dumplevelimages.h"
 #include "../levels.h"
 #include "../board.h"
@@ -22,6 +25,7 @@
 #include "../cursor.h"
 #include "../player.h"
 #include "../pack.h"
+#include "../capture.h"
 #include "platform/androidUtils.h"
 
 void dumplevelimages(SDL_Surface* screen, const char* packName, int dumpStartImage)
@@ -145,84 +149,43 @@ void dumpOneLevelFile(SDL_Surface* screen, const char* fileName)
 
 tgaData_t* tgaData(SDL_Surface* screen)
 {
-  SDL_LockSurface(screen);
   tgaData_t* tga = malloc(sizeof(tgaData_t));
-
-  tga->len = (screen->h*screen->w*3)+(12+6);
-  tga->data = malloc(tga->len*60); //try allocating for 60 fps more, if that's not possible, we bail.
-
-  if(tga->data)
+  if(!tga)
   {
-    free(tga->data);
-  } else {
-    free(tga);
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "tgaData(); Not enough memory to take screenshot.\n");
     return(NULL);
   }
 
+  tga->len = CAPTURE_TGA_LEN(screen->w, screen->h);
   tga->data = malloc(tga->len);
-
-
-  //Tga header
-  tga->data[0] = 0;
-  tga->data[1] = 0;
-  tga->data[2] = 2;
-  tga->data[3] = 0;
-  tga->data[4] = 0;
-  tga->data[5] = 0;
-  tga->data[6] = 0;
-  tga->data[7] = 0;
-  tga->data[8] = 0;
-  tga->data[9] = 0;
-  tga->data[10] = 0;
-  tga->data[11] = 0;
-
-  //File info
-  tga->data[12] = screen->w%256;
-  tga->data[13] = screen->w/256;
-  tga->data[14] = screen->h%256;
-  tga->data[15] = screen->h/256;
-  tga->data[16] = 24;
-  tga->data[17] = ( 0  | 32);
-
-
-#ifdef DEBUG
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Surf info:\n  Pitch: %i\n  BytesPrPixel: %i\n  BitsPrPixel: %i\n",
-  screen->pitch, screen->format->BytesPerPixel, screen->format->BitsPerPixel);
-
-  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Rmask: %i\nGmask %i\nBmask %i\nRshift: %i\nGshift %i\nBshift: %i\n",
-  screen->format->Rmask,screen->format->Gmask,screen->format->Bmask,
-  screen->format->Rshift,screen->format->Gshift,screen->format->Bshift);
- #endif
-
-  int i;
-  uint16_t t;
-  //Read pixels as one 16 bit number, then extract rgb values, normalize brightness, (green is too high) and swap red/blue, then save to data
-  unsigned char* imgData=&tga->data[18];
-  for(i=0; i<screen->w*screen->h; i++)
+  if(!tga->data)
   {
-    if(screen->format->BytesPerPixel==2)
-    {
-      t = *((uint16_t*)screen->pixels+i);
-
-      imgData[i*3] =((t & screen->format->Bmask) >> screen->format->Bshift) *8;  //blue
-      imgData[i*3+1]= (((t & screen->format->Gmask) >> screen->format->Gshift) ) *4; //green
-      imgData[i*3+2]  = ((t & screen->format->Rmask) >> screen->format->Rshift) *8; //Red color
-    } else {
-      imgData[i*3]=(unsigned char)((unsigned char*)screen->pixels)[i*3];
-      imgData[i*3+1]=(unsigned char)((unsigned char*)screen->pixels)[i*3+1];
-      imgData[i*3+2]=(unsigned char)((unsigned char*)screen->pixels)[i*3+2];
-    }
-
+    free(tga);
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "tgaData(); Not enough memory to take screenshot.\n");
+    return(NULL);
   }
+
+  SDL_LockSurface(screen);
+  captureTga(tga->data, screen->w, screen->h, screen->format->format, screen->pixels, screen->pitch);
   SDL_UnlockSurface(screen);
   return(tga);
 }
 
 void tgaSave(tgaData_t* tga, const char* fileName)
 {
+  FILE *f;
 
-  FILE *f = android_fopen(fileName, "w");
+  if(!tga)
+  {
+    return;
+  }
+
+  //android_fopen can only read
+  f = fopen(fileName, "wb");
+  if(!f)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "tgaSave(); Couldn't open '%s' for writing.\n", fileName);
+    return;
+  }
 
 #ifdef DEBUG
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Saving: %s\n",fileName);
@@ -236,32 +199,10 @@ void tgaSave(tgaData_t* tga, const char* fileName)
 
 void tgaFree(tgaData_t* tga)
 {
+  if(!tga)
+  {
+    return;
+  }
   free(tga->data);
   free(tga);
 }
-
-static SDL_Surface* scr;
-void screenShotSetCaptureScreen(SDL_Surface* screen)
-{
-  scr=screen;
-}
-
-void screenShot()
-{
-  tgaData_t* tga = tgaData(scr);
-  char scrName[2048];
-  int num=0;
-
-  //Find next nonexisting match of Wizznic_%02i.tga"
-  do
-  {
-    sprintf(scrName, "Wizznic_%02i.tga", num);
-    scrName[0]=0;
-    num++;
-  } while (!scrName[0]);
-
-  printf("Saving %s\n",scrName);
-  tgaSave(tga, scrName);
-  tgaFree(tga);
-}
-
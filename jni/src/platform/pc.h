@@ -105,7 +105,9 @@
   void platformDrawScaled(SDL_Surface* src);
 #endif
 
-//PC's are always able to use sw-scaling
-#define WANT_SWSCALE
+//PC's are always able to use sw-scaling, unless the build leaves it out
+#if !defined(NO_SWSCALE)
+  #define WANT_SWSCALE
+#endif
 
 #endif // PC_H_INCLUDED
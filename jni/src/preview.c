@@ -0,0 +1,474 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL_image.h>
+
+#include "preview.h"
+#include "defs.h"
+#include "board.h"
+#include "levels.h"
+#include "sprite.h"
+
+//Where the board is on the background image, see draw(). The frame around it is included.
+#define PREVIEW_BOARD_X ( boardOffsetX-(HSCREENW-160)-PREVIEW_BORDER )
+#define PREVIEW_BOARD_Y ( boardOffsetY-(HSCREENH-120)-PREVIEW_BORDER )
+#define PREVIEW_BOARD_SIZE ( FIELDSIZE*brickSize+PREVIEW_BORDER*2 )
+
+typedef struct {
+  char* path;
+  SDL_Surface* surf; //NULL if the file couldn't be loaded, so it isn't tried again
+  int lastUse;
+} previewImg_t;
+
+//Everything a worker renders with, so workers share nothing but the job list.
+typedef struct {
+  previewImg_t img[PREVIEW_IMG_CACHE];
+  int clock;
+  SDL_Surface* board;
+  SDL_Surface* out;
+} previewCtx_t;
+
+typedef struct {
+  char* file;
+  const char* packDir;
+} previewItem_t;
+
+typedef struct {
+  previewItem_t* items;
+  int numItems;
+  SDL_atomic_t next;
+  SDL_atomic_t made;
+} previewJob_t;
+
+static SDL_Surface* previewImg(previewCtx_t* ctx, const char* path)
+{
+  int i;
+  previewImg_t* victim=&ctx->img[0];
+
+  for(i=0; i < PREVIEW_IMG_CACHE; i++)
+  {
+    if( ctx->img[i].path && strcmp(ctx->img[i].path, path)==0 )
+    {
+      ctx->img[i].lastUse=++ctx->clock;
+      return(ctx->img[i].surf);
+    }
+    if( !ctx->img[i].path || (victim->path && ctx->img[i].lastUse < victim->lastUse) )
+    {
+      victim=&ctx->img[i];
+    }
+  }
+
+  if( victim->path )
+  {
+    if( victim->surf )
+      SDL_FreeSurface( victim->surf );
+    free( victim->path );
+  }
+
+  victim->path = malloc( strlen(path)+1 );
+  strcpy( victim->path, path );
+  victim->surf = loadImg( path );
+  victim->lastUse=++ctx->clock;
+  return(victim->surf);
+}
+
+static int previewCtxInit(previewCtx_t* ctx)
+{
+  memset( ctx, 0, sizeof(previewCtx_t) );
+  //Same format as loadImg() gives, so the blits are plain copies
+  ctx->board = SDL_CreateRGBSurface( 0, PREVIEW_BOARD_SIZE, PREVIEW_BOARD_SIZE, 32, 0xff0000, 0xff00, 0xff, 0 );
+  ctx->out = SDL_CreateRGBSurface( 0, PREVIEW_W, PREVIEW_H, 32, 0xff0000, 0xff00, 0xff, 0 );
+  if( !ctx->board || !ctx->out )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "preview: Couldn't create surfaces: %s\n", SDL_GetError());
+    return(0);
+  }
+  return(1);
+}
+
+static void previewCtxFree(previewCtx_t* ctx)
+{
+  int i;
+  for(i=0; i < PREVIEW_IMG_CACHE; i++)
+  {
+    if( ctx->img[i].surf )
+      SDL_FreeSurface( ctx->img[i].surf );
+    free( ctx->img[i].path );
+  }
+  if( ctx->board )
+    SDL_FreeSurface( ctx->board );
+  if( ctx->out )
+    SDL_FreeSurface( ctx->out );
+}
+
+static void previewBlit(SDL_Surface* dst, SDL_Surface* img, int sx, int size, int x, int y)
+{
+  SDL_Rect clip, pos;
+  clip.x=sx;
+  clip.y=0;
+  clip.w=size;
+  clip.h=size;
+  pos.x=x;
+  pos.y=y;
+  SDL_BlitSurface( img, &clip, dst, &pos );
+}
+
+//Like draw() does it, the first frame of the animation if there is one, otherwise the tile.
+static void previewTile(SDL_Surface* dst, SDL_Surface* tiles, SDL_Surface** ani, int type, int x, int y)
+{
+  if( ani[type-1] )
+  {
+    previewBlit( dst, ani[type-1], 0, 30, x-5, y-5 );
+  } else {
+    previewBlit( dst, tiles, (type-1)*brickSize, brickSize, x, y );
+  }
+}
+
+//Box filter, each pixel of dst is the average of the pixels of src it covers.
+static void previewScale(SDL_Surface* src, SDL_Surface* dst)
+{
+  int x,y,sx,sy,sx0,sx1,sy0,sy1,n;
+  Uint32 r,g,b,p;
+  Uint32* d;
+
+  for(y=0; y < dst->h; y++)
+  {
+    sy0 = y*src->h/dst->h;
+    sy1 = (y+1)*src->h/dst->h;
+    d = (Uint32*)((Uint8*)dst->pixels + y*dst->pitch);
+    for(x=0; x < dst->w; x++)
+    {
+      sx0 = x*src->w/dst->w;
+      sx1 = (x+1)*src->w/dst->w;
+      r=g=b=0;
+      for(sy=sy0; sy < sy1; sy++)
+      {
+        const Uint32* s = (const Uint32*)((const Uint8*)src->pixels + sy*src->pitch);
+        for(sx=sx0; sx < sx1; sx++)
+        {
+          p = s[sx];
+          r += (p>>16)&0xff;
+          g += (p>>8)&0xff;
+          b += p&0xff;
+        }
+      }
+      n = (sx1-sx0)*(sy1-sy0);
+      d[x] = ((r+n/2)/n)<<16 | ((g+n/2)/n)<<8 | ((b+n/2)/n);
+    }
+  }
+}
+
+static int previewRender(previewCtx_t* ctx, playField* pf, const char* packDir)
+{
+  char buf[1024];
+  int x,y,i,type;
+  SDL_Rect src;
+  SDL_Surface* bg;
+  SDL_Surface* tiles;
+  SDL_Surface* walls;
+  SDL_Surface* ani[NUMTILES];
+  brickType* b;
+  listItem* it;
+  levelInfo_t* li = pf->levelInfo;
+
+  snprintf( buf, sizeof(buf), "%s/themes/%s", packDir, li->bgFile );
+  bg = previewImg( ctx, buf );
+  snprintf( buf, sizeof(buf), "%s/themes/%s.png", packDir, li->tileBase );
+  tiles = previewImg( ctx, buf );
+  snprintf( buf, sizeof(buf), "%s/themes/%s.png", packDir, li->wallBase );
+  walls = previewImg( ctx, buf );
+  if( !bg || !tiles || !walls )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "preview: Missing theme graphics for %s\n", li->file);
+    return(0);
+  }
+
+  for(i=0; i < NUMTILES; i++)
+  {
+    snprintf( buf, sizeof(buf), "%s/themes/%s-tile%02i.png", packDir, li->tileBase, i );
+    ani[i] = previewImg( ctx, buf );
+  }
+
+  SDL_FillRect( ctx->board, NULL, 0 );
+  src.x=PREVIEW_BOARD_X;
+  src.y=PREVIEW_BOARD_Y;
+  src.w=PREVIEW_BOARD_SIZE;
+  src.h=PREVIEW_BOARD_SIZE;
+  SDL_BlitSurface( bg, &src, ctx->board, NULL );
+
+  //Walls first, every brick goes on top of them
+  for(y=0; y < FIELDSIZE; y++)
+  {
+    for(x=0; x < FIELDSIZE; x++)
+    {
+      if( isWall(pf, x, y) )
+      {
+        b = pf->board[x][y];
+        previewBlit( ctx->board, walls, 0, brickSize, PREVIEW_BORDER+x*brickSize, PREVIEW_BORDER+y*brickSize );
+        for(i=1; i < 13; i++)
+        {
+          if( b->edges & (1<<i) )
+            previewBlit( ctx->board, walls, i*brickSize, brickSize, PREVIEW_BORDER+x*brickSize, PREVIEW_BORDER+y*brickSize );
+        }
+      }
+    }
+  }
+
+  for(y=0; y < FIELDSIZE; y++)
+  {
+    for(x=0; x < FIELDSIZE; x++)
+    {
+      b = pf->board[x][y];
+      if( !b || b->type == RESERVED || b->type == STDWALL )
+        continue;
+
+      type = b->type;
+      if( isSwitch(b) )
+      {
+        type = ( (type==SWON)?b->isActive:!b->isActive )?SWON:SWOFF;
+      }
+      previewTile( ctx->board, tiles, ani, type, PREVIEW_BORDER+x*brickSize, PREVIEW_BORDER+y*brickSize );
+    }
+  }
+
+  it = &li->teleList->begin;
+  while( LISTFWD(li->teleList, it) )
+  {
+    telePort_t* tp = (telePort_t*)it->data;
+    previewTile( ctx->board, tiles, ani, TELESRC, PREVIEW_BORDER+tp->sx*brickSize, PREVIEW_BORDER+tp->sy*brickSize );
+  }
+
+  previewScale( ctx->board, ctx->out );
+  return(1);
+}
+
+static int previewMakeCtx(previewCtx_t* ctx, const char* fileName, const char* packDir)
+{
+  char pngName[1024];
+  char tmpName[1040];
+  playField pf;
+  int ok=0;
+
+  if( snprintf( pngName, sizeof(pngName), "%s.png", fileName ) >= (int)sizeof(pngName) )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "preview: Name too long, %s\n", fileName);
+    return(0);
+  }
+
+  //One pass over the level file, the info and the cells together
+  if( loadLevelWzp(&pf, fileName) )
+  {
+    if( previewRender(ctx, &pf, packDir) )
+    {
+      //Readers never see a half written preview
+      snprintf( tmpName, sizeof(tmpName), "%s.tmp", pngName );
+      ok = ( IMG_SavePNG( ctx->out, tmpName ) == 0 );
+      if( !ok || rename( tmpName, pngName ) != 0 )
+      {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "preview: Couldn't write %s\n", pngName);
+        remove( tmpName );
+        ok=0;
+      }
+    }
+    freeField( &pf );
+  }
+  if( pf.levelInfo )
+    freeLevelInfo( &pf.levelInfo );
+
+  return(ok);
+}
+
+int previewMake(const char* fileName, const char* packDir)
+{
+  previewCtx_t* ctx = malloc( sizeof(previewCtx_t) );
+  int ok=0;
+
+  if( ctx && previewCtxInit(ctx) )
+  {
+    ok = previewMakeCtx( ctx, fileName, packDir );
+  }
+  if( ctx )
+  {
+    previewCtxFree( ctx );
+    free( ctx );
+  }
+  return(ok);
+}
+
+static int previewWorker(void* data)
+{
+  previewJob_t* job = (previewJob_t*)data;
+  previewCtx_t* ctx = malloc( sizeof(previewCtx_t) );
+  int i;
+
+  if( ctx && previewCtxInit(ctx) )
+  {
+    while( (i = SDL_AtomicAdd( &job->next, 1 )) < job->numItems )
+    {
+      if( previewMakeCtx( ctx, job->items[i].file, job->items[i].packDir ) )
+        SDL_AtomicAdd( &job->made, 1 );
+    }
+  }
+
+  if( ctx )
+  {
+    previewCtxFree( ctx );
+    free( ctx );
+  }
+  return(0);
+}
+
+//Missing, or older than the level
+static int previewStale(const char* fileName)
+{
+  char pngName[1024];
+  struct stat lvl, png;
+
+  //Too long to be written, previewMakeCtx says so
+  if( snprintf( pngName, sizeof(pngName), "%s.png", fileName ) >= (int)sizeof(pngName) )
+    return(1);
+  if( stat(pngName, &png) != 0 )
+    return(1);
+  if( stat(fileName, &lvl) != 0 )
+    return(0);
+  return( lvl.st_mtime >= png.st_mtime );
+}
+
+int previewPacks(const char** packDirs, int numPacks, int force)
+{
+  char buf[1024];
+  struct stat st;
+  previewJob_t job;
+  SDL_Thread* workers[PREVIEW_WORKERS_MAX];
+  int numWorkers = (PREVIEW_WORKERS)?PREVIEW_WORKERS:SDL_GetCPUCount()-1;
+  int i, p, num, size=0, levels=0;
+  Uint32 t = SDL_GetTicks();
+
+  job.items=NULL;
+  job.numItems=0;
+
+  //Levels are numbered from 0 without gaps, like levelIndexLoad() lists them
+  for(p=0; p < numPacks; p++)
+  {
+    for(num=0; ; num++)
+    {
+      snprintf( buf, sizeof(buf), "%s/levels/level%03i.wzp", packDirs[p], num );
+      if( stat(buf, &st) != 0 )
+        break;
+      levels++;
+
+      if( !force && !previewStale(buf) )
+        continue;
+
+      if( job.numItems == size )
+      {
+        previewItem_t* items;
+        size = (size)?size*2:64;
+        items = realloc( job.items, sizeof(previewItem_t)*size );
+        if( !items )
+        {
+          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "preview: Out of memory.\n");
+          break;
+        }
+        job.items = items;
+      }
+      job.items[job.numItems].file = malloc( strlen(buf)+1 );
+      strcpy( job.items[job.numItems].file, buf );
+      job.items[job.numItems].packDir = packDirs[p];
+      job.numItems++;
+    }
+
+    if( num == 0 )
+    {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "preview: No levels in %s\n", packDirs[p]);
+    }
+  }
+
+  if( numWorkers > job.numItems-1 )
+    numWorkers = job.numItems-1;
+  if( numWorkers > PREVIEW_WORKERS_MAX )
+    numWorkers = PREVIEW_WORKERS_MAX;
+  if( numWorkers < 0 )
+    numWorkers = 0;
+
+  SDL_AtomicSet( &job.next, 0 );
+  SDL_AtomicSet( &job.made, 0 );
+
+  for(i=0; i < numWorkers; i++)
+  {
+    workers[i] = SDL_CreateThread( previewWorker, "preview", (void*)&job );
+  }
+
+  //If no thread could be started, do the work here
+  previewWorker( (void*)&job );
+
+  for(i=0; i < numWorkers; i++)
+  {
+    if( workers[i] )
+      SDL_WaitThread( workers[i], NULL );
+  }
+
+  for(i=0; i < job.numItems; i++)
+  {
+    free( job.items[i].file );
+  }
+  free( job.items );
+
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "preview: %i levels, %i stale, %i made by %i threads in %i ms.\n",
+              levels, job.numItems, SDL_AtomicGet(&job.made), numWorkers+1, SDL_GetTicks()-t );
+
+  if( SDL_AtomicGet(&job.made) != job.numItems )
+    return(-1);
+  return( SDL_AtomicGet(&job.made) );
+}
+
+int previewMain(int argc, char** argv)
+{
+  int force=0, ret;
+
+  if( argc > 0 && strcmp(argv[0], "-f")==0 )
+  {
+    force=1;
+    argc--;
+    argv++;
+  }
+
+  if( argc < 1 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Usage: -previews [-f] packs/packdir [packs/packdir ...]\n");
+    return(-1);
+  }
+
+  //No window is ever opened, everything is drawn to surfaces in memory.
+  SDL_setenv( "SDL_VIDEODRIVER", "dummy", 1 );
+  if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "SDL_Init failed: %s\n", SDL_GetError());
+    return(-1);
+  }
+  IMG_Init( IMG_INIT_PNG );
+
+  ret = previewPacks( (const char**)argv, argc, force );
+
+  IMG_Quit();
+  SDL_Quit();
+  return( (ret < 0)?-1:0 );
+}
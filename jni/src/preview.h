@@ -0,0 +1,53 @@
+#ifndef PREVIEW_H_INCLUDED
+#define PREVIEW_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <SDL.h>
+
+//Level previews (levelNNN.wzp.png) are the board and its frame, scaled down. They are
+//rendered without draw.c, so any number of them can be made at once, and without a window.
+
+#define PREVIEW_W 110
+#define PREVIEW_H 110
+//Pixels of the background around the board that are part of the preview
+#ifndef PREVIEW_BORDER
+  #define PREVIEW_BORDER 5
+#endif
+
+//Threads rendering previews, besides the caller. 0 means one per core.
+#ifndef PREVIEW_WORKERS
+  #define PREVIEW_WORKERS 0
+#endif
+#ifndef PREVIEW_WORKERS_MAX
+  #define PREVIEW_WORKERS_MAX 16
+#endif
+//Theme images kept by each worker, levels in a pack tend to share them.
+#ifndef PREVIEW_IMG_CACHE
+  #define PREVIEW_IMG_CACHE 48
+#endif
+
+//Render fileName.png, using the themes from packDir. Ret 1 on success.
+int previewMake(const char* fileName, const char* packDir);
+//Make previews for every level of the packs in parallel. Unless force is set, only
+//previews that are missing or older than their level are made. Ret number made, -1 on error.
+int previewPacks(const char** packDirs, int numPacks, int force);
+//Headless entry point: wizznic -previews [-f] packs/000_wizznic packs/...
+int previewMain(int argc, char** argv);
+
+#endif // PREVIEW_H_INCLUDED
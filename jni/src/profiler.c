@@ -0,0 +1,422 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profiler.h"
+#include "text.h"
+#include "settings.h"
+#include "defs.h"
+#include "memtrack.h"
+
+struct profEvent_s {
+  Uint64 start;
+  Uint64 dur;
+  int zone; //PROF_NUM is the whole frame, PROF_NUM+1 input to present
+};
+typedef struct profEvent_s profEvent_t;
+
+static const char* zoneNames[PROF_NUM+2] = { "input", "sim", "rules", "draw", "particles", "text", "transition", "audio", "present", "frame", "input to present" };
+static const Uint8 zoneCols[PROF_NUM][3] = {
+  { 255, 255,   0 }, //input
+  {   0, 255,   0 }, //sim
+  {   0, 160,   0 }, //rules
+  {  64, 128, 255 }, //draw
+  { 255, 128,   0 }, //particles
+  { 255, 255, 255 }, //text
+  { 255,   0, 255 }, //transition
+  {   0, 255, 255 }, //audio
+  { 255,   0,   0 }  //present
+};
+
+static int profOn=0;
+static int inOverlay=0; //Don't measure the overlay itself
+static Uint64 perfFreq=1;
+static SDL_threadID profThread=0; //Zones are only measured on the thread running the frame loop
+
+//Zones currently open
+static int depth=0;
+static int stackZone[PROF_STACK];
+static Uint64 stackStart[PROF_STACK];
+static Uint64 stackChild[PROF_STACK]; //Time spent in nested zones
+
+static Uint64 frameBegin=0;
+static Uint64 zoneTime[PROF_NUM]; //This frame
+static Uint64 lastZoneTime[PROF_NUM]; //Last complete frame
+static Uint64 lastFrameTime=0;
+static Uint64 zoneSum[PROF_NUM]; //Over the report window
+
+static float history[PROF_HISTORY]; //Busy ms per frame
+static int historyPos=0, historyNum=0;
+static int reportFrames=0;
+
+//Overlay text, only changed every PROF_REPORT_FRAMES so the text cache keeps up
+static char zoneStr[PROF_NUM][32];
+static char pctStr[64];
+static int histBins[64]; //Half ms per bin
+static int histMax=1;
+
+//Input latency, from the SDL event timestamps
+static Uint32 inputStamp=0; //This frame, 0 for no input
+static Uint32 inputAgeSum=0, inputLatSum=0, inputLatMax=0; //Over the report window
+static int inputFrames=0;
+static char inputStr[64];
+
+#if defined(WANT_MEMTRACK)
+static char memStr[64];
+static Uint32 memAllocs=0, memBytes=0; //Totals at the last report
+#endif
+
+static profEvent_t* trace=NULL;
+static int traceHead=0, traceNum=0;
+
+void profInit(int enable)
+{
+  int i;
+  profOn=0;
+  depth=0;
+  profThread=SDL_ThreadID();
+  perfFreq=SDL_GetPerformanceFrequency();
+
+  memset(zoneTime, 0, sizeof(zoneTime));
+  memset(lastZoneTime, 0, sizeof(lastZoneTime));
+  memset(zoneSum, 0, sizeof(zoneSum));
+  memset(histBins, 0, sizeof(histBins));
+  historyPos=historyNum=reportFrames=0;
+  strcpy(pctStr, "");
+  inputStamp=inputAgeSum=inputLatSum=inputLatMax=0;
+  inputFrames=0;
+  strcpy(inputStr, "input -");
+  #if defined(WANT_MEMTRACK)
+  strcpy(memStr, "alloc -");
+  #endif
+  for(i=0; i < PROF_NUM; i++)
+  {
+    sprintf(zoneStr[i], "%s -", zoneNames[i]);
+  }
+
+  if( !enable )
+    return;
+
+  if( !trace )
+  {
+    trace = malloc( sizeof(profEvent_t)*PROF_TRACE_EVENTS );
+    if( !trace )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "profInit(); Out of memory, trace export disabled.");
+    }
+  }
+  traceHead=traceNum=0;
+
+  profOn=1;
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "profInit(); Profiler enabled.");
+}
+
+int profEnabled()
+{
+  return(profOn);
+}
+
+static void traceAdd(int zone, Uint64 start, Uint64 dur)
+{
+  if( !trace )
+    return;
+
+  trace[traceHead].zone=zone;
+  trace[traceHead].start=start;
+  trace[traceHead].dur=dur;
+  traceHead = (traceHead+1)%PROF_TRACE_EVENTS;
+  if( traceNum < PROF_TRACE_EVENTS )
+    traceNum++;
+}
+
+void profBegin(int zone)
+{
+  if( !profOn || inOverlay || SDL_ThreadID() != profThread )
+    return;
+
+  if( depth == PROF_STACK )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "profBegin(); Zones nested too deep, ignoring %s.", zoneNames[zone]);
+    return;
+  }
+
+  stackZone[depth]=zone;
+  stackChild[depth]=0;
+  stackStart[depth]=SDL_GetPerformanceCounter();
+  depth++;
+}
+
+void profEnd(int zone)
+{
+  Uint64 now, dur;
+
+  if( !profOn || inOverlay || depth == 0 || SDL_ThreadID() != profThread )
+    return;
+
+  now = SDL_GetPerformanceCounter();
+
+  if( stackZone[depth-1] != zone )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "profEnd(); Expected end of %s, got %s.", zoneNames[stackZone[depth-1]], zoneNames[zone]);
+    return;
+  }
+
+  depth--;
+  dur = now-stackStart[depth];
+  zoneTime[zone] += dur-stackChild[depth];
+  if( depth > 0 )
+    stackChild[depth-1] += dur;
+
+  traceAdd(zone, stackStart[depth], dur);
+}
+
+void profFrameBegin()
+{
+  if( !profOn )
+    return;
+
+  depth=0;
+  memset(zoneTime, 0, sizeof(zoneTime));
+  frameBegin=SDL_GetPerformanceCounter();
+  inputStamp=0;
+}
+
+void profInput(Uint32 stamp)
+{
+  if( !profOn || !stamp )
+    return;
+
+  inputStamp=stamp;
+  inputAgeSum += SDL_GetTicks()-stamp;
+}
+
+static void profReport()
+{
+  int i, bin, count;
+  float p[3]={0,0,0};
+  const float pct[3]={0.5f, 0.9f, 0.99f};
+  int pi=0;
+  #if defined(WANT_MEMTRACK)
+  memStats_t ms;
+  #endif
+
+  for(i=0; i < PROF_NUM; i++)
+  {
+    sprintf(zoneStr[i], "%s %.2f", zoneNames[i], (double)zoneSum[i]*1000.0/(double)perfFreq/reportFrames );
+    zoneSum[i]=0;
+  }
+
+  //Histogram of the last PROF_HISTORY frames, percentiles from the bins
+  memset(histBins, 0, sizeof(histBins));
+  for(i=0; i < historyNum; i++)
+  {
+    bin = (int)(history[i]*2.0f);
+    if( bin > 63 ) bin=63;
+    histBins[bin]++;
+  }
+
+  histMax=1;
+  count=0;
+  for(i=0; i < 64; i++)
+  {
+    if( histBins[i] > histMax )
+      histMax=histBins[i];
+    count+=histBins[i];
+    while( pi < 3 && count >= pct[pi]*historyNum )
+    {
+      p[pi]=(float)(i+1)/2.0f;
+      pi++;
+    }
+  }
+
+  sprintf(pctStr, "p50 %.1f p90 %.1f p99 %.1f", p[0], p[1], p[2]);
+  reportFrames=0;
+
+  if( inputFrames )
+  {
+    sprintf(inputStr, "input age %.1f present %.1f max %u", (double)inputAgeSum/inputFrames, (double)inputLatSum/inputFrames, inputLatMax);
+  } else {
+    strcpy(inputStr, "input -");
+  }
+  inputAgeSum=inputLatSum=inputLatMax=0;
+  inputFrames=0;
+
+  #if defined(WANT_MEMTRACK)
+  memGetStats(&ms);
+  sprintf(memStr, "alloc %.1f/f %.0fB/f peak %uk", (double)(ms.allocs-memAllocs)/PROF_REPORT_FRAMES, (double)(ms.bytes-memBytes)/PROF_REPORT_FRAMES, ms.peakBytes/1024);
+  memAllocs=ms.allocs;
+  memBytes=ms.bytes;
+  #endif
+}
+
+void profFrameEnd()
+{
+  int i;
+  Uint64 now, lat;
+
+  if( !profOn )
+    return;
+
+  now=SDL_GetPerformanceCounter();
+  lastFrameTime = now-frameBegin;
+  traceAdd(PROF_NUM, frameBegin, lastFrameTime);
+
+  //The frame is presented, so this is how long the oldest input took to show
+  if( inputStamp )
+  {
+    lat = SDL_GetTicks()-inputStamp;
+    inputLatSum += (Uint32)lat;
+    if( lat > inputLatMax )
+      inputLatMax = (Uint32)lat;
+    inputFrames++;
+
+    lat = (lat*perfFreq)/1000;
+    traceAdd(PROF_NUM+1, now-lat, lat);
+  }
+
+  for(i=0; i < PROF_NUM; i++)
+  {
+    lastZoneTime[i]=zoneTime[i];
+    zoneSum[i]+=zoneTime[i];
+  }
+
+  history[historyPos] = (float)((double)lastFrameTime*1000.0/(double)perfFreq);
+  historyPos = (historyPos+1)%PROF_HISTORY;
+  if( historyNum < PROF_HISTORY )
+    historyNum++;
+
+  reportFrames++;
+  if( reportFrames == PROF_REPORT_FRAMES )
+    profReport();
+}
+
+void profDraw(SDL_Surface* scr)
+{
+  SDL_Rect r;
+  Uint64 barCounts;
+  int i, x, w;
+  int ox=HSCREENW-160, oy=HSCREENH-120;
+  int lineH=getCharSize(FONTSMALL)[1];
+
+  if( !profOn )
+    return;
+
+  inOverlay=1;
+
+  //Stacked bar of the last frame, the full width is one frame at the target rate
+  barCounts = perfFreq/((setting()->frameRate > 0)?setting()->frameRate:50);
+  x=0;
+  r.y=oy+232;
+  r.h=6;
+  for(i=0; i < PROF_NUM; i++)
+  {
+    w = (int)( (lastZoneTime[i]*320)/barCounts );
+    if( x+w > 320 ) w=320-x;
+    if( w > 0 )
+    {
+      r.x=ox+x;
+      r.w=w;
+      SDL_FillRect(scr, &r, SDL_MapRGB(scr->format, zoneCols[i][0], zoneCols[i][1], zoneCols[i][2]) );
+      x+=w;
+    }
+  }
+  //Untracked time in grey
+  w = (int)( (lastFrameTime*320)/barCounts ) - x;
+  if( x+w > 320 ) w=320-x;
+  if( w > 0 )
+  {
+    r.x=ox+x;
+    r.w=w;
+    SDL_FillRect(scr, &r, SDL_MapRGB(scr->format, 96,96,96) );
+  }
+
+  //Frame time histogram, 64 half ms bins
+  r.w=2;
+  for(i=0; i < 64; i++)
+  {
+    r.h = (histBins[i]*30)/histMax;
+    if( r.h > 0 )
+    {
+      r.x=ox+190+i*2;
+      r.y=oy+40-r.h;
+      SDL_FillRect(scr, &r, SDL_MapRGB(scr->format, 255,255,255) );
+    }
+  }
+  txtWrite(scr, FONTSMALL, pctStr, ox+190, oy+42);
+
+  //Average ms per zone, coloured like the bar
+  for(i=0; i < PROF_NUM; i++)
+  {
+    r.x=ox+2;
+    r.y=oy+12+i*lineH;
+    r.w=4;
+    r.h=4;
+    SDL_FillRect(scr, &r, SDL_MapRGB(scr->format, zoneCols[i][0], zoneCols[i][1], zoneCols[i][2]) );
+    txtWrite(scr, FONTSMALL, zoneStr[i], ox+8, oy+10+i*lineH);
+  }
+  txtWrite(scr, FONTSMALL, inputStr, ox+8, oy+10+PROF_NUM*lineH);
+  #if defined(WANT_MEMTRACK)
+  txtWrite(scr, FONTSMALL, memStr, ox+8, oy+10+(PROF_NUM+1)*lineH);
+  #endif
+
+  inOverlay=0;
+}
+
+int profTraceWrite(const char* fileName)
+{
+  FILE* f;
+  int i, idx;
+  Uint64 base;
+
+  if( !trace || traceNum == 0 )
+    return(0);
+
+  f = fopen(fileName, "w");
+  if( !f )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "profTraceWrite(); Couldn't open '%s' for writing.", fileName);
+    return(0);
+  }
+
+  //Oldest event first
+  idx = (traceNum < PROF_TRACE_EVENTS)?0:traceHead;
+  base = trace[idx].start;
+
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for(i=0; i < traceNum; i++)
+  {
+    profEvent_t* e = &trace[(idx+i)%PROF_TRACE_EVENTS];
+    if( e->start < base )
+      base = e->start;
+  }
+  for(i=0; i < traceNum; i++)
+  {
+    profEvent_t* e = &trace[(idx+i)%PROF_TRACE_EVENTS];
+    fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"wizznic\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}\n",
+            (i)?",":"", zoneNames[e->zone],
+            (double)(e->start-base)*1000000.0/(double)perfFreq,
+            (double)e->dur*1000000.0/(double)perfFreq );
+  }
+  fprintf(f, "]}\n");
+  fclose(f);
+
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "profTraceWrite(); Wrote %i events to '%s'.", traceNum, fileName);
+  return(1);
+}
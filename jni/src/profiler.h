@@ -0,0 +1,71 @@
+#ifndef PROFILER_H_INCLUDED
+#define PROFILER_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <SDL.h>
+
+//Profiler zones, time spent in nested zones is not counted in the outer zone
+#define PROF_INPUT 0
+#define PROF_SIM 1
+#define PROF_RULES 2
+#define PROF_DRAW 3
+#define PROF_PARTICLES 4
+#define PROF_TEXT 5
+#define PROF_TRANSITION 6
+#define PROF_AUDIO 7
+#define PROF_PRESENT 8
+#define PROF_NUM 9
+
+//Frames in the histogram/percentiles
+#ifndef PROF_HISTORY
+  #define PROF_HISTORY 256
+#endif
+
+//Frames between updates of the overlay numbers
+#ifndef PROF_REPORT_FRAMES
+  #define PROF_REPORT_FRAMES 50
+#endif
+
+//Events kept for the trace export, the oldest are overwritten
+#ifndef PROF_TRACE_EVENTS
+  #define PROF_TRACE_EVENTS 65536
+#endif
+
+#define PROF_STACK 16
+
+void profInit(int enable);
+int profEnabled();
+
+void profBegin(int zone);
+void profEnd(int zone);
+
+void profFrameBegin();
+void profFrameEnd();
+
+//Input handled this frame, stamp is the SDL timestamp of its oldest event, 0 for none.
+//Its age here and when profFrameEnd() is called after presenting are recorded, in ms.
+void profInput(Uint32 stamp);
+
+//Stacked bar of the last frame, frame time histogram and percentiles
+void profDraw(SDL_Surface* scr);
+
+//Write the recorded events as Chrome trace-event JSON (chrome://tracing), returns 1 on success.
+int profTraceWrite(const char* fileName);
+
+#endif // PROFILER_H_INCLUDED
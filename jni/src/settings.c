@@ -76,6 +76,10 @@ void loadSettings()
   settings.showFps=0;
   settings.arcadeMode=0;
   settings.particles=1;
+  settings.frameRate=FRAMESCHED_DEFAULT_RATE;
+  settings.vsync=0;
+  settings.lateInput=0;
+  settings.profiler=0;
   settings.userMusic=0;
   settings.disableMusic=0;
   settings.wizVol=52;
@@ -155,6 +159,22 @@ void loadSettings()
         {
           settings.particles = atoi(val);
         } else
+        if( strcmp("framerate", set)==0 )
+        {
+          settings.frameRate = atoi(val);
+        } else
+        if( strcmp("vsync", set)==0 )
+        {
+          settings.vsync = atoi(val);
+        } else
+        if( strcmp("lateinput", set)==0 )
+        {
+          settings.lateInput = atoi(val);
+        } else
+        if( strcmp("profiler", set)==0 )
+        {
+          settings.profiler = atoi(val);
+        } else
         if( strcmp("packdir", set)==0 )
         {
           free(settings.packDir);
@@ -252,6 +272,10 @@ void saveSettings()
                "# For the GP2X Wiz handheld: System-volume.\nwizvolume=%i\n\n"
                "# Show the FPS counter? 0 = No,  1 = Yes.\nshowfps=%i\n\n"
                "# Use particle effects? 0 = No,  1 = Yes.\nparticles=%i\n\n"
+               "# Target frames per second (0 = as fast as possible).\n# Bricks move a fixed distance per frame, so the game is tuned for %i.\nframerate=%i\n\n"
+               "# Wait for the display refresh when drawing. 0 = No, 1 = Yes.\nvsync=%i\n\n"
+               "# With vsync, read input as late as possible before each frame so touch drags show sooner. 0 = No, 1 = Yes.\nlateinput=%i\n\n"
+               "# Show where frame time goes and write trace.json (chrome://tracing) to the config dir on exit. 0 = No, 1 = Yes.\nprofiler=%i\n\n"
                "# 0 = Normal mode, progress through levels.\n# 1 = Arcade mode: Start on first level at game-over.\narcademode=%i\n\n"
                "# The currently selected content pack.\npackdir=%s\n\n"
                "# Name of the player.\nplayername=%s\n\n"
@@ -271,6 +295,11 @@ void saveSettings()
                settings.wizVol,
                settings.showFps,
                settings.particles,
+               FRAMESCHED_DEFAULT_RATE,
+               settings.frameRate,
+               settings.vsync,
+               settings.lateInput,
+               settings.profiler,
                settings.arcadeMode,
                settings.packDir,
                settings.playerName,
@@ -31,6 +31,10 @@ struct settings_s {
   int wizClock;//
   int arcadeMode;
   int particles;
+  int frameRate; //Target frames per second
+  int vsync; //Wait for vsync when presenting
+  int lateInput; //With vsync, wait before reading input instead of after drawing
+  int profiler; //Show the profiler overlay and write trace.json on exit
 
   int bpp; //bit per pixel that the "screen" runs
   int glHeight, glWidth, glEnable,glFilter;
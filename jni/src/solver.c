@@ -0,0 +1,699 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "solver.h"
+#include "defs.h"
+#include "levelindex.h"
+
+#define SOLVER_ALIVE 0
+#define SOLVER_DEAD 1
+#define SOLVER_WON 2
+
+//What is searched, a copy of the board in the editor
+typedef struct {
+  uint8_t cells[FIELDSIZE][FIELDSIZE]; //Type of brick or tile, 0 for empty
+  int8_t tele[SOLVER_MAX_TELE][4]; //sx,sy,dx,dy
+  int numTele;
+  int unsupported; //Something the search can't model
+} solverLevel_t;
+
+typedef struct {
+  uint8_t fixed[FIELDSIZE][FIELDSIZE]; //Tiles, they never move
+  uint8_t open[FIELDSIZE*FIELDSIZE][2]; //Cells without a tile, only these go in a state
+  int numOpen;
+  int stateBytes; //Two cells per byte
+  const solverLevel_t* lvl;
+
+  //States in the order they were found, so the states of each depth follow each other.
+  uint8_t* states;
+  int numStates;
+  uint32_t* table; //Index+1 of each state, by hash
+  int tableSize;
+  uint8_t* depth; //Fewest moves to each state, depth first only
+} solverSearch_t;
+
+//A board on the depth first path, with its moves sorted by bricks left after them
+typedef struct {
+  uint8_t c[FIELDSIZE][FIELDSIZE];
+  uint8_t move[FIELDSIZE*FIELDSIZE*2][3]; //x,y,dir+1
+  uint16_t score[FIELDSIZE*FIELDSIZE*2]; //Lower is more promising
+  int numMoves;
+  int next;
+} solverFrame_t;
+
+static SDL_Thread* thread=NULL;
+static SDL_sem* wake=NULL;
+static SDL_atomic_t quit;
+static SDL_atomic_t gen; //The newest level, searches for older ones stop
+
+//Given by the main thread
+static SDL_SpinLock jobLock=0;
+static solverLevel_t pending;
+
+//Given by the search
+static SDL_SpinLock resLock=0;
+static solverResult_t result;
+
+//Main thread
+static solverLevel_t last;
+static int haveLast=0;
+
+#define SOLVER_FREE(s,c,x,y) ( !(s)->fixed[x][y] && !(c)[x][y] )
+
+static void solverPublish(int g, int state, int moves, int best)
+{
+  SDL_AtomicLock( &resLock );
+  if( g == SDL_AtomicGet(&gen) )
+  {
+    result.state=state;
+    result.moves=moves;
+    result.best=best;
+  }
+  SDL_AtomicUnlock( &resLock );
+}
+
+static int solverStale(int g)
+{
+  return( g != SDL_AtomicGet(&gen) || SDL_AtomicGet(&quit) );
+}
+
+static void solverMoveBrick(uint8_t c[FIELDSIZE][FIELDSIZE], int x, int y, int dx, int dy)
+{
+  c[dx][dy]=c[x][y];
+  c[x][y]=0;
+}
+
+//Let the board come to rest after a move, like simField() and doRules() would.
+//Bricks fall all the way before anything is matched, timing between bricks is not modelled.
+static int solverSettle(solverSearch_t* s, uint8_t c[FIELDSIZE][FIELDSIZE])
+{
+  int x,y,n,i,moved,removed,total;
+  uint8_t mark[FIELDSIZE][FIELDSIZE];
+  int count[BRICKSEND+1];
+  const solverLevel_t* lvl = s->lvl;
+
+  do
+  {
+    do
+    {
+      moved=0;
+
+      //Falling, from the bottom so stacks fall together
+      for(y=FIELDSIZE-2; y > -1; y--)
+      {
+        for(x=0; x < FIELDSIZE; x++)
+        {
+          if( c[x][y] && SOLVER_FREE(s,c,x,y+1) )
+          {
+            for(n=y+1; n+1 < FIELDSIZE && SOLVER_FREE(s,c,x,n+1); n++);
+            solverMoveBrick(c, x, y, x, n);
+            moved=1;
+          }
+        }
+      }
+
+      for(i=0; i < lvl->numTele; i++)
+      {
+        const int8_t* t = lvl->tele[i];
+        if( c[t[0]][t[1]] && SOLVER_FREE(s,c,t[2],t[3]) )
+        {
+          solverMoveBrick(c, t[0], t[1], t[2], t[3]);
+          moved=1;
+        }
+      }
+
+      //Tiles that do something to the brick resting on them
+      for(y=0; y < FIELDSIZE-1; y++)
+      {
+        for(x=0; x < FIELDSIZE; x++)
+        {
+          if( !c[x][y] )
+            continue;
+
+          switch( s->fixed[x][y+1] )
+          {
+            case ONEWAYLEFT:
+              if( x > 0 && SOLVER_FREE(s,c,x-1,y) )
+              {
+                solverMoveBrick(c, x, y, x-1, y);
+                moved=1;
+              }
+            break;
+            case ONEWAYRIGHT:
+              if( x+1 < FIELDSIZE && SOLVER_FREE(s,c,x+1,y) )
+              {
+                solverMoveBrick(c, x, y, x+1, y);
+                moved=1;
+              }
+            break;
+            case REMBRICK:
+              c[x][y]=0;
+              moved=1;
+            break;
+            case EVILBRICK:
+              return(SOLVER_DEAD);
+          }
+        }
+      }
+    } while(moved);
+
+    //Every brick touching one of its kind goes at once
+    removed=0;
+    memset( mark, 0, sizeof(mark) );
+    for(x=0; x < FIELDSIZE; x++)
+    {
+      for(y=0; y < FIELDSIZE; y++)
+      {
+        n=c[x][y];
+        if( n && ( (y > 0 && c[x][y-1]==n) || (y+1 < FIELDSIZE && c[x][y+1]==n) ||
+                   (x > 0 && c[x-1][y]==n) || (x+1 < FIELDSIZE && c[x+1][y]==n) ) )
+        {
+          mark[x][y]=1;
+          removed=1;
+        }
+      }
+    }
+    for(x=0; x < FIELDSIZE; x++)
+    {
+      for(y=0; y < FIELDSIZE; y++)
+      {
+        if( mark[x][y] )
+          c[x][y]=0;
+      }
+    }
+  } while(removed);
+
+  //A lone brick of a kind can't go, see doRules()
+  memset( count, 0, sizeof(count) );
+  total=0;
+  for(x=0; x < FIELDSIZE; x++)
+  {
+    for(y=0; y < FIELDSIZE; y++)
+    {
+      if( c[x][y] )
+      {
+        count[c[x][y]]++;
+        total++;
+      }
+    }
+  }
+  for(i=BRICKSBEGIN; i <= BRICKSEND; i++)
+  {
+    if( count[i]==1 )
+      return(SOLVER_DEAD);
+  }
+
+  return( (total)?SOLVER_ALIVE:SOLVER_WON );
+}
+
+static void solverPack(solverSearch_t* s, uint8_t c[FIELDSIZE][FIELDSIZE], uint8_t* p)
+{
+  int i;
+  memset( p, 0, s->stateBytes );
+  for(i=0; i < s->numOpen; i++)
+  {
+    p[i/2] |= c[s->open[i][0]][s->open[i][1]] << ((i&1)*4);
+  }
+}
+
+static void solverUnpack(solverSearch_t* s, const uint8_t* p, uint8_t c[FIELDSIZE][FIELDSIZE])
+{
+  int i;
+  memset( c, 0, FIELDSIZE*FIELDSIZE );
+  for(i=0; i < s->numOpen; i++)
+  {
+    c[s->open[i][0]][s->open[i][1]] = (p[i/2] >> ((i&1)*4)) & 0xf;
+  }
+}
+
+//Add the state if it's new, ret 1 if it was added, 0 if it was known, -1 if there's no room.
+//idx is set to the index of the state unless there was no room.
+static int solverAdd(solverSearch_t* s, const uint8_t* p, int* idx)
+{
+  uint32_t h=levelIndexHashMem(p, s->stateBytes);
+  uint32_t n;
+
+  for( n=h&(s->tableSize-1); s->table[n]; n=(n+1)&(s->tableSize-1) )
+  {
+    if( memcmp( s->states+(s->table[n]-1)*s->stateBytes, p, s->stateBytes )==0 )
+    {
+      *idx=s->table[n]-1;
+      return(0);
+    }
+  }
+
+  if( s->numStates == SOLVER_MAX_STATES )
+    return(-1);
+
+  memcpy( s->states+s->numStates*s->stateBytes, p, s->stateBytes );
+  *idx=s->numStates;
+  s->numStates++;
+  s->table[n]=s->numStates;
+  return(1);
+}
+
+//Cursor moves of the brick at x,y, see moveBrick() and curMoveBrick()
+static int solverCanMove(solverSearch_t* s, uint8_t c[FIELDSIZE][FIELDSIZE], int x, int y, int dir)
+{
+  if( x+dir < 0 || x+dir == FIELDSIZE || !SOLVER_FREE(s,c,x+dir,y) )
+    return(0);
+
+  if( y+1 < FIELDSIZE )
+  {
+    if( s->fixed[x][y+1]==GLUE )
+      return(0);
+    if( s->fixed[x][y+1]==ONEWAYLEFT && dir==DIRRIGHT )
+      return(0);
+    if( s->fixed[x][y+1]==ONEWAYRIGHT && dir==DIRLEFT )
+      return(0);
+  }
+  return(1);
+}
+
+//How far a board looks from done: the bricks left, then how far each is from its nearest kin.
+static int solverScore(solverSearch_t* s, uint8_t c[FIELDSIZE][FIELDSIZE])
+{
+  int i,j,d,near,left=0,dist=0;
+
+  for(i=0; i < s->numOpen; i++)
+  {
+    uint8_t b = c[s->open[i][0]][s->open[i][1]];
+    if( !b )
+      continue;
+
+    left++;
+    near=FIELDSIZE*2;
+    for(j=0; j < s->numOpen; j++)
+    {
+      if( j != i && c[s->open[j][0]][s->open[j][1]]==b )
+      {
+        d = abs(s->open[i][0]-s->open[j][0]) + abs(s->open[i][1]-s->open[j][1]);
+        if( d < near )
+          near=d;
+      }
+    }
+    dist+=near;
+  }
+  return( left*256 + ((dist<256)?dist:255) );
+}
+
+//Fill in the moves of f, sorted so the most promising come first.
+//Ret 1 if one of them wins.
+static int solverExpand(solverSearch_t* s, solverFrame_t* f)
+{
+  uint8_t n[FIELDSIZE][FIELDSIZE];
+  int x,y,dir,j,score,ret;
+
+  f->numMoves=0;
+  f->next=0;
+  for(x=0; x < FIELDSIZE; x++)
+  {
+    for(y=0; y < FIELDSIZE; y++)
+    {
+      if( !f->c[x][y] )
+        continue;
+
+      for(dir=DIRLEFT; dir <= DIRRIGHT; dir+=2)
+      {
+        if( !solverCanMove( s, f->c, x, y, dir ) )
+          continue;
+
+        memcpy( n, f->c, sizeof(n) );
+        solverMoveBrick( n, x, y, x+dir, y );
+        ret = solverSettle( s, n );
+        if( ret == SOLVER_WON )
+          return(1);
+        if( ret == SOLVER_DEAD )
+          continue;
+
+        score = solverScore( s, n );
+        for(j=f->numMoves; j > 0 && f->score[j-1] > score; j--)
+        {
+          memcpy( f->move[j], f->move[j-1], 3 );
+          f->score[j]=f->score[j-1];
+        }
+        f->move[j][0]=x;
+        f->move[j][1]=y;
+        f->move[j][2]=dir+1;
+        f->score[j]=score;
+        f->numMoves++;
+      }
+    }
+  }
+  return(0);
+}
+
+//Depth first from the start board, for when breadth first ran out of room.
+//No solution is shorter than lower+1 moves. Ret the fewest moves found, 0 for none.
+static int solverDeep(solverSearch_t* s, uint8_t start[FIELDSIZE][FIELDSIZE], uint8_t* p, int lower, int g, int* cut, int* stale)
+{
+  solverFrame_t* stack;
+  solverFrame_t* f;
+  int sp=0,best=0,bound=SOLVER_MAX_MOVES,idx,visits=0;
+
+  stack = malloc( sizeof(solverFrame_t)*SOLVER_MAX_MOVES );
+  if( !stack )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "solver: Not enough memory for %i moves.\n", SOLVER_MAX_MOVES);
+    *cut=1;
+    return(0);
+  }
+
+  //The states are now a cache of how soon each board was reached, a board reached again
+  //in as many moves or more has nothing new below it.
+  s->numStates=0;
+  memset( s->table, 0, s->tableSize*sizeof(uint32_t) );
+
+  memcpy( stack[0].c, start, sizeof(stack[0].c) );
+  if( solverExpand( s, &stack[0] ) )
+  {
+    free( stack );
+    return(1);
+  }
+
+  while( sp > -1 )
+  {
+    if( (++visits&63)==0 && solverStale(g) )
+    {
+      *stale=1;
+      break;
+    }
+
+    //The children of the board at depth sp end up with sp+2 moves at best
+    f = &stack[sp];
+    if( f->next == f->numMoves || sp+2 >= bound )
+    {
+      if( f->next < f->numMoves && !best )
+        *cut=1;
+      sp--;
+      continue;
+    }
+
+    memcpy( stack[sp+1].c, f->c, sizeof(f->c) );
+    solverMoveBrick( stack[sp+1].c, f->move[f->next][0], f->move[f->next][1], f->move[f->next][0]+f->move[f->next][2]-1, f->move[f->next][1] );
+    f->next++;
+    f = &stack[sp+1];
+    solverSettle( s, f->c );
+
+    solverPack( s, f->c, p );
+    switch( solverAdd( s, p, &idx ) )
+    {
+      case 0:
+        if( s->depth[idx] <= sp+1 )
+          continue;
+        //Fall through, it's reached sooner now
+      case 1:
+        s->depth[idx]=sp+1;
+      break;
+    }
+
+    sp++;
+    if( solverExpand( s, f ) )
+    {
+      best=sp+1;
+      bound=best;
+      solverPublish( g, SOLVER_RUNNING, lower, best );
+      if( best == lower+1 )
+        break;
+      sp--;
+    }
+  }
+
+  free( stack );
+  return(best);
+}
+
+static void solverSearch(const solverLevel_t* lvl, int g)
+{
+  solverSearch_t s;
+  uint8_t c[FIELDSIZE][FIELDSIZE];
+  uint8_t n[FIELDSIZE][FIELDSIZE];
+  uint8_t start[FIELDSIZE][FIELDSIZE];
+  uint8_t* p;
+  int x,y,dir,i,idx,ret,depth=0,depthEnd,full=0,best,cut=0,stale=0;
+
+  if( lvl->unsupported )
+  {
+    solverPublish( g, SOLVER_UNKNOWN, 0, 0 );
+    return;
+  }
+
+  memset( &s, 0, sizeof(s) );
+  s.lvl=lvl;
+  for(x=0; x < FIELDSIZE; x++)
+  {
+    for(y=0; y < FIELDSIZE; y++)
+    {
+      if( lvl->cells[x][y] >= BRICKSBEGIN && lvl->cells[x][y] <= BRICKSEND )
+      {
+        c[x][y]=lvl->cells[x][y];
+      } else {
+        c[x][y]=0;
+        s.fixed[x][y]=lvl->cells[x][y];
+      }
+      if( !s.fixed[x][y] )
+      {
+        s.open[s.numOpen][0]=x;
+        s.open[s.numOpen][1]=y;
+        s.numOpen++;
+      }
+    }
+  }
+
+  ret = solverSettle( &s, c );
+  if( ret != SOLVER_ALIVE )
+  {
+    solverPublish( g, (ret==SOLVER_WON)?SOLVER_SOLVABLE:SOLVER_UNSOLVABLE, 0, 0 );
+    return;
+  }
+  memcpy( start, c, sizeof(start) );
+
+  s.stateBytes = (s.numOpen+1)/2;
+  for(s.tableSize=1; s.tableSize < SOLVER_MAX_STATES*2; s.tableSize*=2);
+  s.states = malloc( SOLVER_MAX_STATES*s.stateBytes );
+  s.table = calloc( s.tableSize, sizeof(uint32_t) );
+  s.depth = malloc( SOLVER_MAX_STATES );
+  p = malloc( s.stateBytes );
+  if( !s.states || !s.table || !s.depth || !p )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "solver: Not enough memory for %i states.\n", SOLVER_MAX_STATES);
+    solverPublish( g, SOLVER_UNKNOWN, 0, 0 );
+    goto done;
+  }
+
+  solverPack( &s, c, p );
+  solverAdd( &s, p, &idx );
+
+  //i walks through the states found at this depth, while the next depth is added after them.
+  //Once a depth didn't fit, the next one would be missing boards, so it's left to solverDeep.
+  i=0;
+  while( i < s.numStates && !full )
+  {
+    solverPublish( g, SOLVER_RUNNING, depth, 0 );
+    depthEnd=s.numStates;
+    depth++;
+
+    for(; i < depthEnd; i++)
+    {
+      if( (i&63)==0 && solverStale(g) )
+        goto done;
+
+      solverUnpack( &s, s.states+i*s.stateBytes, c );
+      for(x=0; x < FIELDSIZE; x++)
+      {
+        for(y=0; y < FIELDSIZE; y++)
+        {
+          if( !c[x][y] )
+            continue;
+
+          for(dir=DIRLEFT; dir <= DIRRIGHT; dir+=2)
+          {
+            if( !solverCanMove( &s, c, x, y, dir ) )
+              continue;
+
+            memcpy( n, c, sizeof(n) );
+            solverMoveBrick( n, x, y, x+dir, y );
+            ret = solverSettle( &s, n );
+            if( ret == SOLVER_WON )
+            {
+              solverPublish( g, SOLVER_SOLVABLE, depth, depth );
+              goto done;
+            }
+            if( ret == SOLVER_ALIVE )
+            {
+              solverPack( &s, n, p );
+              if( solverAdd( &s, p, &idx ) < 0 )
+                full=1;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if( !full )
+  {
+    solverPublish( g, SOLVER_UNSOLVABLE, depth, 0 );
+    goto done;
+  }
+
+  solverPublish( g, SOLVER_RUNNING, depth, 0 );
+  best = solverDeep( &s, start, p, depth, g, &cut, &stale );
+  if( !stale )
+  {
+    if( best )
+      solverPublish( g, SOLVER_SOLVABLE, best, best );
+    else
+      solverPublish( g, (cut)?SOLVER_UNKNOWN:SOLVER_UNSOLVABLE, depth, 0 );
+  }
+
+done:
+  free( s.states );
+  free( s.table );
+  free( s.depth );
+  free( p );
+}
+
+static int solverThread(void* data)
+{
+  solverLevel_t lvl;
+  int g, done=0;
+
+  while( !SDL_AtomicGet(&quit) )
+  {
+    SDL_SemWait( wake );
+
+    //Only the newest level is searched, several edits may have come in.
+    SDL_AtomicLock( &jobLock );
+    lvl = pending;
+    g = SDL_AtomicGet(&gen);
+    SDL_AtomicUnlock( &jobLock );
+
+    if( g != done && !SDL_AtomicGet(&quit) )
+    {
+      solverSearch( &lvl, g );
+      done=g;
+    }
+  }
+  return(0);
+}
+
+void solverCheckField(playField* pf)
+{
+  solverLevel_t lvl;
+  listItem* it;
+  int x,y,g;
+
+  memset( &lvl, 0, sizeof(lvl) );
+  for(x=0; x < FIELDSIZE; x++)
+  {
+    for(y=0; y < FIELDSIZE; y++)
+    {
+      if( pf->board[x][y] )
+      {
+        lvl.cells[x][y] = pf->board[x][y]->type;
+        switch( lvl.cells[x][y] )
+        {
+          case MOVERVERT:
+          case MOVERHORIZ:
+          case SWON:
+          case SWOFF:
+          case COPYBRICK:
+          case SWAPBRICK:
+          case RESERVED:
+            lvl.unsupported=1;
+          break;
+        }
+      }
+    }
+  }
+
+  it = &pf->levelInfo->teleList->begin;
+  while( LISTFWD(pf->levelInfo->teleList, it) )
+  {
+    telePort_t* tp = (telePort_t*)it->data;
+    if( lvl.numTele == SOLVER_MAX_TELE )
+    {
+      lvl.unsupported=1;
+      break;
+    }
+    lvl.tele[lvl.numTele][0]=tp->sx;
+    lvl.tele[lvl.numTele][1]=tp->sy;
+    lvl.tele[lvl.numTele][2]=tp->dx;
+    lvl.tele[lvl.numTele][3]=tp->dy;
+    lvl.numTele++;
+  }
+
+  if( haveLast && memcmp( &lvl, &last, sizeof(lvl) )==0 )
+  {
+    return;
+  }
+  last=lvl;
+  haveLast=1;
+
+  if( !thread )
+  {
+    SDL_AtomicSet( &quit, 0 );
+    wake = SDL_CreateSemaphore( 0 );
+    thread = SDL_CreateThread( solverThread, "solver", NULL );
+    if( !thread )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "solver: Couldn't start thread: %s\n", SDL_GetError());
+      SDL_DestroySemaphore( wake );
+      wake=NULL;
+      result.state=SOLVER_UNKNOWN;
+      result.moves=0;
+      result.best=0;
+      return;
+    }
+  }
+
+  SDL_AtomicLock( &jobLock );
+  pending=lvl;
+  g = SDL_AtomicAdd( &gen, 1 )+1;
+  SDL_AtomicUnlock( &jobLock );
+
+  solverPublish( g, SOLVER_RUNNING, 0, 0 );
+  SDL_SemPost( wake );
+}
+
+void solverGetResult(solverResult_t* r)
+{
+  SDL_AtomicLock( &resLock );
+  *r = result;
+  SDL_AtomicUnlock( &resLock );
+}
+
+void solverQuit()
+{
+  if( thread )
+  {
+    SDL_AtomicSet( &quit, 1 );
+    SDL_SemPost( wake );
+    SDL_WaitThread( thread, NULL );
+    SDL_DestroySemaphore( wake );
+    thread=NULL;
+    wake=NULL;
+  }
+  haveLast=0;
+  result.state=SOLVER_IDLE;
+  result.moves=0;
+  result.best=0;
+}
@@ -0,0 +1,57 @@
+#ifndef SOLVER_H_INCLUDED
+#define SOLVER_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include "board.h"
+
+//Solvability of the level in the editor. The board is searched breadth first on a
+//thread, so the first solution found uses the fewest moves. When the boards don't fit
+//in SOLVER_MAX_STATES, it goes on depth first, trying the moves that leave the fewest
+//bricks first, and keeps the shortest solution found until nothing shorter is left.
+//Only the rules that don't depend on timing are modelled: levels with movers, switches,
+//copy or swap bricks are reported as unknown.
+
+#define SOLVER_IDLE 0
+#define SOLVER_RUNNING 1 //No solution has fewer than moves+1 moves, best may have one
+#define SOLVER_SOLVABLE 2 //In moves moves
+#define SOLVER_UNSOLVABLE 3
+#define SOLVER_UNKNOWN 4 //Out of memory, or the level has bricks that aren't modelled
+
+//Distinct boards remembered by a search, each takes about FIELDSIZE*FIELDSIZE/2 bytes.
+#ifndef SOLVER_MAX_STATES
+  #define SOLVER_MAX_STATES 65536
+#endif
+#ifndef SOLVER_MAX_MOVES
+  #define SOLVER_MAX_MOVES 200 //Depth first search gives up on longer solutions
+#endif
+#ifndef SOLVER_MAX_TELE
+  #define SOLVER_MAX_TELE 32
+#endif
+
+typedef struct {
+  int state; //SOLVER_*
+  int moves;
+  int best; //Fewest moves of a solution found so far, 0 for none
+} solverResult_t;
+
+void solverCheckField(playField* pf); //Starts a new search if the board changed since last call, stopping the old one
+void solverGetResult(solverResult_t* r); //Result for the board given last
+void solverQuit(); //Stops the search and the thread
+
+#endif // SOLVER_H_INCLUDED
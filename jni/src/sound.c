@@ -25,6 +25,7 @@
 #include "text.h"
 #include "mbrowse.h"
 #include "menu.h"
+#include "archive.h"
 
 #include "defs.h"
 
@@ -61,7 +62,7 @@ int initSound()
   memset(loadedSamples, 0, sizeof(char*)*NUMSAMPLES);
   memset(lastPlayed, 0, sizeof(int)*NUMSAMPLES);
 
-  loadMenuSamples();
+  //The menu samples are decoded by a startup job of their own, see loadMenuSamples()
 
   lastLoadedSongFn[0]=0;
 
@@ -91,8 +92,9 @@ int loadSample(const char* fileName, int index)
     if(samples[index])
       Mix_FreeChunk(samples[index]);
 
-    //Load sample
-    samples[index] = Mix_LoadWAV(fileName);
+    //Load sample, straight from the mapping if it's in a pack archive
+    SDL_RWops* rw = archiveRW(fileName);
+    samples[index] = (rw)?Mix_LoadWAV_RW(rw, 1):Mix_LoadWAV(fileName);
     if(!samples[index])
     {
       SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "loadSample(); Warning: Couldn't load %s\n",fileName);
@@ -140,7 +142,8 @@ void loadSamples(const char* sndDir, const char* musicFile)
       Mix_FreeMusic(mus[1]);
     }
     strcpy(lastLoadedSongFn, packGetFile(NULL,musicFile));
-    mus[1]=Mix_LoadMUS( lastLoadedSongFn );
+    SDL_RWops* rw = archiveRW( lastLoadedSongFn );
+    mus[1]=(rw)?Mix_LoadMUS_RW( rw, 1 ):Mix_LoadMUS( lastLoadedSongFn );
     if(!mus[1])
       SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't load music: '%s'\n",packGetFile(NULL,musicFile));
 
@@ -201,6 +204,7 @@ static int lastState = STATEMENU;
 static int fadeOut=0;
 static int userSong=0;
 static int numUserSongs=0;
+static int userMusicWait=0; //Waiting for the music directory to be scanned
 #define SHOW_SONG_TIME 1500
 static int showSNCD=0;
 #define CMSTATE_MENU 1
@@ -226,6 +230,14 @@ void soundRun(SDL_Surface* screen,int state)
   //Rest of code controls music, we return now if music is not playing.
   if( !setting()->musicVol || setting()->disableMusic ) return;
 
+  //Start the first song when the music directory has been scanned.
+  if(setting()->userMusic && userMusicWait && fileListReady())
+  {
+    userMusicWait=0;
+    userSong=0;
+    soundPlayUserSongNum(0,0); //Sets number of tracks too.
+  }
+
   if(setting()->userMusic && numUserSongs)
   {
     //Check if we should change track because the track stopped
@@ -320,51 +332,108 @@ void soundRun(SDL_Surface* screen,int state)
 
 }
 
-void soundPlayUserSongNum(int num, char* songName)
+//The next user song is loaded on a thread of its own while this one plays,
+//so changing track doesn't stall a frame on decoder setup.
+static SDL_Thread* preThread=NULL;
+static Mix_Music* preMus=NULL;
+static int preNum=-1;
+static char preFile[2048];
+
+static int soundPreloadThread(void* data)
 {
-  if(!setting()->musicVol) return;
-  listItem* it=&fileList()->begin;
-  fileListItem_t* file;
-  int i=0;
-  while( LISTFWD(fileList(),it) )
+  preMus=Mix_LoadMUS( preFile );
+  return(0);
+}
+
+//Returns the preloaded music if it is song num, anything else preloaded is freed.
+static Mix_Music* soundPreloadTake(int num, const char* fileName)
+{
+  Mix_Music* m=NULL;
+
+  if(preThread)
+  {
+    SDL_WaitThread(preThread, NULL);
+    preThread=NULL;
+  }
+
+  if(preMus)
   {
-    file=(fileListItem_t*)it->data;
-    if(!file->dir)
+    if( preNum==num && strcmp(preFile, fileName)==0 )
     {
-      if(i==num)
-      {
-        //Unload current song.
-        Mix_HaltMusic();
-        if(mus[1])
-        {
-          Mix_FreeMusic(mus[1]);
-          mus[1]=0;
-        }
-        //Load new song
-        mus[1]=Mix_LoadMUS( file->fullName );
-        if(!mus[1])
-        {
-          SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't load music: '%s'\n",file->fullName);
-        }
-        else
-        {
-          SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Now Playing: '%s'\n",file->fullName);
-          if(songName)
-          {
-            showSNCD=SHOW_SONG_TIME;
-            strcpy(songName,file->name);
-          }
-        }
+      m=preMus;
+    } else {
+      Mix_FreeMusic(preMus);
+    }
+    preMus=NULL;
+  }
+  preNum=-1;
 
-        Mix_FadeInMusicPos(mus[1], 0, MUSIC_FADETIME,mPos[1]);
+  return(m);
+}
 
+static void soundPreload(int num)
+{
+  fileListItem_t* file=fileListSong(num);
 
-        //return; We don't return, instead we let it run, to count number of usertracks.
-      }
-      i++;
+  soundPreloadTake(-1, "");
+  if(!file || strlen(file->fullName) >= sizeof(preFile))
+  {
+    return;
+  }
+
+  preNum=num;
+  strcpy(preFile, file->fullName);
+  preThread=SDL_CreateThread(soundPreloadThread, "soundPreload", NULL);
+  if(!preThread)
+  {
+    preNum=-1;
+  }
+}
+
+void soundPlayUserSongNum(int num, char* songName)
+{
+  fileListItem_t* file;
+
+  if(!setting()->musicVol) return;
+
+  numUserSongs=fileListNumSongs();
+  file=fileListSong(num);
+  if(!file) return;
+
+  //Unload current song.
+  Mix_HaltMusic();
+  if(mus[1])
+  {
+    Mix_FreeMusic(mus[1]);
+    mus[1]=0;
+  }
+  //Load new song, it's usually loaded already
+  mus[1]=soundPreloadTake(num, file->fullName);
+  if(!mus[1])
+  {
+    mus[1]=Mix_LoadMUS( file->fullName );
+  }
+  if(!mus[1])
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Couldn't load music: '%s'\n",file->fullName);
+  }
+  else
+  {
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Now Playing: '%s'\n",file->fullName);
+    if(songName)
+    {
+      showSNCD=SHOW_SONG_TIME;
+      strcpy(songName,file->name);
     }
   }
-  numUserSongs=i;
+
+  Mix_FadeInMusicPos(mus[1], 0, MUSIC_FADETIME,mPos[1]);
+
+  //Have the next one ready when this one ends.
+  if(numUserSongs > 1)
+  {
+    soundPreload( (num+1)%numUserSongs );
+  }
 }
 
 
@@ -382,17 +451,20 @@ void soundSetMusic()
     Mix_FreeMusic(mus[1]);
     mus[1]=0;
   }
+  soundPreloadTake(-1, "");
   mPos[0]=0.0f;
   mPos[1]=0.0f;
+  numUserSongs=0;
+  userMusicWait=0;
 
   if(setting()->disableMusic) return;
   
   //Load list of userMusic and load that
   if(setting()->userMusic)
   {
+    //The first song starts in soundRun when the list is ready
     fileListMake( setting()->musicDir );
-    //Load first song 
-    soundPlayUserSongNum(0,0); //Sets number of tracks too.
+    userMusicWait=1;
   } else {//Or load in-game music
     //Load the menu-song
     mus[0] = Mix_LoadMUS( "data/menu-music.ogg" );
@@ -422,6 +494,8 @@ void soundSetMusVol(int v)
 }
 
 void releaseMusic() {
+  soundPreloadTake(-1, "");
+
   if(mus[0]) {
     Mix_FreeMusic(mus[0]);
     mus[0]=0;
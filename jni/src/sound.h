@@ -49,7 +49,7 @@
 #define NUMSAMPLES 24
 
 
-int initSound();
+int initSound(); //Opens audio, the menu samples are loaded by loadMenuSamples()
 void loadSamples(const char* sndDir, const char* musicFile); //Loads all samples for the game
 void loadMenuSamples(); //Loads all samples for the game
 void sndPlay(int sample, int posX);
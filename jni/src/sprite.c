@@ -18,6 +18,7 @@
 #include "sprite.h"
 #include "ticks.h"
 #include "pack.h"
+#include "archive.h"
 
 SDL_Surface* loadImg( const char* fileName )
 {
@@ -25,7 +26,9 @@ SDL_Surface* loadImg( const char* fileName )
 	SDL_Surface* unoptimized = NULL;
 	SDL_Surface* optimized = NULL;
 	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,  "loadImg(); Open: %s\n",fileName);
-    unoptimized = IMG_Load( fileName );
+    //Straight from the mapping if it's in a pack archive
+    SDL_RWops* rw = archiveRW( fileName );
+    unoptimized = (rw)?IMG_Load_RW( rw, 1 ):IMG_Load( fileName );
 
     if(unoptimized!=NULL)
     {
@@ -48,6 +51,180 @@ SDL_Surface* loadImg( const char* fileName )
   return(optimized);
 }
 
+//Converted surfaces by path, see imgCacheGet()
+struct imgCacheEntry_s
+{
+  int used;
+  uint32_t hash;
+  int lastUse; //For LRU eviction
+  int bytes;
+  SDL_Surface* surf; //NULL if the file couldn't be loaded, so missing optional images aren't retried
+  char* path;
+};
+static struct imgCacheEntry_s imgCache[IMG_CACHE_SIZE];
+static int imgCacheClock=0;
+static int imgCacheBytes=0;
+static imgCacheStats_t imgStats;
+
+static uint32_t imgHash(const char* str)
+{
+  uint32_t h=5381;
+  while(*str)
+  {
+    h = (h<<5) + h + (uint8_t)(*str);
+    str++;
+  }
+  return(h);
+}
+
+//Nobody but the cache holds a reference
+static int imgCacheUnused(struct imgCacheEntry_s* e)
+{
+  return( !e->surf || e->surf->refcount==1 );
+}
+
+static void imgCacheDrop(struct imgCacheEntry_s* e)
+{
+  if(e->surf)
+    SDL_FreeSurface(e->surf);
+  imgCacheBytes -= e->bytes;
+  free(e->path);
+  memset(e, 0, sizeof(struct imgCacheEntry_s));
+}
+
+SDL_Surface* imgCacheGet( const char* fileName )
+{
+  int i;
+  uint32_t hash = imgHash(fileName);
+  struct imgCacheEntry_s* e;
+  struct imgCacheEntry_s* victim=NULL;
+  SDL_Surface* surf;
+
+  for(i=0; i < IMG_CACHE_SIZE; i++)
+  {
+    e=&imgCache[i];
+    if( e->used && e->hash==hash && strcmp(e->path, fileName)==0 )
+    {
+      imgStats.hits++;
+      e->lastUse=++imgCacheClock;
+      if(e->surf)
+        e->surf->refcount++;
+      return(e->surf);
+    }
+
+    //Prefer an empty slot, otherwise the least recently used one nobody references.
+    if( !e->used )
+    {
+      if( !victim || victim->used )
+        victim=e;
+    } else if( imgCacheUnused(e) && (!victim || (victim->used && e->lastUse < victim->lastUse)) )
+    {
+      victim=e;
+    }
+  }
+
+  imgStats.misses++;
+  surf = loadImg(fileName);
+
+  //Every slot is referenced, hand out a surface of its own.
+  if(!victim)
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "imgCacheGet(); All %i slots in use, not caching %s\n", IMG_CACHE_SIZE, fileName);
+    return(surf);
+  }
+
+  if(victim->used)
+  {
+    imgStats.evictions++;
+    imgCacheDrop(victim);
+  }
+
+  victim->path = malloc( strlen(fileName)+1 );
+  if(!victim->path)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Error, couldn't malloc %lu bytes.\n", (long unsigned int)strlen(fileName)+1);
+    return(surf);
+  }
+  strcpy(victim->path, fileName);
+  victim->used=1;
+  victim->hash=hash;
+  victim->lastUse=++imgCacheClock;
+  victim->surf=surf;
+  victim->bytes=(surf)?surf->pitch*surf->h:0;
+  imgCacheBytes += victim->bytes;
+
+  if(surf)
+  {
+    //One reference for the cache, one for the caller.
+    surf->refcount++;
+    imgCacheTrim();
+  }
+
+  return(surf);
+}
+
+void imgCacheTrim()
+{
+  int i;
+  struct imgCacheEntry_s* e;
+  struct imgCacheEntry_s* victim;
+
+  while( imgCacheBytes > IMG_CACHE_BUDGET )
+  {
+    victim=NULL;
+    for(i=0; i < IMG_CACHE_SIZE; i++)
+    {
+      e=&imgCache[i];
+      if( e->used && e->bytes && imgCacheUnused(e) && (!victim || e->lastUse < victim->lastUse) )
+        victim=e;
+    }
+
+    //What's left is in use
+    if(!victim)
+      break;
+
+    imgStats.evictions++;
+    imgCacheDrop(victim);
+  }
+}
+
+void imgCacheFlush()
+{
+  int i;
+  for(i=0; i < IMG_CACHE_SIZE; i++)
+  {
+    if( imgCache[i].used && imgCacheUnused(&imgCache[i]) )
+      imgCacheDrop(&imgCache[i]);
+  }
+}
+
+imgCacheStats_t* imgCacheGetStats()
+{
+  int i;
+  imgStats.entries=0;
+  imgStats.bytes=imgCacheBytes;
+  imgStats.bytesInUse=0;
+  for(i=0; i < IMG_CACHE_SIZE; i++)
+  {
+    if(imgCache[i].used)
+    {
+      imgStats.entries++;
+      if( !imgCacheUnused(&imgCache[i]) )
+        imgStats.bytesInUse += imgCache[i].bytes;
+    }
+  }
+  return(&imgStats);
+}
+
+void imgCacheLogStats()
+{
+  imgCacheStats_t* st = imgCacheGetStats();
+  int lookups = st->hits+st->misses;
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "imgCache: %i hits, %i misses (%i%% hit), %i evictions, %i entries, %i KiB resident (%i KiB in use, budget %i KiB)\n",
+      st->hits, st->misses, (lookups)?(st->hits*100/lookups):0, st->evictions, st->entries,
+      st->bytes/1024, st->bytesInUse/1024, IMG_CACHE_BUDGET/1024 );
+}
+
 spriteType* cutSprite(SDL_Surface* img, int x,int y, int w, int h)
 {
   //Did we get a valid surface?
@@ -141,3 +318,170 @@ void drawAniFrame(SDL_Surface* screen, aniType* ani, int x, int y, int frame)
   if(!ani) return;
   drawSprite(screen, ani->spr[frame],x,y);
 }
+
+struct sprCmd_s {
+  spriteType* spr;
+  int x,y;
+  int seq; //Order of submission, keeps the sort stable
+};
+typedef struct sprCmd_s sprCmd_t;
+
+static sprCmd_t batch[SPR_BATCH_MAX];
+static int batchNum=0;
+static SDL_Surface* batchScr=NULL;
+
+//Colour-keyed blitters for a fixed size, both surfaces 32 bit with the same RGB layout.
+#define SPR_KEYBLIT(W,H) \
+static void keyBlit##W##x##H(const Uint8* src, int srcPitch, Uint8* dst, int dstPitch, Uint32 key, Uint32 rgbMask, Uint32 aMask) \
+{ \
+  int x,y; \
+  for(y=0; y < H; y++) \
+  { \
+    const Uint32* s = (const Uint32*)(src+y*srcPitch); \
+    Uint32* d = (Uint32*)(dst+y*dstPitch); \
+    for(x=0; x < W; x++) \
+    { \
+      if( (s[x]&rgbMask) != key ) \
+        d[x] = s[x]|aMask; \
+    } \
+  } \
+}
+
+SPR_KEYBLIT(20,20) //Bricks, tiles and walls
+
+static void keyBlit(const Uint8* src, int srcPitch, Uint8* dst, int dstPitch, int w, int h, Uint32 key, Uint32 rgbMask, Uint32 aMask)
+{
+  int x,y;
+  for(y=0; y < h; y++)
+  {
+    const Uint32* s = (const Uint32*)(src+y*srcPitch);
+    Uint32* d = (Uint32*)(dst+y*dstPitch);
+    for(x=0; x < w; x++)
+    {
+      if( (s[x]&rgbMask) != key )
+        d[x] = s[x]|aMask;
+    }
+  }
+}
+
+//Can we copy pixels straight from img to scr instead of going through SDL_BlitSurface?
+static int batchCanKeyBlit(SDL_Surface* img, SDL_Surface* scr, Uint32* key)
+{
+  Uint8 r,g,b,a;
+  SDL_BlendMode mode;
+
+  if( img->format->BytesPerPixel != 4 || scr->format->BytesPerPixel != 4 )
+    return(0);
+  if( img->format->Rmask != scr->format->Rmask || img->format->Gmask != scr->format->Gmask || img->format->Bmask != scr->format->Bmask )
+    return(0);
+  if( (img->flags & SDL_RLEACCEL) || SDL_MUSTLOCK(img) || img->format->Amask )
+    return(0);
+  if( SDL_GetColorKey(img, key) != 0 )
+    return(0);
+
+  SDL_GetSurfaceColorMod(img, &r,&g,&b);
+  SDL_GetSurfaceAlphaMod(img, &a);
+  SDL_GetSurfaceBlendMode(img, &mode);
+  if( r!=255 || g!=255 || b!=255 || a!=255 || mode != SDL_BLENDMODE_NONE )
+    return(0);
+
+  return(1);
+}
+
+static int batchCmp(const void* a, const void* b)
+{
+  const sprCmd_t* ca = (const sprCmd_t*)a;
+  const sprCmd_t* cb = (const sprCmd_t*)b;
+
+  if( ca->spr->img != cb->spr->img )
+    return( (ca->spr->img < cb->spr->img)?-1:1 );
+  return( ca->seq - cb->seq );
+}
+
+void batchSprite(SDL_Surface* scr, spriteType* spr, int x, int y)
+{
+  if(!spr) return;
+
+  if( batchNum == SPR_BATCH_MAX || (batchScr && batchScr != scr) )
+    batchFlush();
+
+  batchScr=scr;
+  batch[batchNum].spr=spr;
+  batch[batchNum].x=x;
+  batch[batchNum].y=y;
+  batch[batchNum].seq=batchNum;
+  batchNum++;
+}
+
+void batchAni(SDL_Surface* scr, aniType* ani, int x, int y)
+{
+  if(!ani) return;
+  batchFlush();
+  drawAni(scr, ani, x, y);
+}
+
+void batchAniFrame(SDL_Surface* scr, aniType* ani, int x, int y, int frame)
+{
+  if(!ani) return;
+  batchFlush();
+  drawAniFrame(scr, ani, x, y, frame);
+}
+
+void batchFlush()
+{
+  int i;
+  SDL_Surface* img=NULL;
+  SDL_Rect clip, pos;
+  Uint32 key=0, rgbMask, aMask;
+  int fast=0;
+  sprCmd_t* c;
+  const Uint8* src;
+  Uint8* dst;
+
+  if( batchNum == 0 )
+    return;
+
+  qsort(batch, batchNum, sizeof(sprCmd_t), batchCmp);
+
+  SDL_GetClipRect(batchScr, &clip);
+  rgbMask = batchScr->format->Rmask|batchScr->format->Gmask|batchScr->format->Bmask;
+  aMask = batchScr->format->Amask;
+
+  if( SDL_MUSTLOCK(batchScr) ) SDL_LockSurface(batchScr);
+
+  for(i=0; i < batchNum; i++)
+  {
+    c=&batch[i];
+
+    //New source surface, find out once if we can take the fast path for it
+    if( c->spr->img != img )
+    {
+      img=c->spr->img;
+      fast=batchCanKeyBlit(img, batchScr, &key);
+      key &= rgbMask;
+    }
+
+    //The fast path only handles sprites that are completely inside the clip rect
+    if( fast && c->x >= clip.x && c->y >= clip.y && c->x+c->spr->clip.w <= clip.x+clip.w && c->y+c->spr->clip.h <= clip.y+clip.h )
+    {
+      src = (const Uint8*)img->pixels + c->spr->clip.y*img->pitch + c->spr->clip.x*4;
+      dst = (Uint8*)batchScr->pixels + c->y*batchScr->pitch + c->x*4;
+
+      if( c->spr->clip.w == 20 && c->spr->clip.h == 20 )
+        keyBlit20x20(src, img->pitch, dst, batchScr->pitch, key, rgbMask, aMask);
+      else
+        keyBlit(src, img->pitch, dst, batchScr->pitch, c->spr->clip.w, c->spr->clip.h, key, rgbMask, aMask);
+    } else {
+      if( SDL_MUSTLOCK(batchScr) ) SDL_UnlockSurface(batchScr);
+      pos.x=c->x;
+      pos.y=c->y;
+      SDL_BlitSurface(img, &c->spr->clip, batchScr, &pos);
+      if( SDL_MUSTLOCK(batchScr) ) SDL_LockSurface(batchScr);
+    }
+  }
+
+  if( SDL_MUSTLOCK(batchScr) ) SDL_UnlockSurface(batchScr);
+
+  batchNum=0;
+  batchScr=NULL;
+}
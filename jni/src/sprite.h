@@ -35,6 +35,35 @@ typedef struct {
 } aniType;
 
 SDL_Surface* loadImg( const char* fileName ); //Ret 0 fail
+
+//Image cache: Converted surfaces are kept by path and shared between users, so reloading
+//the same theme or menu image is a lookup instead of a decode. References are counted with the
+//surface's own refcount, release a cached surface with SDL_FreeSurface() like any other.
+//Surfaces nobody references are kept until the cache goes over budget, then evicted least recently used first.
+//Cached surfaces are shared, never draw onto them. Not thread safe, main thread only.
+#ifndef IMG_CACHE_BUDGET
+  #define IMG_CACHE_BUDGET (8*1024*1024) //Bytes of pixel data
+#endif
+#ifndef IMG_CACHE_SIZE
+  #define IMG_CACHE_SIZE 64
+#endif
+
+struct imgCacheStats_s
+{
+  int hits;
+  int misses;
+  int evictions;
+  int entries; //Slots currently in use
+  int bytes; //Pixel data resident in the cache
+  int bytesInUse; //Part of bytes that is referenced outside the cache
+};
+typedef struct imgCacheStats_s imgCacheStats_t;
+
+SDL_Surface* imgCacheGet( const char* fileName ); //Ret 0 fail, adds a reference
+void imgCacheTrim(); //Evict unreferenced surfaces until within budget
+void imgCacheFlush(); //Drop every unreferenced surface
+imgCacheStats_t* imgCacheGetStats();
+void imgCacheLogStats();
 spriteType* cutSprite(SDL_Surface* img, int x,int y, int w, int h); //Ret 0 fail
 void drawSprite(SDL_Surface* scr, spriteType* spr, int x, int y);
 
@@ -45,4 +74,17 @@ void playAni(aniType* ani);
 void drawAni(SDL_Surface* screen, aniType* ani, int x, int y);
 void drawAniFrame(SDL_Surface* screen, aniType* ani, int x, int y, int frame);
 
+//Batched drawing: Sprites are queued and drawn by batchFlush(), grouped by source surface.
+//Sprites sharing a source surface keep their order, so only batch sprites that don't overlap sprites from other surfaces,
+//and flush before drawing anything that must go on top. The 30x30 animations overlap their neighbours, so batchAni()
+//and batchAniFrame() flush and draw them right away, in the order they were given.
+#ifndef SPR_BATCH_MAX
+  #define SPR_BATCH_MAX 512
+#endif
+
+void batchSprite(SDL_Surface* scr, spriteType* spr, int x, int y);
+void batchAni(SDL_Surface* scr, aniType* ani, int x, int y);
+void batchAniFrame(SDL_Surface* scr, aniType* ani, int x, int y, int frame);
+void batchFlush();
+
 #endif // SPRITE_H_INCLUDED
@@ -23,12 +23,14 @@
 
 static list_t* stars;
 static list_t* rockets;
+static listPool_t* starPool; //Nodes for stars, rockets and rocket particles
 //Setup 1000 stars
 #define NUMSTARS 500
 void initStars(SDL_Surface* screen)
 {
-  rockets = listInit(free);
-  stars = listInit(free);
+  starPool = listPoolInit();
+  rockets = listInitPooled(free, starPool);
+  stars = listInitPooled(free, starPool);
   star_t* star;
   int i;
   uint8_t col;
@@ -118,7 +120,7 @@ void fireWorks(SDL_Surface* screen)
     //Set life
     tempRocket->life=rand()%1000+250+10;
 
-    tempRocket->p = listInit(free);
+    tempRocket->p = listInitPooled(free, starPool);
     //Init particles for explosion
     int i, r=rand()%100;
     for(i=0; i < r; i++)
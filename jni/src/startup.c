@@ -0,0 +1,223 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "startup.h"
+
+#define JOB_WAITING 0
+#define JOB_RUNNING 1
+#define JOB_DONE 2
+#define JOB_FAILED 3
+
+typedef struct {
+  const char* name;
+  startupFunc func;
+  void* data;
+  int thread;
+  Uint32 deps;
+  int state;
+  int worker; //0 is the main thread
+  Uint64 start, end;
+} startupJob_t;
+
+static startupJob_t jobs[STARTUP_MAX_JOBS];
+static int numJobs=0;
+static int jobsLeft=0;
+static Uint32 doneMask=0;
+static Uint32 failMask=0;
+static SDL_mutex* lock=NULL;
+static SDL_cond* cond=NULL;
+static Uint64 runStart=0;
+
+int startupAdd(const char* name, startupFunc func, void* data, int thread, Uint32 deps)
+{
+  startupJob_t* j;
+
+  //Jobs can only depend on jobs added before them, so the graph has no cycles.
+  if( numJobs == STARTUP_MAX_JOBS || (deps >> numJobs) )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "startupAdd(); Can't add job %s.\n", name);
+    return(-1);
+  }
+
+  j = &jobs[numJobs];
+  memset( j, 0, sizeof(startupJob_t) );
+  j->name = name;
+  j->func = func;
+  j->data = data;
+  j->thread = thread;
+  j->deps = deps;
+  j->state = JOB_WAITING;
+
+  return(numJobs++);
+}
+
+//Called with the lock held. Returns the next job this thread can run (marked running), or -1.
+static int startupNext(int mainThread)
+{
+  int i, pick=-1;
+
+  for(i=0; i < numJobs; i++)
+  {
+    if( jobs[i].state != JOB_WAITING )
+      continue;
+
+    //Jobs that depend on a failed job are skipped, in id order so it carries through the graph
+    if( jobs[i].deps & failMask )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "startup: Skipping %s, a job it depends on failed.\n", jobs[i].name);
+      jobs[i].state = JOB_FAILED;
+      failMask |= STARTUP_DEP(i);
+      jobsLeft--;
+      SDL_CondBroadcast( cond );
+      continue;
+    }
+
+    if( (jobs[i].deps & doneMask) != jobs[i].deps )
+      continue;
+
+    if( jobs[i].thread == STARTUP_MAIN_THREAD && !mainThread )
+      continue;
+
+    //The main thread takes its own jobs first, workers can't do them
+    if( pick == -1 || (mainThread && jobs[i].thread == STARTUP_MAIN_THREAD && jobs[pick].thread != STARTUP_MAIN_THREAD) )
+      pick=i;
+  }
+
+  if( pick != -1 )
+    jobs[pick].state = JOB_RUNNING;
+
+  return(pick);
+}
+
+//Run jobs until all are done. Called with the lock held, returns with it held.
+static void startupLoop(int worker)
+{
+  int id, ok;
+  Uint64 start, end;
+
+  while( jobsLeft > 0 )
+  {
+    id = startupNext( (worker==0) );
+    if( id == -1 )
+    {
+      SDL_CondWait( cond, lock );
+      continue;
+    }
+
+    SDL_UnlockMutex( lock );
+    start = SDL_GetPerformanceCounter();
+    ok = jobs[id].func( jobs[id].data );
+    end = SDL_GetPerformanceCounter();
+    SDL_LockMutex( lock );
+
+    jobs[id].start = start;
+    jobs[id].end = end;
+    jobs[id].worker = worker;
+    if( ok )
+    {
+      jobs[id].state = JOB_DONE;
+      doneMask |= STARTUP_DEP(id);
+    } else {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "startup: %s failed.\n", jobs[id].name);
+      jobs[id].state = JOB_FAILED;
+      failMask |= STARTUP_DEP(id);
+    }
+    jobsLeft--;
+    SDL_CondBroadcast( cond );
+  }
+}
+
+static int startupWorker(void* data)
+{
+  SDL_LockMutex( lock );
+  startupLoop( (int)(intptr_t)data );
+  SDL_UnlockMutex( lock );
+  return(0);
+}
+
+int startupRun()
+{
+  SDL_Thread* workers[STARTUP_WORKERS+1];
+  int numWorkers = SDL_GetCPUCount()-1;
+  int i, ret;
+  double freq = (double)SDL_GetPerformanceFrequency()/1000.0;
+  double work=0;
+
+  if( numWorkers > STARTUP_WORKERS )
+    numWorkers = STARTUP_WORKERS;
+
+  lock = SDL_CreateMutex();
+  cond = SDL_CreateCond();
+  if( !lock || !cond )
+    numWorkers=0;
+
+  jobsLeft = numJobs;
+  doneMask = 0;
+  failMask = 0;
+  runStart = SDL_GetPerformanceCounter();
+
+  for(i=0; i < numWorkers; i++)
+  {
+    workers[i] = SDL_CreateThread( startupWorker, "startupWorker", (void*)(intptr_t)(i+1) );
+    if( !workers[i] )
+    {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "startupRun(); Could not start worker: %s\n", SDL_GetError());
+      break;
+    }
+  }
+  numWorkers=i;
+
+  //Without a lock there are no workers either, and the main thread can't block.
+  if(lock)
+    SDL_LockMutex( lock );
+  startupLoop( 0 );
+  if(lock)
+    SDL_UnlockMutex( lock );
+
+  for(i=0; i < numWorkers; i++)
+  {
+    SDL_WaitThread( workers[i], NULL );
+  }
+
+  for(i=0; i < numJobs; i++)
+  {
+    if( jobs[i].state == JOB_DONE )
+    {
+      SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "startup: %-12s %7.1f ms  (%7.1f - %7.1f) on %s %i\n", jobs[i].name,
+                  (double)(jobs[i].end-jobs[i].start)/freq, (double)(jobs[i].start-runStart)/freq, (double)(jobs[i].end-runStart)/freq,
+                  (jobs[i].worker)?"worker":"main", jobs[i].worker );
+      work += (double)(jobs[i].end-jobs[i].start)/freq;
+    }
+  }
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "startup: %i jobs took %.1f ms on %i threads, %.1f ms of work.\n", numJobs,
+              (double)(SDL_GetPerformanceCounter()-runStart)/freq, numWorkers+1, work );
+
+  ret = (failMask==0);
+
+  numJobs=0;
+  if( cond )
+    SDL_DestroyCond( cond );
+  if( lock )
+    SDL_DestroyMutex( lock );
+  cond=NULL;
+  lock=NULL;
+
+  return(ret);
+}
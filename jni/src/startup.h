@@ -0,0 +1,46 @@
+#ifndef STARTUP_H_INCLUDED
+#define STARTUP_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <SDL.h>
+
+//Startup is a graph of init jobs. Jobs run on a pool of worker threads as soon as the jobs
+//they depend on are done, jobs that need the main thread (video, audio) run there.
+
+#define STARTUP_MAX_JOBS 32
+
+#define STARTUP_ANY_THREAD 0
+#define STARTUP_MAIN_THREAD 1
+
+//Dependency mask for a job id returned by startupAdd
+#define STARTUP_DEP(id) (1u<<(id))
+
+//Worker threads besides the main thread, 0 runs every job on the main thread
+#ifndef STARTUP_WORKERS
+  #define STARTUP_WORKERS 3
+#endif
+
+typedef int (*startupFunc)(void* data); //Returns 0 on failure
+
+//Returns the id of the job, or -1 if there is no room for it.
+int startupAdd(const char* name, startupFunc func, void* data, int thread, Uint32 deps);
+//Runs all added jobs and logs how long each took. Returns 1 if every job succeeded.
+int startupRun();
+
+#endif // STARTUP_H_INCLUDED
@@ -16,6 +16,7 @@
  ************************************************************************/
 
 #include <unistd.h>
+#include <stddef.h>
 #include "strings.h"
 #include "stats.h"
 #include "pack.h"
@@ -24,9 +25,13 @@
 #include "settings.h"
 #include "userfiles.h"
 #include "platform/androidUtils.h"
+#include "statsupload.h"
+#include "levelindex.h"
 
 static stats_t st;
 
+static void statsCloseJournal();
+
 //Return ptr to stats_t
 stats_t* stats()
 {
@@ -40,6 +45,235 @@ void statsInit()
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "statsInit(); Stats ready to be refreshed.\n");
 }
 
+//The first stats file format, a raw dump of the structs.
+#define STATS_LEGACY_VERSION 1
+
+static void statsToDisk(statsDiskEntry_t* d, const hsEntry_t* hs)
+{
+  memcpy( d->name, hs->name, sizeof(d->name) );
+  d->levelNum = SDL_SwapLE32(hs->levelNum);
+  d->score = SDL_SwapLE32(hs->score);
+  d->time = SDL_SwapLE32(hs->time);
+  d->moves = SDL_SwapLE32(hs->moves);
+  d->combos = SDL_SwapLE32(hs->combos);
+}
+
+static void statsFromDisk(hsEntry_t* hs, const statsDiskEntry_t* d)
+{
+  memcpy( hs->name, d->name, sizeof(hs->name) );
+  hs->name[sizeof(hs->name)-1]=0;
+  hs->levelNum = (int32_t)SDL_SwapLE32(d->levelNum);
+  hs->score = (int32_t)SDL_SwapLE32(d->score);
+  hs->time = (int32_t)SDL_SwapLE32(d->time);
+  hs->moves = (int32_t)SDL_SwapLE32(d->moves);
+  hs->combos = (int32_t)SDL_SwapLE32(d->combos);
+}
+
+//Copy hs over the best stats for its level.
+static void statsSetLevelEntry(const hsEntry_t* hs)
+{
+  if( hs->levelNum >= 0 && hs->levelNum < st.levelStats->count )
+  {
+    memcpy( ARRAYAT(st.levelStats, hs->levelNum), hs, sizeof(hsEntry_t) );
+  } else {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "That's odd, there's an entry for level %i even though there's only %i levels in the pack. (levelStats is %i)\n", hs->levelNum, getNumLevels(), st.levelStats->count );
+  }
+}
+
+//Put a copy of hs into the pack-wide table at place (0 is first), keep the 10 best.
+static void statsInsertHs(const hsEntry_t* hs, int place)
+{
+  listItem* it = &st.packHsTable->begin;
+  hsEntry_t* e = malloc(sizeof(hsEntry_t));
+  int p=0;
+
+  memcpy( e, hs, sizeof(hsEntry_t) );
+  if( !listInsertAtIdx(st.packHsTable, (void*)e, place) )
+  {
+    free(e);
+    return;
+  }
+
+  //Trim the list if there are more than 10.
+  while( LISTFWD(st.packHsTable,it) )
+  {
+    p++;
+    if(p>10)
+    {
+      it=listRemoveItem(st.packHsTable,it, LIST_PREV);
+    }
+  }
+}
+
+//Read a stats file, nothing is changed unless all of it is good.
+static int statsReadFile(FILE* f)
+{
+  statsDiskHeader_t h;
+  statsDiskEntry_t* e;
+  hsEntry_t ths;
+  uint32_t i, numLevel, numHs;
+
+  if( fread( &h, sizeof(h), 1, f ) != 1 || memcmp( h.ident, STATS_FILE_IDENT, 4 ) != 0 )
+  {
+    return(0);
+  }
+
+  if( SDL_SwapLE32(h.version) != STATS_FILE_FORMAT_VERSION )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "File '%s' is version %u but current version is %i.\n", st.hsFn, SDL_SwapLE32(h.version), STATS_FILE_FORMAT_VERSION);
+    return(0);
+  }
+
+  numLevel = SDL_SwapLE32(h.numLevelEntries);
+  numHs = SDL_SwapLE32(h.numHsEntries);
+  if( numLevel > 0xffff || numHs > 0xffff )
+  {
+    return(0);
+  }
+
+  e = malloc( sizeof(statsDiskEntry_t)*(numLevel+numHs)+1 );
+  if( fread( e, sizeof(statsDiskEntry_t), numLevel+numHs, f ) != numLevel+numHs ||
+      levelIndexHashMem( e, sizeof(statsDiskEntry_t)*(numLevel+numHs) ) != SDL_SwapLE32(h.check) )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Something went wrong while trying to read '%s'\n",st.hsFn);
+    free(e);
+    return(0);
+  }
+
+  st.generation = SDL_SwapLE32(h.generation);
+  st.progress = (int32_t)SDL_SwapLE32(h.progress);
+
+  //Override defaults for levels found in file
+  for(i=0; i < numLevel; i++)
+  {
+    statsFromDisk( &ths, &e[i] );
+    statsSetLevelEntry( &ths );
+  }
+
+  //Fill in the pack-wide highscore list
+  for(i=0; i < numHs; i++)
+  {
+    hsEntry_t* hs = malloc(sizeof(hsEntry_t));
+    statsFromDisk( hs, &e[numLevel+i] );
+    listAppendData(st.packHsTable, (void*)hs);
+  }
+
+  free(e);
+  return(1);
+}
+
+//Read a version 1 stats file, so it can be written in the current format.
+static int statsReadLegacy(FILE* f)
+{
+  int i;
+  hsEntry_t* hs;
+  hsEntry_t ths;
+  statsFileHeader_t sfh;
+  size_t elementsRead;
+
+  rewind(f);
+  //Read the header
+  elementsRead = fread( (void*)(&sfh), sizeof(statsFileHeader_t), 1, f);
+  if( elementsRead != 1 || sfh.hsFileVersion != STATS_LEGACY_VERSION )
+  {
+    return(0);
+  }
+
+  //Set progress
+  st.progress = sfh.progress;
+
+  //Override defaults for levels found in file
+  for(i=0; i < sfh.numLevelEntries; i++)
+  {
+    //Read a highscore entry
+    if( fread( (void*)(&ths), sizeof(hsEntry_t), 1, f ) == 1 )
+    {
+      statsSetLevelEntry( &ths );
+    }
+  }
+
+  //Fill in the pack-wide highscore list
+  for(i=0; i < sfh.numHsEntries; i++)
+  {
+    hs=malloc(sizeof(hsEntry_t));
+    elementsRead = fread(hs,sizeof(hsEntry_t),1,f);
+    if( elementsRead == 1 )
+    {
+      listAppendData(st.packHsTable, (void*)hs);
+    } else {
+      free(hs);
+    }
+  }
+
+  return(1);
+}
+
+static void statsApplyRecord(const statsJournalRecord_t* r)
+{
+  hsEntry_t hs;
+  int arg = (int32_t)SDL_SwapLE32(r->arg);
+
+  statsFromDisk( &hs, &r->e );
+  switch( SDL_SwapLE32(r->type) )
+  {
+    case STATS_REC_LEVEL:
+      statsSetLevelEntry( &hs );
+      st.progress = arg;
+    break;
+    case STATS_REC_PROGRESS:
+      st.progress = arg;
+    break;
+    case STATS_REC_HIGHSCORE:
+      statsInsertHs( &hs, arg );
+    break;
+  }
+}
+
+//Apply the journal on top of the stats file. Returns -1 if there is no journal for this
+//generation, 0 if it was read and is clean, 1 if it should be folded into the stats file.
+static int statsReplayJournal()
+{
+  statsJournalHeader_t h;
+  statsJournalRecord_t r;
+  size_t got;
+  int torn=0;
+  FILE* f = fopen(st.jnlFn, "rb");
+
+  st.jnlRecords=0;
+  if(!f)
+  {
+    return(-1);
+  }
+
+  //A journal from an older generation is already in the stats file, it was written just before.
+  if( fread( &h, sizeof(h), 1, f ) != 1 || memcmp( h.ident, STATS_JOURNAL_IDENT, 4 ) != 0 ||
+      SDL_SwapLE32(h.version) != STATS_FILE_FORMAT_VERSION || SDL_SwapLE32(h.generation) != st.generation )
+  {
+    fclose(f);
+    return(-1);
+  }
+
+  while( (got = fread( &r, 1, sizeof(r), f )) )
+  {
+    //The last record may be half written if we died while appending it.
+    if( got != sizeof(r) || levelIndexHashMem( &r, offsetof(statsJournalRecord_t, check) ) != SDL_SwapLE32(r.check) )
+    {
+      torn=1;
+      break;
+    }
+    statsApplyRecord( &r );
+    st.jnlRecords++;
+  }
+  fclose(f);
+
+  if( torn )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Journal '%s' ends in a broken record after %i good ones, ignoring the rest.\n", st.jnlFn, st.jnlRecords);
+  }
+
+  return( (torn || st.jnlRecords) ? 1 : 0 );
+}
+
 //Tries to load stats
 void statsLoad()
 {
@@ -47,37 +281,39 @@ void statsLoad()
   char* buf = malloc(sizeof(char)*128);
   char* bufb = malloc(sizeof(char)*128);
   int i;
+  int compact=0;
   hsEntry_t* hs;
-  hsEntry_t ths;
-  statsFileHeader_t sfh;
-  listItem* it;
+
+  //Changes to the previous pack are on disk before we let go of its journal.
+  statsCloseJournal();
 
   //Set progress -1 before reading the real progress from file (in case there is no file yet)
   // -1 because progress is updated to current-level after the completion of that level, but
   // at the same time, it is used (with +2) to set maxY in menu.
   st.progress=-1;
+  st.generation=0;
 
   //Free levelStats if allready filled
   if(st.levelStats)
   {
-    listFree( st.levelStats );
+    arrayFree( st.levelStats );
   }
 
-  //Create new list for levelStats
-  st.levelStats = listInit(free);
+  //Create new array for levelStats
+  st.levelStats = arrayInit(free);
   for(i=0; i < packState()->cp->numLevels; i++)
   {
     hs = malloc(sizeof(hsEntry_t));
     //Set name 0, we're not going to use it for levelStats
-    memset( hs->name, 0, 11 );
+    memset( hs->name, 0, sizeof(hs->name) );
     //Set default "best"
     hs->levelNum=i;
     hs->score=0;
     hs->time=9999;
     hs->moves=9999;
     hs->combos=0;
-    //Add to list
-    listAppendData(st.levelStats, (void*)hs);
+    //Add to array
+    arrayAppendData(st.levelStats, (void*)hs);
   }
 
   //Remove packwide highscores if they exist
@@ -96,85 +332,153 @@ void statsLoad()
   sprintf(bufb, "%s/%s.hig", getHighscoreDir(), buf);
 
   //Copy name to st.
-  if(!st.hsFn)
+  if(st.hsFn)
     free(st.hsFn);
   st.hsFn = malloc(sizeof(char)*strlen(bufb)+1);
   strcpy(st.hsFn, bufb);
-  f=fopen(st.hsFn, "r");
 
+  //And the journal next to it
+  strcat(bufb, ".jnl");
+  if(st.jnlFn)
+    free(st.jnlFn);
+  st.jnlFn = malloc(sizeof(char)*strlen(bufb)+1);
+  strcpy(st.jnlFn, bufb);
 
+  f=fopen(st.hsFn, "rb");
   if(f)
   {
-    //Read the int and check that it's the version we expect.
-    size_t elementsRead = fread( &i, sizeof(int),1,f);
-
-    if( elementsRead == 1 && i == STATS_FILE_FORMAT_VERSION )
+    if( !statsReadFile(f) )
     {
-      //Jump to start of file again
-      rewind(f);
-      //Read the header
-      size_t elementsRead = fread( (void*)(&sfh), sizeof(statsFileHeader_t), 1, f);
-      if( elementsRead != 1 )
+      if( statsReadLegacy(f) )
       {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Something went wrong while trying to read '%s'\n",st.hsFn);
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Converting '%s' to version %i.\n", st.hsFn, STATS_FILE_FORMAT_VERSION);
+        compact=1;
+      } else {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Can't read '%s', it will be replaced.\n", st.hsFn);
       }
-      //Set progress
-      st.progress = sfh.progress;
+    }
+    fclose(f);
+  }
 
-      //Override defaults for levels found in file
-      for(i=0; i < sfh.numLevelEntries; i++)
-      {
-        //Read a highscore entry
-        elementsRead = fread( (void*)(&ths), sizeof(hsEntry_t), 1, f );
-
-        //Look for a list to add it to
-        if( ths.levelNum <  st.levelStats->count )
-        {
-          it = listGetItemAt(st.levelStats,ths.levelNum);
-
-          //If it was found, copy it
-          if(elementsRead==1 && it)
-          {
-            hs = (hsEntry_t*)it->data;
-            memcpy( hs, &ths, sizeof(hsEntry_t) );
-          }
-        } else {
-          SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "That's odd, there's an entry for level %i even though there's only %i levels in the pack. (levelStats is %i)\n", ths.levelNum, getNumLevels(), st.levelStats->count );
-        }
-      }
+  switch( statsReplayJournal() )
+  {
+    case 0:
+      //Keep appending to it.
+      st.jnl = fopen(st.jnlFn, "ab");
+    break;
+    case 1:
+      compact=1;
+    break;
+  }
 
+  if(compact)
+  {
+    statsSave();
+  }
 
+  free(buf);
+  free(bufb);
+}
 
-      //Fill in the pack-wide highscore list
-      for(i=0; i < sfh.numHsEntries; i++)
-      {
-        hs=malloc(sizeof(hsEntry_t));
-        elementsRead = fread(hs,sizeof(hsEntry_t),1,f);
-        if( elementsRead == 1 )
-        {
-          listAppendData(st.packHsTable, (void*)hs);
-        }
-      }
+//Write all of the stats to a new file, and rename it over the old one.
+static int statsWriteFile(uint32_t generation)
+{
+  statsDiskHeader_t h;
+  statsDiskEntry_t* e;
+  listItem* it;
+  char tmpName[512];
+  int i, num=0, ok=0;
+  FILE* f;
 
-      fclose(f);
-    } else {
+  e = malloc( sizeof(statsDiskEntry_t)*(st.levelStats->count+st.packHsTable->count)+1 );
+
+  //Write levelstats
+  for(i=0; i < st.levelStats->count; i++)
+  {
+    statsToDisk( &e[num++], (hsEntry_t*)ARRAYAT(st.levelStats, i) );
+  }
+
+  //Write packWide hstable
+  it = &st.packHsTable->begin;
+  while( LISTFWD(st.packHsTable, it) )
+  {
+    statsToDisk( &e[num++], (hsEntry_t*)it->data );
+  }
 
-      //TODO: This is not how we will handle it, if the format ever changes we will use version info to migrate to new format.
-      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "File '%s' is version %i but current version is %i, deleting the file.\n", st.hsFn, i, STATS_FILE_FORMAT_VERSION);
-      fclose(f);
-      packUnlinkHsFile();
+  //Fill in header
+  memcpy( h.ident, STATS_FILE_IDENT, 4 );
+  h.version = SDL_SwapLE32(STATS_FILE_FORMAT_VERSION);
+  h.generation = SDL_SwapLE32(generation);
+  h.progress = SDL_SwapLE32(st.progress);
+  h.numLevelEntries = SDL_SwapLE32(st.levelStats->count);
+  h.numHsEntries = SDL_SwapLE32(st.packHsTable->count);
+  h.check = SDL_SwapLE32( levelIndexHashMem( e, sizeof(statsDiskEntry_t)*num ) );
+
+  snprintf( tmpName, sizeof(tmpName), "%s.tmp", st.hsFn );
+  f = fopen( tmpName, "wb" );
+  if( f )
+  {
+    ok = ( fwrite( &h, sizeof(h), 1, f ) == 1 );
+    if( ok && num )
+      ok = ( fwrite( e, sizeof(statsDiskEntry_t), num, f ) == (size_t)num );
+    //On disk before it replaces the old file
+    if( ok )
+      ok = ( fflush(f) == 0 && fsync( fileno(f) ) == 0 );
+    if( fclose(f) != 0 )
+      ok=0;
+
+    if( !ok || rename( tmpName, st.hsFn ) != 0 )
+    {
+      ok=0;
+      remove( tmpName );
     }
   }
+  free(e);
 
-  free(buf);
-  free(bufb);
+  if( !ok )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Error, couldn't write '%s'.\n", st.hsFn);
+  }
+  return(ok);
 }
 
-void statsSave()
+//Start an empty journal for the current generation, and keep it open for appending.
+static void statsNewJournal()
 {
-  listItem* it;
-  hsEntry_t* hs;
+  statsJournalHeader_t h;
+  char tmpName[512];
+  int ok=0;
+  FILE* f;
+
+  memcpy( h.ident, STATS_JOURNAL_IDENT, 4 );
+  h.version = SDL_SwapLE32(STATS_FILE_FORMAT_VERSION);
+  h.generation = SDL_SwapLE32(st.generation);
+
+  snprintf( tmpName, sizeof(tmpName), "%s.tmp", st.jnlFn );
+  f = fopen( tmpName, "wb" );
+  if( f )
+  {
+    ok = ( fwrite( &h, sizeof(h), 1, f ) == 1 );
+    if( fclose(f) != 0 )
+      ok=0;
+    if( !ok || rename( tmpName, st.jnlFn ) != 0 )
+    {
+      ok=0;
+      remove( tmpName );
+    }
+  }
+
+  st.jnlRecords=0;
+  st.unsynced=0;
+  st.jnl = (ok) ? fopen( st.jnlFn, "ab" ) : NULL;
+  if( !st.jnl )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Error, couldn't start journal '%s', stats will be written in full.\n", st.jnlFn);
+  }
+}
 
+void statsSave()
+{
   //Check that there's a filename to write to (st is all 0's if not)
   if(!st.hsFn)
   {
@@ -182,42 +486,81 @@ void statsSave()
     return;
   }
 
-  //Open file
-  FILE* f = fopen(st.hsFn, "w");
-  if(f)
+  statsCloseJournal();
+
+  //The journal of the old generation is ignored once the new file is in place,
+  //so dying between the two renames loses nothing.
+  if( statsWriteFile( st.generation+1 ) )
   {
-    //Fill in header
-    statsFileHeader_t sfh;
-    sfh.hsFileVersion = STATS_FILE_FORMAT_VERSION;
-    sfh.progress = st.progress;
-    sfh.numLevelEntries = st.levelStats->count;
-    sfh.numHsEntries  = st.packHsTable->count;
+    st.generation++;
+    statsNewJournal();
+  }
+}
 
-    //Write header
-    fwrite( (void*)(&sfh), sizeof(statsFileHeader_t),1, f );
+//Append a change to the journal, the stats in memory must already have it.
+static void statsJournal(uint32_t type, int arg, const hsEntry_t* hs)
+{
+  statsJournalRecord_t r;
 
-    //Write levelstats
-    it=&st.levelStats->begin;
-    while( LISTFWD(st.levelStats, it) )
-    {
-      hs=(hsEntry_t*)it->data;
-      //Write entry to file.
-      fwrite( (void*)(hs), sizeof(hsEntry_t), 1, f);
-    }
+  //No journal yet, or it's long enough to fold into the stats file.
+  if( !st.jnl || st.jnlRecords >= STATS_JOURNAL_MAX )
+  {
+    statsSave();
+    return;
+  }
 
-    //Write packWide hstable
-    it = &st.packHsTable->begin;
-    while( LISTFWD(st.packHsTable, it) )
-    {
-      hs = (hsEntry_t*)it->data;
-      fwrite( (void*)(hs), sizeof(hsEntry_t), 1, f);
-    }
+  memset( &r, 0, sizeof(r) );
+  r.type = SDL_SwapLE32(type);
+  r.arg = SDL_SwapLE32(arg);
+  if( hs )
+  {
+    statsToDisk( &r.e, hs );
+  }
+  r.check = SDL_SwapLE32( levelIndexHashMem( &r, offsetof(statsJournalRecord_t, check) ) );
 
-    fclose(f);
-  } else {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Error, couldn't open '%s' for writing.\n", st.hsFn);
+  if( fwrite( &r, sizeof(r), 1, st.jnl ) != 1 || fflush( st.jnl ) != 0 )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Error, couldn't append to '%s'.\n", st.jnlFn);
+    statsSave();
+    return;
+  }
+
+  st.jnlRecords++;
+  st.unsynced++;
+  if( st.unsynced >= STATS_SYNC_RECORDS || SDL_GetTicks()-st.lastSync >= STATS_SYNC_MS )
+  {
+    statsFlush();
+  }
+}
+
+void statsFlush()
+{
+  if( st.jnl && st.unsynced )
+  {
+    fflush( st.jnl );
+    fsync( fileno(st.jnl) );
+    st.unsynced=0;
+  }
+  st.lastSync=SDL_GetTicks();
+}
+
+static void statsCloseJournal()
+{
+  statsFlush();
+  if( st.jnl )
+  {
+    fclose( st.jnl );
+    st.jnl=0;
   }
+}
 
+void statsSetProgress(int progress)
+{
+  if( progress != st.progress )
+  {
+    st.progress=progress;
+    statsJournal( STATS_REC_PROGRESS, progress, NULL );
+  }
 }
 
 //Figure out if this deserves an entry in the highscore table, update number of games played
@@ -276,13 +619,13 @@ void statsSubmitBest()
     st.cl->combos = lvlHs->combos;
   }
 
-  statsSave();
+  statsJournal( STATS_REC_LEVEL, st.progress, st.cl );
 
 }
 
 void statsSetLevel(int l)
 {
-  st.cl=(hsEntry_t*)listGetItemAt(st.levelStats, l)->data;
+  st.cl=(hsEntry_t*)arrayGetAt(st.levelStats, l);
 }
 
 void statsDrawHs(SDL_Surface* screen)
@@ -341,30 +684,15 @@ int statsIsHighScore()
 void statsSaveHighScore()
 {
   int place = statsIsHighScore();
-  int p=0;
-
-  listItem* it = &st.packHsTable->begin;
-  hsEntry_t* hs;
-
-  //Copy from player struct.
-  hs = malloc(sizeof(hsEntry_t));
-  memcpy( hs, &(player()->campStats), sizeof(hsEntry_t) );
-
-  listInsertAtIdx(st.packHsTable, (void*)hs, place-1);//-1 since listInsert expects 0 to be the first position, but statsIsHigh returns >0 to be a valid highscore.
 
-
-  //Trim the list if there are more than 10.
-  while( LISTFWD(st.packHsTable,it) )
+  if( place )
   {
-    p++;
-    if(p>10)
-    {
-      it=listRemoveItem(st.packHsTable,it, LIST_PREV);
-    }
-  }
+    //-1 since listInsert expects 0 to be the first position, but statsIsHigh returns >0 to be a valid highscore.
+    statsInsertHs( &player()->campStats, place-1 );
 
-  //Save to file.
-  statsSave();
+    //Save to file.
+    statsJournal( STATS_REC_HIGHSCORE, place-1, &player()->campStats );
+  }
 
   //Clear player.
   initPlayer();
@@ -381,6 +709,8 @@ void statsReset()
 
 void packUnlinkHsFile()
 {
+  statsCloseJournal();
+
   //First we find out if it exists on the filesystem
   FILE* f=android_fopen(st.hsFn, "r");
   if(f)
@@ -388,68 +718,27 @@ void packUnlinkHsFile()
     fclose(f);
     unlink(st.hsFn);
   }
-}
 
-#if defined (PLATFORM_SUPPORTS_STATSUPLOAD)
-#include <SDL_thread.h>
-static char curlbuf[2048];
-typedef struct thrDat
-{ char* cmd;
-int* ret;
-} thrDat_t;
-
-int upStatsThread(void * d)
-{
-  char pBuf[2048];
-  memset(pBuf, 0, sizeof(pBuf));
-  FILE *pipe;
-  thrDat_t* dat = (thrDat_t*)d;
-  char* cmd = dat->cmd;
-  int* ret = dat->ret;
-
-  if( setting()->showWeb ) { SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "%s\n", cmd ); }
-
-  if( (pipe = popen( cmd, "r" )) != NULL )
+  if( st.jnlFn )
   {
-      setting()->online=1;
-
-      if( fread( pBuf, 1,2047, pipe)!= 0 )
-      {
-        if( setting()->showWeb ) { SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Server returned:'%s'\n",pBuf); }
-        if(ret)
-        {
-          *ret=atoi(pBuf);
-        }
-      }
-      pclose(pipe);
-
-  } else {
-    setting()->online=0;
+    unlink(st.jnlFn);
   }
-  free(dat->cmd);
-  free(dat);
-  return(0);
 }
-#endif
 
 void statsUpload(int level, int time, int moves, int combos, int score, const char* action, int ignoreIfOnline, int* retVal)
 {
   #if defined (PLATFORM_SUPPORTS_STATSUPLOAD)
-  if( (setting()->online || ignoreIfOnline) )
+  char body[STATSUP_BODY_LEN];
+
+  //Queued while we're allowed to upload, the uploader keeps them until the server can be reached.
+  if( (setting()->uploadStats || ignoreIfOnline) )
   {
-    int b = sprintf( curlbuf, "%s\"version=%s&pack=%s&level=%i&time=%i&moves=%i&combos=%i&score=%i&action=%s&session=%i&platform=%s\"",\
-        CMD_UPLOAD_STATS_POST, VERSION_STRING, packState()->cp->path,\
+    int b = snprintf( body, sizeof(body), "version=%s&pack=%s&level=%i&time=%i&moves=%i&combos=%i&score=%i&action=%s&session=%i&platform=%s",\
+        VERSION_STRING, packState()->cp->path,\
         level,time,moves,combos,score,action, setting()->session, STR_PLATFORM );
-    if(b > 0 && b < 2048)
+    if(b > 0 && b < (int)sizeof(body))
     {
-      thrDat_t* thrData=malloc(sizeof(thrDat_t));
-      thrData->cmd=malloc(strlen(curlbuf)+1);
-      strcpy(thrData->cmd,curlbuf);
-      thrData->ret=retVal;
-      if( SDL_CreateThread( upStatsThread, "stats_SDL_thread", (void*)thrData ) == NULL )
-      {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Warning: Coulnd't start thread: %s\n", SDL_GetError());
-      }
+      statsUpPost( action, body, retVal );
     } else {
       SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "ERROR: sprintf returned %i\n", b);
     }
@@ -52,12 +52,19 @@ struct stats_s
 {
   char* hsFn; //Stats file to read from
   int progress; //Progress in this pack
-  list_t* levelStats; //list of hsEntries, one for each level, with "best" stats
+  array_t* levelStats; //array of hsEntries, one for each level, with "best" stats
   list_t* packHsTable; //pack-wide highscores
   hsEntry_t* cl; //ptr to current levelStats
+  char* jnlFn; //Journal of changes since the stats file was written
+  FILE* jnl; //Journal opened for appending, 0 until the first change
+  uint32_t generation; //Stats file generation, the journal must match it
+  int jnlRecords; //Records in the journal
+  int unsynced; //Records appended since last fsync
+  Uint32 lastSync; //Ticks at last fsync
 };
 typedef struct stats_s stats_t;
 
+//Version 1 stats file, a raw dump of the structs. Only read to migrate it.
 struct statsFileHeader_s {
   int hsFileVersion;  //Version of file
   int progress;       //Highest level player has yet achieved
@@ -66,6 +73,64 @@ struct statsFileHeader_s {
 };
 typedef struct statsFileHeader_s statsFileHeader_t;
 
+//Flush the journal to disk after this many records or this many ms, whichever comes first
+#ifndef STATS_SYNC_RECORDS
+#define STATS_SYNC_RECORDS 8
+#endif
+#ifndef STATS_SYNC_MS
+#define STATS_SYNC_MS 10000
+#endif
+//Fold the journal into a new stats file when it has this many records
+#ifndef STATS_JOURNAL_MAX
+#define STATS_JOURNAL_MAX 64
+#endif
+
+#define STATS_FILE_IDENT "WZHS"
+#define STATS_JOURNAL_IDENT "WZHJ"
+
+//All stats on disk are little endian and fixed size.
+struct statsDiskEntry_s {
+  char name[12];
+  int32_t levelNum;
+  int32_t score;
+  int32_t time;
+  int32_t moves;
+  int32_t combos;
+};
+typedef struct statsDiskEntry_s statsDiskEntry_t;
+
+//Stats file, followed by numLevelEntries and numHsEntries statsDiskEntry_t
+struct statsDiskHeader_s {
+  char ident[4];
+  uint32_t version;
+  uint32_t generation;
+  int32_t progress;
+  uint32_t numLevelEntries;
+  uint32_t numHsEntries;
+  uint32_t check; //Of the entries
+};
+typedef struct statsDiskHeader_s statsDiskHeader_t;
+
+//Journal, followed by records until the end of the file
+struct statsJournalHeader_s {
+  char ident[4];
+  uint32_t version;
+  uint32_t generation; //Of the stats file it belongs to
+};
+typedef struct statsJournalHeader_s statsJournalHeader_t;
+
+#define STATS_REC_LEVEL 1 //e is the new best for e.levelNum, arg is progress
+#define STATS_REC_PROGRESS 2 //arg is progress
+#define STATS_REC_HIGHSCORE 3 //e goes into the pack-wide table at place arg
+
+struct statsJournalRecord_s {
+  uint32_t type;
+  int32_t arg;
+  statsDiskEntry_t e;
+  uint32_t check; //Of the above, a torn write at the end of the journal fails it
+};
+typedef struct statsJournalRecord_s statsJournalRecord_t;
+
 void statsSetLevel(int l); //Simply set the cl ptr.
 stats_t* stats(); //Return ptr to stats_t
 void statsInit(); //Sets some ptrs 0, that's all.
@@ -74,7 +139,9 @@ void statsSubmitBest();
 void statsDrawHs( SDL_Surface* screen );
 int statsIsHighScore();
 void statsSaveHighScore();
-void statsSave();
+void statsSave(); //Write the stats file and start a new journal
+void statsSetProgress(int progress); //Journaled if it changed
+void statsFlush(); //fsync the journal if there are unsynced records
 
 void statsReset();
 void packUnlinkHsFile();
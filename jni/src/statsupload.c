@@ -0,0 +1,449 @@
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "statsupload.h"
+#include "defs.h"
+#include "settings.h"
+#include "strings.h"
+#include "userfiles.h"
+
+#if defined (PLATFORM_SUPPORTS_STATSUPLOAD)
+
+typedef struct {
+  char action[STATSUP_ACTION_LEN];
+  char body[STATSUP_BODY_LEN];
+  int* retVal; //Someone waits for the reply, never kept on disk
+} statsUpEvent_t;
+
+//A slot is free for position p when seq==p, and holds the event for p when seq==p+1.
+typedef struct {
+  SDL_atomic_t seq;
+  statsUpEvent_t ev;
+} statsUpSlot_t;
+
+static statsUpSlot_t ring[STATSUP_QUEUE_SIZE];
+static SDL_atomic_t ringHead;
+static int ringTail=0; //Only the uploader moves the tail
+static SDL_atomic_t quit;
+static SDL_sem* wake=NULL;
+static SDL_sem* done=NULL;
+static SDL_Thread* thread=NULL;
+static void* transport=NULL;
+
+//Only touched by the uploader
+static statsUpEvent_t* pending[STATSUP_PENDING_MAX];
+static int numPending=0;
+static char queueFn[512];
+
+//Runs CMD_UPLOAD_STATS_POST for each body, it fails when the command does.
+static int statsUpCmdTransport(const char** bodies, int num, int* replies)
+{
+  char cmd[STATSUP_BODY_LEN+512];
+  char pBuf[2048];
+  FILE* pipe;
+  int i;
+
+  for(i=0; i < num; i++)
+  {
+    snprintf( cmd, sizeof(cmd), "%s\"%s\"", CMD_UPLOAD_STATS_POST, bodies[i] );
+    if( setting()->showWeb ) { SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "%s\n", cmd ); }
+
+    if( (pipe = popen( cmd, "r" )) == NULL )
+    {
+      break;
+    }
+
+    memset( pBuf, 0, sizeof(pBuf) );
+    if( fread( pBuf, 1, sizeof(pBuf)-1, pipe ) != 0 )
+    {
+      if( setting()->showWeb ) { SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Server returned:'%s'\n",pBuf); }
+    }
+    replies[i]=atoi(pBuf);
+
+    if( pclose(pipe) != 0 )
+    {
+      break;
+    }
+  }
+  return(i);
+}
+
+void statsUpSetTransport(statsUpTransport t)
+{
+  SDL_AtomicSetPtr( &transport, (void*)t );
+}
+
+int statsUpPost(const char* action, const char* body, int* retVal)
+{
+  statsUpSlot_t* s;
+  int pos, dif;
+
+  if( !thread )
+  {
+    return(0);
+  }
+
+  //Claim a slot, any thread may be posting.
+  for(;;)
+  {
+    pos = SDL_AtomicGet( &ringHead );
+    s = &ring[ pos & (STATSUP_QUEUE_SIZE-1) ];
+    dif = SDL_AtomicGet( &s->seq ) - pos;
+    if( dif == 0 )
+    {
+      if( SDL_AtomicCAS( &ringHead, pos, pos+1 ) )
+      {
+        break;
+      }
+    } else if( dif < 0 )
+    {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "statsUpPost(); Queue is full, dropping '%s'.\n", action);
+      return(0);
+    }
+  }
+
+  snprintf( s->ev.action, sizeof(s->ev.action), "%s", action );
+  snprintf( s->ev.body, sizeof(s->ev.body), "%s", body );
+  s->ev.retVal = retVal;
+  SDL_AtomicSet( &s->seq, pos+1 );
+
+  SDL_SemPost( wake );
+  return(1);
+}
+
+static int statsUpPop(statsUpEvent_t* ev)
+{
+  statsUpSlot_t* s = &ring[ ringTail & (STATSUP_QUEUE_SIZE-1) ];
+
+  if( SDL_AtomicGet( &s->seq ) - (ringTail+1) < 0 )
+  {
+    return(0);
+  }
+
+  memcpy( ev, &s->ev, sizeof(statsUpEvent_t) );
+  SDL_AtomicSet( &s->seq, ringTail+STATSUP_QUEUE_SIZE );
+  ringTail++;
+  return(1);
+}
+
+static void statsUpDropPending(int i)
+{
+  free( pending[i] );
+  numPending--;
+  memmove( &pending[i], &pending[i+1], sizeof(statsUpEvent_t*)*(numPending-i) );
+}
+
+//Returns 1 if the events kept on disk changed.
+static int statsUpAddPending(const statsUpEvent_t* ev)
+{
+  int i;
+
+  //A newer request for the same reply replaces the one not yet sent.
+  if( ev->retVal )
+  {
+    for(i=0; i < numPending; i++)
+    {
+      if( pending[i]->retVal == ev->retVal && strcmp( pending[i]->action, ev->action )==0 )
+      {
+        memcpy( pending[i], ev, sizeof(statsUpEvent_t) );
+        return(0);
+      }
+    }
+  }
+
+  if( numPending == STATSUP_PENDING_MAX )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "statsUpload: %i events not delivered, dropping the oldest ('%s').\n", numPending, pending[0]->action);
+    statsUpDropPending(0);
+  }
+
+  pending[numPending] = malloc( sizeof(statsUpEvent_t) );
+  memcpy( pending[numPending], ev, sizeof(statsUpEvent_t) );
+  numPending++;
+
+  return( ev->retVal == NULL );
+}
+
+//Keep the undelivered events on disk, one "action body" per line.
+static void statsUpSave()
+{
+  char tmpName[520];
+  FILE* f;
+  int i, num=0, ok;
+
+  for(i=0; i < numPending; i++)
+  {
+    if( !pending[i]->retVal )
+      num++;
+  }
+
+  if( !num )
+  {
+    remove( queueFn );
+    return;
+  }
+
+  snprintf( tmpName, sizeof(tmpName), "%s.tmp", queueFn );
+  f = fopen( tmpName, "w" );
+  if( !f )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "statsUpload: Could not open %s for writing.\n", tmpName);
+    return;
+  }
+
+  ok=1;
+  for(i=0; i < numPending; i++)
+  {
+    if( !pending[i]->retVal && fprintf( f, "%s %s\n", pending[i]->action, pending[i]->body ) < 0 )
+      ok=0;
+  }
+  if( fclose(f) != 0 )
+    ok=0;
+
+  if( !ok || rename( tmpName, queueFn ) != 0 )
+  {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "statsUpload: Could not write %s.\n", queueFn);
+    remove( tmpName );
+  }
+}
+
+static void statsUpLoad()
+{
+  char buf[STATSUP_ACTION_LEN+STATSUP_BODY_LEN+2];
+  statsUpEvent_t ev;
+  FILE* f;
+  char* sp;
+  int len, c;
+
+  f = fopen( queueFn, "r" );
+  if( !f )
+  {
+    return;
+  }
+
+  while( fgets( buf, sizeof(buf), f ) )
+  {
+    //statsUpSave never writes a line this long, skip all of it instead of sending pieces
+    len = strlen( buf );
+    if( len && buf[len-1] != '\n' && !feof(f) )
+    {
+      while( (c=fgetc(f)) != EOF && c != '\n' );
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "statsUpload: Dropping an over-long line from %s.\n", queueFn);
+      continue;
+    }
+
+    stripNewLine( buf );
+    sp = strchr( buf, ' ' );
+    if( !sp || !sp[1] )
+    {
+      continue;
+    }
+    *sp=0;
+
+    //Too long to fit, a cut action or body is not the event that was queued
+    if( sp-buf >= STATSUP_ACTION_LEN || strlen(sp+1) >= STATSUP_BODY_LEN )
+    {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "statsUpload: Dropping '%.*s' from %s, it is too long.\n", STATSUP_ACTION_LEN, buf, queueFn);
+      continue;
+    }
+
+    memset( &ev, 0, sizeof(ev) );
+    memcpy( ev.action, buf, sp-buf+1 );
+    memcpy( ev.body, sp+1, strlen(sp+1)+1 );
+    statsUpAddPending( &ev );
+  }
+  fclose(f);
+
+  if( numPending )
+  {
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "statsUpload: %i events from last time are waiting to be sent.\n", numPending);
+  }
+}
+
+//Send the oldest batch, returns 1 if all of it was delivered.
+static int statsUpSend()
+{
+  const char* bodies[STATSUP_BATCH_MAX];
+  int replies[STATSUP_BATCH_MAX];
+  statsUpTransport t = (statsUpTransport)SDL_AtomicGetPtr( &transport );
+  int i, num, sent;
+
+  num = (numPending < STATSUP_BATCH_MAX) ? numPending : STATSUP_BATCH_MAX;
+  for(i=0; i < num; i++)
+  {
+    bodies[i] = pending[i]->body;
+    replies[i] = 0;
+  }
+
+  sent = (t) ? t( bodies, num, replies ) : statsUpCmdTransport( bodies, num, replies );
+  setting()->online = (sent > 0);
+
+  for(i=0; i < sent; i++)
+  {
+    if( pending[0]->retVal )
+    {
+      *(pending[0]->retVal) = replies[i];
+    }
+    statsUpDropPending(0);
+  }
+
+  if( sent < num )
+  {
+    //Whoever asked for a reply asked now, not in ten minutes.
+    for(i=0; i < numPending; i++)
+    {
+      if( pending[i]->retVal )
+      {
+        statsUpDropPending(i--);
+      }
+    }
+    return(0);
+  }
+  return(1);
+}
+
+static int statsUpThread(void* data)
+{
+  statsUpEvent_t ev;
+  Uint32 now, backoff=0, retryAt=0, sendAt=0;
+  int dirty, waitReply, i;
+
+  statsUpLoad();
+
+  while( !SDL_AtomicGet( &quit ) )
+  {
+    //Everything posted so far goes to pending, and on disk in one write.
+    dirty=0;
+    while( statsUpPop( &ev ) )
+    {
+      if( !numPending )
+      {
+        sendAt = SDL_GetTicks()+STATSUP_COALESCE_MS;
+      }
+      dirty |= statsUpAddPending( &ev );
+    }
+    if( dirty )
+    {
+      statsUpSave();
+    }
+
+    waitReply=0;
+    for(i=0; i < numPending; i++)
+    {
+      if( pending[i]->retVal )
+        waitReply=1;
+    }
+
+    now = SDL_GetTicks();
+    if( numPending && setting()->uploadStats &&
+        ( waitReply || ( (Sint32)(now-sendAt) >= 0 && (Sint32)(now-retryAt) >= 0 ) ) )
+    {
+      i = numPending;
+      if( statsUpSend() )
+      {
+        backoff=0;
+      } else {
+        backoff = (backoff) ? backoff*2 : STATSUP_BACKOFF_MIN_MS;
+        if( backoff > STATSUP_BACKOFF_MAX_MS )
+          backoff = STATSUP_BACKOFF_MAX_MS;
+        retryAt = now+backoff;
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "statsUpload: %i events not delivered, retrying in %u ms.\n", numPending, backoff);
+      }
+      if( numPending != i )
+      {
+        statsUpSave();
+      }
+      continue;
+    }
+
+    //Sleep until something is posted, or the next batch is due.
+    if( numPending && setting()->uploadStats )
+    {
+      now = SDL_GetTicks();
+      i = (Sint32)( ((Sint32)(sendAt-retryAt) > 0 ? sendAt : retryAt) - now );
+      SDL_SemWaitTimeout( wake, (i > 0) ? i : 0 );
+    } else {
+      SDL_SemWait( wake );
+    }
+  }
+
+  SDL_SemPost( done );
+  return(0);
+}
+
+void statsUpInit()
+{
+  int i;
+
+  if( thread )
+  {
+    return;
+  }
+
+  snprintf( queueFn, sizeof(queueFn), "%s/statsqueue.txt", getConfigDir() );
+
+  for(i=0; i < STATSUP_QUEUE_SIZE; i++)
+  {
+    SDL_AtomicSet( &ring[i].seq, i );
+  }
+  SDL_AtomicSet( &ringHead, 0 );
+  SDL_AtomicSet( &quit, 0 );
+  ringTail=0;
+
+  wake = SDL_CreateSemaphore(0);
+  done = SDL_CreateSemaphore(0);
+  thread = SDL_CreateThread( statsUpThread, "statsUpload", NULL );
+  if( !thread )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "statsUpInit(); Couldn't start thread: %s\n", SDL_GetError());
+  }
+}
+
+void statsUpQuit()
+{
+  SDL_Thread* t = thread;
+
+  if( !t )
+  {
+    return;
+  }
+  thread=NULL;
+
+  SDL_AtomicSet( &quit, 1 );
+  SDL_SemPost( wake );
+
+  //A batch in flight can take as long as the transport allows, what it was sending is on disk.
+  if( SDL_SemWaitTimeout( done, STATSUP_QUIT_MS ) == 0 )
+  {
+    SDL_WaitThread( t, NULL );
+    SDL_DestroySemaphore( wake );
+    SDL_DestroySemaphore( done );
+    while( numPending )
+    {
+      statsUpDropPending(0);
+    }
+  } else {
+    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "statsUpQuit(); Uploader is busy, not waiting for it.\n");
+    SDL_DetachThread( t );
+  }
+}
+
+#endif
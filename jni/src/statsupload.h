@@ -0,0 +1,67 @@
+#ifndef STATSUPLOAD_H_INCLUDED
+#define STATSUPLOAD_H_INCLUDED
+
+/************************************************************************
+ * This file is part of Wizznic.                                        *
+ * Copyright 2009-2015 Jimmy Christensen <dusted@dusted.dk>             *
+ * Wizznic is free software: you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by *
+ * the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                  *
+ *                                                                      *
+ * Wizznic is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of       *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        *
+ * GNU General Public License for more details.                         *
+ *                                                                      *
+ * You should have received a copy of the GNU General Public License    *
+ * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
+ ************************************************************************/
+
+#include <SDL.h>
+
+//Stats events are queued for a single uploader thread, which sends them in batches through
+//a transport. Events that were not delivered are kept on disk and retried with backoff.
+
+//Slots in the queue between the game and the uploader, power of two
+#ifndef STATSUP_QUEUE_SIZE
+  #define STATSUP_QUEUE_SIZE 64
+#endif
+//Most events handed to the transport at once
+#ifndef STATSUP_BATCH_MAX
+  #define STATSUP_BATCH_MAX 16
+#endif
+//Most undelivered events kept, the oldest are dropped
+#ifndef STATSUP_PENDING_MAX
+  #define STATSUP_PENDING_MAX 256
+#endif
+//Wait this long for more events before sending, unless someone waits for a reply
+#ifndef STATSUP_COALESCE_MS
+  #define STATSUP_COALESCE_MS 2000
+#endif
+//Retry delay after a failed batch, doubles up to the max
+#ifndef STATSUP_BACKOFF_MIN_MS
+  #define STATSUP_BACKOFF_MIN_MS 5000
+#endif
+#ifndef STATSUP_BACKOFF_MAX_MS
+  #define STATSUP_BACKOFF_MAX_MS 600000
+#endif
+//How long statsUpQuit waits for a batch in flight
+#ifndef STATSUP_QUIT_MS
+  #define STATSUP_QUIT_MS 500
+#endif
+
+#define STATSUP_BODY_LEN 512
+#define STATSUP_ACTION_LEN 16
+
+//Send num request bodies in order, store the server reply of each in replies.
+//Returns how many were delivered, the rest are retried later.
+typedef int (*statsUpTransport)(const char** bodies, int num, int* replies);
+
+void statsUpInit(); //Start the uploader and load undelivered events
+void statsUpQuit(); //Stop the uploader, undelivered events are on disk
+void statsUpSetTransport(statsUpTransport t); //NULL for the default, which runs CMD_UPLOAD_STATS_POST
+//Queue a request body, the reply is stored in retVal if it's not NULL. Returns 0 if the queue is full.
+int statsUpPost(const char* action, const char* body, int* retVal);
+
+#endif // STATSUPLOAD_H_INCLUDED
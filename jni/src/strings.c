@@ -16,8 +16,11 @@
  ************************************************************************/
 #include <string.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <SDL.h>
 
 #include "strings.h"
+#include "levelindex.h"
 
 // We reuse the "Reserved/blocker" brick as a "Remove" icon in the mousedriven editor.
 const char* str_brick_names[] = { "Nobrick", "Brick 0", "Brick 1","Brick 2","Brick 3","Brick 4","Brick 5","Brick 6","Brick 7","Brick 8","Brick 9","V. Lift", "H. Lift", "L. Oneway", "R. Oneway", "Glue", "Wall", "Remove", "Teleport", "SwOn", "SwOff", "Rem.Brick", "Cpy.Brick", "Game Over", "BrickType" };
@@ -70,3 +73,92 @@ int charrpos(const char* str, char c)
   }
   return(0);
 }
+
+static SDL_SpinLock internLock;
+static const char** internTable=NULL; //Open addressing, size is a power of two
+static int internSize=0;
+static int internCount=0;
+static int internBytes=0;
+static char* internBlock=NULL; //Free space in the current block
+static int internBlockLeft=0;
+
+//Copy str into a block, long strings get their own allocation.
+static const char* strInternStore(const char* str, int len)
+{
+  char* s;
+  if( len > STR_INTERN_BLOCK/4 )
+  {
+    s = malloc( len );
+  } else {
+    if( internBlockLeft < len )
+    {
+      internBlock = malloc( STR_INTERN_BLOCK );
+      internBlockLeft = STR_INTERN_BLOCK;
+    }
+    s = internBlock;
+    internBlock += len;
+    internBlockLeft -= len;
+  }
+  memcpy( s, str, len );
+  internBytes += len;
+  return(s);
+}
+
+static void strInternGrow()
+{
+  int i, n;
+  int size = (internSize)?internSize*2:256;
+  const char** table = calloc( size, sizeof(char*) );
+
+  for(i=0; i < internSize; i++)
+  {
+    if( internTable[i] )
+    {
+      for( n=levelIndexHash(internTable[i])&(size-1); table[n]; n=(n+1)&(size-1) );
+      table[n] = internTable[i];
+    }
+  }
+  free( internTable );
+  internTable = table;
+  internSize = size;
+}
+
+const char* strIntern(const char* str)
+{
+  int i;
+  const char* s;
+  uint32_t h;
+
+  if( !str )
+    return(NULL);
+
+  h = levelIndexHash(str);
+  SDL_AtomicLock( &internLock );
+
+  if( internCount*2 >= internSize )
+    strInternGrow();
+
+  for( i=h&(internSize-1); internTable[i]; i=(i+1)&(internSize-1) )
+  {
+    if( strcmp( internTable[i], str )==0 )
+    {
+      s = internTable[i];
+      SDL_AtomicUnlock( &internLock );
+      return(s);
+    }
+  }
+
+  s = internTable[i] = strInternStore( str, strlen(str)+1 );
+  internCount++;
+
+  SDL_AtomicUnlock( &internLock );
+  return(s);
+}
+
+void strInternStats(int* count, int* bytes)
+{
+  SDL_AtomicLock( &internLock );
+  *count = internCount;
+  *bytes = internBytes;
+  SDL_AtomicUnlock( &internLock );
+}
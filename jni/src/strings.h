@@ -180,6 +180,9 @@
 		                                  "DLC download is disabled.\n"\
                                       "Go to wizznic.org/dlc"
 
+#define STR_MENU_PACKLIST_LOADING "Loading..."
+#define STR_MENU_FILELIST_SCANNING "Scanning..."
+
 #define STR_MENU_ABOUT_WEBSITE      "http://wizznic.org/"
 
 #define STR_MENU_BEAT_PACK_HEADLINE "Good job!"
@@ -316,6 +319,14 @@
 #define STR_EDIT_UNSAVED            "Not saved"
 #define STR_EDIT_STATUS             "Status:"
 #define STR_EDIT_NOT_SAVED_WARNING  "Not Saved!"
+#define STR_EDIT_SOLVER             "Solution:"
+#define STR_EDIT_SOLVER_CHECKING    "Checking"
+#define STR_EDIT_SOLVER_SOLVABLE    "Found"
+#define STR_EDIT_SOLVER_UNSOLVABLE  "None"
+#define STR_EDIT_SOLVER_UNKNOWN     "Unknown"
+#define STR_EDIT_SOLVER_MOVES       "%i moves"
+#define STR_EDIT_SOLVER_MORE_THAN   ">%i moves"
+#define STR_EDIT_SOLVER_AT_MOST     "<=%i moves"
 
 //This is defined in strings.c
 extern const char* str_brick_names[];
@@ -379,4 +390,12 @@ void stripNewLine(char* str);
 int splitVals(char ch,const char* buf, char* set, char* val); //Splits a setting=value line and returns true if it did. else returns 0
 int charrpos(const char* str, char c); //Return position of last instance of character c
 
+//Interned strings: One shared copy of each distinct string, kept for the life of the program (never free them).
+//Equal strings get the same pointer. Thread safe.
+#ifndef STR_INTERN_BLOCK
+  #define STR_INTERN_BLOCK 4096 //Strings are packed into blocks of this many bytes
+#endif
+const char* strIntern(const char* str); //Returns NULL for NULL
+void strInternStats(int* count, int* bytes);
+
 #endif // STRINGS_H_INCLUDED
@@ -15,22 +15,34 @@
  * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
  ************************************************************************/
 
+#include <string.h>
+
 #include "swscale.h"
 #include "settings.h"
 #include "defs.h"
 #include "pixel.h"
 
-static SDL_Surface* scale;
+static SDL_Surface* scale=NULL;
 
 SDL_Surface* swScaleInit( int sdlVideoModeFlags, int doScale )
 {
-  
-  scale = SDL_CreateRGBSurface(0, 640, 480, 32,
+  SDL_Surface* screen;
+
+  if( scale )
+    SDL_FreeSurface(scale);
+
+  //The game draws to a SCREENW x SCREENH surface in the same 32 bit format as the scaled one
+  scale = SDL_CreateRGBSurface(0, SCREENW*doScale, SCREENH*doScale, 32,
                                         0x00FF0000,
                                         0x0000FF00,
                                         0x000000FF,
                                         0xFF000000);
-  SDL_Surface* screen = SDL_CreateRGBSurface(SDL_SWSURFACE, 640, 480,16, scale->format->Rmask,scale->format->Gmask,scale->format->Bmask,0xff000000);
+  if( !scale )
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "swScaleInit(); Couldn't create %ix%i surface: %s\n", SCREENW*doScale, SCREENH*doScale, SDL_GetError());
+    return(NULL);
+  }
+  screen = SDL_CreateRGBSurface(sdlVideoModeFlags, SCREENW, SCREENH, 32, scale->format->Rmask,scale->format->Gmask,scale->format->Bmask,scale->format->Amask);
 
   //Set scaling
   setting()->scaleFactor= (float)scale->h/240.0;
@@ -38,43 +50,35 @@ SDL_Surface* swScaleInit( int sdlVideoModeFlags, int doScale )
   return( screen );
 }
 
-void swScale( SDL_Surface* screen, int doScale )
+SDL_Surface* swScale( SDL_Surface* screen, int doScale )
 {
-    if(doScale==2)
+    if(doScale>1)
     {
-      int x,xx,y,yy;
+      int x,y,i;
+      Uint32* src;
+      Uint32* dst;
+      Uint8* row;
+
+      //Widen each line once, the other doScale-1 lines are copies of it
       for(y=0; y< SCREENH; y++)
       {
+        src = (Uint32*)( (Uint8*)screen->pixels+y*screen->pitch );
+        row = (Uint8*)scale->pixels+y*doScale*scale->pitch;
+        dst = (Uint32*)row;
         for(x=0; x < SCREENW; x++)
         {
-          uint16_t c = freadPixel(screen,x,y);/*SDL_MapRGB(scale->format,r,g,b);*/
-          xx=x*2;
-          yy=y*2;
-          plotPixelu(scale, xx,yy, c);
-          plotPixelu(scale, xx+1,yy, c);
-          plotPixelu(scale, xx,yy+1, c);
-          plotPixelu(scale, xx+1,yy+1, c);
+          for(i=0; i < doScale; i++)
+          {
+            *dst++ = src[x];
+          }
         }
-      }
-    } else if(doScale>2)
-    {
-      int x,y;
-      SDL_Rect r;
-      for(y=0; y< SCREENH; y++)
-      {
-        for(x=0; x < SCREENW; x++)
+        for(i=1; i < doScale; i++)
         {
-          r.x=x*doScale;
-          r.y=y*doScale;
-          r.w=doScale;
-          r.h=doScale;
-          SDL_FillRect(scale, &r, freadPixel(screen,x,y));
+          memcpy( row+i*scale->pitch, row, SCREENW*doScale*sizeof(Uint32) );
         }
       }
+      return( scale );
     }
 
-    if( doScale > -1 )
-    {
-      SDL_RenderPresent(scale);
-    }
+    return( screen );
 }
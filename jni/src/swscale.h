@@ -21,6 +21,6 @@
 #include <SDL.h>
 
 SDL_Surface* swScaleInit( int sdlVideoModeFlags, int doScale );
-void swScale( SDL_Surface* screen, int doScale );
+SDL_Surface* swScale( SDL_Surface* screen, int doScale ); //Returns the scaled frame, for the caller to present
 
 #endif // SWSCALE_H_INCLUDED
@@ -21,6 +21,7 @@
 #include "text.h"
 #include "sprite.h"
 #include "pack.h"
+#include "profiler.h"
 
 static SDL_Surface* txtSurf[NUMFONTS];
 static spriteType* txtSprites[NUMFONTS][91];
@@ -28,11 +29,31 @@ static int txtSize[NUMFONTS][2];
 
 static SDL_Rect txtBox; //Is valid after each txtWrite
 
+//Cache of strings rendered to their own colour-keyed surface, so an unchanged
+//string costs a single blit instead of one blit per character.
+struct txtCacheEntry_s
+{
+  int used;
+  int font;
+  uint32_t hash;
+  int lastUse; //For LRU eviction
+  SDL_Surface* surf; //NULL if string has nothing to draw
+  SDL_Rect box; //txtBox relative to the draw position
+  char str[TXT_CACHE_MAXLEN+1];
+};
+static struct txtCacheEntry_s txtCache[TXT_CACHE_SIZE];
+static int txtCacheClock=0;
+static txtCacheStats_t txtStats;
+static int txtGen[NUMFONTS]; //Bumped each time a font is (re)loaded, invalidates txtFields
+
 //Small is 9x12
 //Large is 18x24
 
 void loadFont(const char* imgFileName, int fontNum,int w, int h )
 {
+  //Anything rendered with the previous glyphs is stale now.
+  txtCacheFlush(fontNum);
+
   txtSize[fontNum][0] = w;
   txtSize[fontNum][1] = h;
 
@@ -74,6 +95,10 @@ void txtLoadGameCharSet(const char* font)
 void txtFreeGameCharSet()
 {
   int i;
+
+  txtCacheFlush(GAMEFONTSMALL);
+  txtCacheFlush(GAMEFONTMEDIUM);
+
   for(i=0; i < 91;i++)
   {
     free( txtSprites[GAMEFONTSMALL][i] );
@@ -90,7 +115,8 @@ void txtInit()
   loadFont( "data/menu/charmap1.png", FONTMEDIUM,18,24);
 }
 
-void txtWrite( SDL_Surface* scr,int fontNum, const char* txt, int x, int y)
+//Draws txt glyph by glyph, box is set like txtBox.
+static void txtRender( SDL_Surface* scr,int fontNum, const char* txt, int x, int y, SDL_Rect* box)
 {
   int px=x;
   int py=y;
@@ -98,8 +124,8 @@ void txtWrite( SDL_Surface* scr,int fontNum, const char* txt, int x, int y)
   char c;
   c = txt[pos];
 
-  txtBox.x=x;
-  txtBox.y=y;
+  box->x=x;
+  box->y=y;
 
   while( c != '\0')
   {
@@ -116,8 +142,211 @@ void txtWrite( SDL_Surface* scr,int fontNum, const char* txt, int x, int y)
     c = txt[pos];
     px+=txtSize[fontNum][0];
   }
-  txtBox.w=px;
-  txtBox.h=py+txtSize[fontNum][1];
+  box->w=px;
+  box->h=py+txtSize[fontNum][1];
+}
+
+//Renders txt into a new colour-keyed surface just large enough to hold it.
+//box is set relative to 0,0. Returns NULL if there's nothing to draw.
+static SDL_Surface* txtRenderSurface(int fontNum, const char* txt, SDL_Rect* box)
+{
+  int cols=0, maxCols=0, lines=1;
+  const char* c;
+  SDL_Surface* surf;
+  SDL_PixelFormat* fmt = txtSurf[fontNum]->format;
+
+  for(c=txt; *c; c++)
+  {
+    if(*c=='\n')
+    {
+      lines++;
+      cols=0;
+    } else {
+      cols++;
+      if(cols > maxCols)
+        maxCols=cols;
+    }
+  }
+
+  if(!maxCols)
+  {
+    txtRender(NULL, fontNum, txt, 0, 0, box);
+    return(NULL);
+  }
+
+  surf = SDL_CreateRGBSurface(0, maxCols*txtSize[fontNum][0], lines*txtSize[fontNum][1], fmt->BitsPerPixel, fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+  if(!surf)
+  {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "txtRenderSurface(); Couldn't create surface: %s\n", SDL_GetError());
+    return(NULL);
+  }
+
+  SDL_FillRect(surf, NULL, SDL_MapRGB(surf->format, 0, 0xFF, 0xFF));
+  txtRender(surf, fontNum, txt, 0, 0, box);
+  SDL_SetColorKey(surf, SDL_TRUE, SDL_MapRGB(surf->format, 0, 0xFF, 0xFF));
+
+  return(surf);
+}
+
+static uint32_t txtHash(int fontNum, const char* txt)
+{
+  uint32_t h=5381+fontNum;
+  while(*txt)
+  {
+    h = (h<<5) + h + (uint8_t)(*txt);
+    txt++;
+  }
+  return(h);
+}
+
+static struct txtCacheEntry_s* txtCacheGet(int fontNum, const char* txt)
+{
+  int i;
+  uint32_t hash = txtHash(fontNum, txt);
+  struct txtCacheEntry_s* e;
+  struct txtCacheEntry_s* victim=&txtCache[0];
+
+  for(i=0; i < TXT_CACHE_SIZE; i++)
+  {
+    e=&txtCache[i];
+    if( e->used && e->hash==hash && e->font==fontNum && strcmp(e->str, txt)==0 )
+    {
+      txtStats.hits++;
+      e->lastUse=++txtCacheClock;
+      return(e);
+    }
+
+    //Prefer an empty slot, otherwise the least recently used one.
+    if( victim->used && (!e->used || e->lastUse < victim->lastUse) )
+      victim=e;
+  }
+
+  txtStats.misses++;
+  if(victim->used)
+  {
+    txtStats.evictions++;
+    if(victim->surf)
+      SDL_FreeSurface(victim->surf);
+  }
+
+  victim->used=1;
+  victim->font=fontNum;
+  victim->hash=hash;
+  victim->lastUse=++txtCacheClock;
+  strcpy(victim->str, txt);
+  victim->surf=txtRenderSurface(fontNum, txt, &victim->box);
+  if(victim->surf)
+    SDL_SetSurfaceRLE(victim->surf, 1);
+
+  return(victim);
+}
+
+//Blit a pre-rendered string and update txtBox
+static void txtBlit( SDL_Surface* scr, SDL_Surface* surf, SDL_Rect* box, int x, int y)
+{
+  SDL_Rect pos;
+  if(surf)
+  {
+    pos.x=x;
+    pos.y=y;
+    SDL_BlitSurface(surf, NULL, scr, &pos);
+  }
+
+  txtBox.x=x;
+  txtBox.y=y;
+  txtBox.w=x+box->w;
+  txtBox.h=y+box->h;
+}
+
+void txtWrite( SDL_Surface* scr,int fontNum, const char* txt, int x, int y)
+{
+  struct txtCacheEntry_s* e;
+
+  profBegin(PROF_TEXT);
+  if( !txtSurf[fontNum] || strlen(txt) > TXT_CACHE_MAXLEN )
+  {
+    txtRender(scr, fontNum, txt, x, y, &txtBox);
+  } else {
+    e = txtCacheGet(fontNum, txt);
+    txtBlit(scr, e->surf, &e->box, x, y);
+  }
+  profEnd(PROF_TEXT);
+}
+
+void txtFieldWrite( SDL_Surface* scr, txtField_t* field, int fontNum, const char* txt, int x, int y)
+{
+  SDL_Surface* surf;
+
+  if( !txtSurf[fontNum] || strlen(txt) >= sizeof(field->str) )
+  {
+    txtWrite(scr, fontNum, txt, x, y);
+    return;
+  }
+
+  profBegin(PROF_TEXT);
+
+  //Only render again if something changed
+  if( field->font != fontNum || field->gen != txtGen[fontNum] || strcmp(field->str, txt)!=0 )
+  {
+    surf=txtRenderSurface(fontNum, txt, &field->box);
+    if(field->surf)
+      SDL_FreeSurface(field->surf);
+    field->surf=surf;
+    field->font=fontNum;
+    field->gen=txtGen[fontNum];
+    strcpy(field->str, txt);
+  }
+
+  txtBlit(scr, field->surf, &field->box, x, y);
+  profEnd(PROF_TEXT);
+}
+
+void txtFieldWriteCenter( SDL_Surface* scr, txtField_t* field, int fontNum, const char* txt, int x, int y)
+{
+  int len = txtSize[fontNum][0]*strlen(txt);
+
+  x -= len/2;
+  txtFieldWrite(scr, field, fontNum, txt, x, y);
+}
+
+void txtFieldFree( txtField_t* field )
+{
+  if(field->surf)
+    SDL_FreeSurface(field->surf);
+  memset(field, 0, sizeof(txtField_t));
+}
+
+void txtCacheFlush(int fontNum)
+{
+  int i;
+  for(i=0; i < TXT_CACHE_SIZE; i++)
+  {
+    if( txtCache[i].used && (fontNum==-1 || txtCache[i].font==fontNum) )
+    {
+      if(txtCache[i].surf)
+        SDL_FreeSurface(txtCache[i].surf);
+      txtCache[i].surf=NULL;
+      txtCache[i].used=0;
+    }
+  }
+
+  for(i=0; i < NUMFONTS; i++)
+  {
+    if(fontNum==-1 || i==fontNum)
+      txtGen[i]++;
+  }
+}
+
+txtCacheStats_t* txtCacheGetStats()
+{
+  int i;
+  txtStats.entries=0;
+  for(i=0; i < TXT_CACHE_SIZE; i++)
+  {
+    if(txtCache[i].used)
+      txtStats.entries++;
+  }
+  return(&txtStats);
 }
 
 void txtWriteCenter( SDL_Surface* scr,int fontNum, const char* txt, int x, int y)
@@ -143,6 +372,7 @@ void txtWave( SDL_Surface* scr, int fontNum, const char* txt, int x, int y, floa
   char c;
   c = txt[pos];
 
+  profBegin(PROF_TEXT);
   while( c != '\0')
   {
     pos++;
@@ -158,6 +388,7 @@ void txtWave( SDL_Surface* scr, int fontNum, const char* txt, int x, int y, floa
     c = txt[pos];
     px+=txtSize[fontNum][0];
   }
+  profEnd(PROF_TEXT);
 }
 
 int* getCharSize(int font)
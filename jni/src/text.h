@@ -28,6 +28,34 @@
 #define FONTMEDIUM 1
 #define FONTSMALL 0
 
+//Number of pre-rendered strings kept by the text cache, platforms can override.
+#ifndef TXT_CACHE_SIZE
+  #define TXT_CACHE_SIZE 96
+#endif
+//Strings longer than this are drawn char by char and never cached.
+#define TXT_CACHE_MAXLEN 128
+
+//Counters for tuning TXT_CACHE_SIZE
+struct txtCacheStats_s
+{
+  int hits;
+  int misses;
+  int evictions;
+  int entries; //Slots currently in use
+};
+typedef struct txtCacheStats_s txtCacheStats_t;
+
+//A text field owns its own surface and only re-renders when its string changes.
+//Used for values that change often (score, time) so they don't churn the cache.
+struct txtField_s
+{
+  int font;
+  int gen; //Font generation the surface was rendered with
+  char str[32];
+  SDL_Surface* surf;
+  SDL_Rect box; //txtBox relative to the draw position
+};
+typedef struct txtField_s txtField_t;
 
 void txtInit(); //load menu charactersets
 void txtLoadGameCharSet(const char* font);
@@ -38,4 +66,11 @@ void txtWave( SDL_Surface* scr, int fontNum, const char* txt, int x, int y, floa
 int* getCharSize(int font);
 SDL_Rect* getTxtBox();
 
+void txtFieldWrite( SDL_Surface* scr, txtField_t* field, int fontNum, const char* txt, int x, int y);
+void txtFieldWriteCenter( SDL_Surface* scr, txtField_t* field, int fontNum, const char* txt, int x, int y);
+void txtFieldFree( txtField_t* field );
+
+void txtCacheFlush(int fontNum); //Drop cached strings for font (-1 for all)
+txtCacheStats_t* txtCacheGetStats();
+
 #endif // TEXT_H_INCLUDED
@@ -15,25 +15,209 @@
  * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
  ************************************************************************/
 
+#include <stdio.h>
+#include <string.h>
+
+#include "ticks.h"
 #include "time.h"
 #include "text.h"
+#include "settings.h"
 
 #include "defs.h"
 
-static int lastTick=0; //SDL clock
+static Uint64 perfFreq=0; //Performance counter ticks per second
+static Uint64 lastCount=0; //Performance counter at frame start
+static Uint64 msCarry=0; //Counts not yet handed out as whole milliseconds
 static int ticks=0; //ticks since last frame
 
 static int frames=0;
+
+//Frame scheduler
+static Uint64 period=0; //Counts per frame, 0 = don't pace
+static Uint64 vsyncPeriod=0; //Counts per display refresh if present waits for vsync, else 0
+static Uint64 spinCounts=0; //Counts before the deadline where we stop sleeping and spin
+static Uint64 deadline=0; //When the current frame should end
+
+//Late input
+static int lateInput=0;
+static Uint64 lateMargin=0; //Counts left for presenting
+static Uint64 workEst=0; //Counts from frame start to present, the peak of recent frames
+
+//Frame time statistics, collected over FRAMESCHED_REPORT_FRAMES frames
+static frameSchedStats_t schedStats;
+static double ftSum=0, ftSumSq=0, ftMin=0, ftMax=0;
+static int ftFrames=0, ftLate=0;
+
+static void frameTimeAdd(double ms)
+{
+  if( ftFrames==0 || ms < ftMin ) ftMin=ms;
+  if( ftFrames==0 || ms > ftMax ) ftMax=ms;
+  ftSum += ms;
+  ftSumSq += ms*ms;
+  ftFrames++;
+
+  if( ftFrames == FRAMESCHED_REPORT_FRAMES )
+  {
+    schedStats.frames=ftFrames;
+    schedStats.late=ftLate;
+    schedStats.mean=ftSum/ftFrames;
+    schedStats.variance=ftSumSq/ftFrames - schedStats.mean*schedStats.mean;
+    if( schedStats.variance < 0 )
+      schedStats.variance=0;
+    schedStats.min=ftMin;
+    schedStats.max=ftMax;
+
+    if( setting()->showFps )
+    {
+      SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Frame time: avg %.2f ms, variance %.3f ms^2, min %.2f ms, max %.2f ms, %i of %i frames late.",
+                  schedStats.mean, schedStats.variance, schedStats.min, schedStats.max, schedStats.late, schedStats.frames);
+    }
+
+    ftSum=ftSumSq=0;
+    ftFrames=ftLate=0;
+  }
+}
+
+void frameSchedInit(int rate, int refreshRate, int late)
+{
+  perfFreq = SDL_GetPerformanceFrequency();
+  period = (rate > 0)?perfFreq/rate:0;
+  vsyncPeriod = (refreshRate > 0)?perfFreq/refreshRate:0;
+  spinCounts = (perfFreq*FRAMESCHED_SPIN_MS)/1000;
+  deadline=0;
+
+  lateInput=late;
+  lateMargin = (perfFreq*FRAMESCHED_LATE_MARGIN_MS)/1000;
+  workEst=0;
+
+  memset(&schedStats, 0, sizeof(frameSchedStats_t));
+
+  SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "frameSchedInit(); Target %i fps, vsync %s (%i Hz), spin %i ms, late input %s.",
+              rate, (vsyncPeriod)?"on":"off", refreshRate, FRAMESCHED_SPIN_MS, (lateInput)?"on":"off");
+  if( lateInput && !vsyncPeriod )
+  {
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "frameSchedInit(); Without vsync input is already polled right before the frame, late input changes nothing.");
+  }
+}
+
 void frameStart()
 {
-  ticks = SDL_GetTicks() - lastTick;
-  lastTick = SDL_GetTicks();
+  Uint64 now = SDL_GetPerformanceCounter();
+  Uint64 counts;
+
+  if( !perfFreq )
+    perfFreq = SDL_GetPerformanceFrequency();
+
+  if( lastCount )
+  {
+    //Hand out whole milliseconds and carry the rest, so getTicks() doesn't drift from the real clock
+    counts = now - lastCount + msCarry;
+    ticks = (int)( (counts*1000)/perfFreq );
+    msCarry = counts - ((Uint64)ticks*perfFreq)/1000;
+
+    frameTimeAdd( (double)(now-lastCount)*1000.0/(double)perfFreq );
+  }
+
+  lastCount = now;
+  frames++;
+}
+
+void frameStartFixed(int ms)
+{
+  ticks=ms;
   frames++;
 }
 
+void frameSchedPresent()
+{
+  Uint64 work;
+
+  if( !lateInput || !lastCount )
+    return;
+
+  //Rise at once but fall slowly, so one quick frame doesn't make the next miss its refresh
+  work = SDL_GetPerformanceCounter()-lastCount;
+  if( work > workEst )
+    workEst = work;
+  else
+    workEst -= (workEst-work)/16;
+}
+
+//Sleep most of the way, SDL_Delay may oversleep by a few ms, then spin for the rest
+static void sleepUntil(Uint64 target)
+{
+  Uint64 now = SDL_GetPerformanceCounter();
+
+  if( target <= now )
+    return;
+
+  if( target - now > spinCounts )
+  {
+    SDL_Delay( (Uint32)( ((target-now-spinCounts)*1000)/perfFreq ) );
+  }
+
+  while( SDL_GetPerformanceCounter() < target )
+  {
+  }
+}
+
+void frameSchedWait()
+{
+  Uint64 now, target, lead, refresh;
+
+  now = SDL_GetPerformanceCounter();
+
+  //The display refreshes at or below our rate, so presenting already paces us
+  if( vsyncPeriod && (!period || vsyncPeriod >= period) )
+  {
+    deadline=0;
+    target=now;
+  } else {
+    if( !period )
+      return;
+
+    if( !deadline )
+      deadline = lastCount;
+    deadline += period;
+
+    if( now >= deadline )
+    {
+      ftLate++;
+      //More than a frame behind, start over instead of rushing frames to catch up
+      if( now - deadline > period )
+        deadline = now;
+      return;
+    }
+
+    //Presenting waits for the next vblank, so leave that last bit to it
+    target = (vsyncPeriod)?deadline-vsyncPeriod:deadline;
+  }
+
+  //Present just returned at a refresh, so the next ones are known. Instead of starting now and
+  //waiting for the refresh in present, start just in time to make it, so input is read later.
+  if( lateInput && vsyncPeriod )
+  {
+    lead = workEst+lateMargin;
+    if( lead < vsyncPeriod )
+    {
+      refresh = now+vsyncPeriod;
+      while( refresh < target+lead )
+        refresh += vsyncPeriod;
+      target = refresh-lead;
+    }
+  }
+
+  sleepUntil( target );
+}
+
+frameSchedStats_t* frameSchedGetStats()
+{
+  return(&schedStats);
+}
+
 static int fpsSecondCounter=0;
 static int fps=0;
-static char fpsStr[16] = { '0','0','\0' };
+static char fpsStr[32] = { '0','0','\0' };
 
 int getTicks()
 {
@@ -42,7 +226,7 @@ int getTicks()
 
 int getTimeSinceFrameStart()
 {
-  return( SDL_GetTicks() - lastTick );
+  return( (int)( ((SDL_GetPerformanceCounter()-lastCount)*1000)/perfFreq ) );
 }
 
 
@@ -52,7 +236,7 @@ void drawFPS(SDL_Surface* scr)
   fpsSecondCounter+=getTicks();
   if(fpsSecondCounter > 999)
   {
-    sprintf(fpsStr, "%i Fps", fps);
+    sprintf(fpsStr, "%i Fps %.1f ms", fps, schedStats.mean);
     fps=0;
     fpsSecondCounter=0;
   }
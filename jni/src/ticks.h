@@ -20,7 +20,17 @@
 
 #include <SDL.h>
 
+struct frameSchedStats_s {
+  int frames; //Frames in the last report window
+  int late; //Frames that missed their deadline
+  double mean, variance; //Frame time in ms and ms^2
+  double min, max;
+};
+typedef struct frameSchedStats_s frameSchedStats_t;
+
 void frameStart();
+//Start a frame that took ms whatever the clock says, for benchmarks that have to repeat exactly.
+void frameStartFixed(int ms);
 
 int getTicks();
 
@@ -28,4 +38,14 @@ int getTimeSinceFrameStart();
 
 void drawFPS(SDL_Surface* scr);
 
+//Frame scheduler: rate is the target fps (0 = unpaced), refreshRate is the display refresh rate if present waits for vsync, else 0.
+//With lateInput, frames paced by vsync wait before polling input instead of inside present, see frameSchedWait().
+void frameSchedInit(int rate, int refreshRate, int lateInput);
+//Call right before presenting, late input uses it to know how long a frame takes.
+void frameSchedPresent();
+//Call after presenting, waits until the next frame is due.
+void frameSchedWait();
+//Frame time statistics from the last complete report window.
+frameSchedStats_t* frameSchedGetStats();
+
 #endif // FPSCOUNTER_H_INCLUDED
@@ -15,12 +15,22 @@
  * along with Wizznic.  If not, see <http://www.gnu.org/licenses/>.     *
  ************************************************************************/
 
+#include <string.h>
+#include <math.h>
+
 #include "transition.h"
 #include "pixel.h"
 #include "ticks.h"
 #include "list/list.h"
 #include "particles.h"
 
+//Size of the area the transitions work on (the play area in the middle of the screen)
+#define TRANS_W 320
+#define TRANS_H 240
+
+//Radius needed for the iris to cover the whole play area: sqrt(160^2+120^2)
+#define TRANS_IRIS_R 200
+
 struct transition_s {
    SDL_Surface* sur;
    int_fast8_t type;
@@ -33,12 +43,175 @@ typedef struct transition_s transition_t;
 
 transition_t t;
 
-void initTransition()
+//Two persistent capture buffers, allocated once in initTransition.
+//[0] holds the outgoing frame grabbed in startTransition, [1] holds the incoming frame
+//for the kernels that move pixels around (roll) and so can't work in place.
+static SDL_Surface* capture[2] = { NULL, NULL };
+
+void initTransition(SDL_Surface* scr)
 {
+  int i;
   t.sur=NULL;
   t.timeLeft=0;
   t.time=0;
-  t.sur=NULL;
+
+  for(i=0; i < 2; i++)
+  {
+    if( capture[i] != NULL )
+    {
+      SDL_FreeSurface(capture[i]);
+    }
+    capture[i] = SDL_CreateRGBSurface(0, TRANS_W, TRANS_H, scr->format->BitsPerPixel,
+                 scr->format->Rmask, scr->format->Gmask, scr->format->Bmask, scr->format->Amask);
+    if( capture[i] == NULL )
+    {
+      SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "initTransition(); Couldn't create capture buffer %i: %s", i, SDL_GetError());
+    }
+  }
+
+  t.sur=capture[0];
+}
+
+//Start of row y of the play area on the screen
+static inline Uint8* scrRow(SDL_Surface* scr, int y)
+{
+  return( (Uint8*)scr->pixels + (HSCREENH-120+y)*scr->pitch + (HSCREENW-160)*scr->format->BytesPerPixel );
+}
+
+//Start of row y in a capture buffer
+static inline Uint8* capRow(SDL_Surface* cap, int y)
+{
+  return( (Uint8*)cap->pixels + y*cap->pitch );
+}
+
+static void capturePlayArea(SDL_Surface* scr, SDL_Surface* cap)
+{
+  int y;
+  int len = TRANS_W*scr->format->BytesPerPixel;
+
+  for(y=0; y < TRANS_H; y++)
+  {
+    memcpy( capRow(cap,y), scrRow(scr,y), len );
+  }
+}
+
+//Put back the outgoing frame from x0 to x1 on row y
+static inline void oldSpan(SDL_Surface* scr, int y, int x0, int x1)
+{
+  int bpp = scr->format->BytesPerPixel;
+
+  if( x0 < 0 ) x0=0;
+  if( x1 > TRANS_W ) x1=TRANS_W;
+  if( x1 <= x0 )
+    return;
+
+  memcpy( scrRow(scr,y)+x0*bpp, capRow(t.sur,y)+x0*bpp, (x1-x0)*bpp );
+}
+
+//Curtain: Whole rows of the outgoing frame, from the top or from the bottom
+static void kernelCurtain(SDL_Surface* scr, int rows)
+{
+  int y, y0=(t.reverse)?TRANS_H-rows:0;
+
+  for(y=y0; y < y0+rows; y++)
+  {
+    oldSpan(scr, y, 0, TRANS_W);
+  }
+}
+
+//Roll: The outgoing frame slides out while the incoming frame slides in, x is the width still taken by the outgoing frame.
+static void kernelRoll(SDL_Surface* scr, int x)
+{
+  int y;
+  int bpp = scr->format->BytesPerPixel;
+  Uint8* dst;
+
+  capturePlayArea(scr, capture[1]);
+
+  for(y=0; y < TRANS_H; y++)
+  {
+    dst=scrRow(scr,y);
+    if( t.reverse )
+    {
+      memcpy( dst, capRow(capture[1],y)+x*bpp, (TRANS_W-x)*bpp );
+      memcpy( dst+(TRANS_W-x)*bpp, capRow(t.sur,y), x*bpp );
+    } else {
+      memcpy( dst, capRow(t.sur,y)+(TRANS_W-x)*bpp, x*bpp );
+      memcpy( dst+x*bpp, capRow(capture[1],y), (TRANS_W-x)*bpp );
+    }
+  }
+}
+
+//Diagonal: An edge sweeping from the top left to the bottom right corner, edge is the progress from 0 to TRANS_W*2
+static void kernelDiagonal(SDL_Surface* scr, int edge)
+{
+  int y;
+
+  for(y=0; y < TRANS_H; y++)
+  {
+    oldSpan(scr, y, edge - (y*TRANS_W)/TRANS_H, TRANS_W);
+  }
+}
+
+//Iris: The incoming frame is shown through a growing circle in the middle
+static void kernelIris(SDL_Surface* scr, int r)
+{
+  int y, dy, hw;
+
+  for(y=0; y < TRANS_H; y++)
+  {
+    dy = y - TRANS_H/2;
+    if( dy*dy < r*r )
+    {
+      hw = (int)sqrtf( (float)(r*r - dy*dy) );
+      oldSpan(scr, y, 0, TRANS_W/2-hw);
+      oldSpan(scr, y, TRANS_W/2+hw, TRANS_W);
+    } else {
+      oldSpan(scr, y, 0, TRANS_W);
+    }
+  }
+}
+
+//Fixed pseudo-random rank (0-255) of each pixel, the same every frame so pixels only ever flip once.
+static inline int pixelRank(int x, int y)
+{
+  uint32_t h = (uint32_t)x*73856093u ^ (uint32_t)y*19349663u;
+  h ^= h >> 13;
+  h *= 0x5bd1e995u;
+  h ^= h >> 15;
+  return( h & 0xff );
+}
+
+//Pixel dissolve: Pixels with a rank below level still show the outgoing frame
+static void kernelPixelDissolve(SDL_Surface* scr, int level)
+{
+  int x,y;
+  int bpp = scr->format->BytesPerPixel;
+  Uint8 *dst, *src;
+
+  for(y=0; y < TRANS_H; y++)
+  {
+    dst=scrRow(scr,y);
+    src=capRow(t.sur,y);
+    switch(bpp)
+    {
+      case 4:
+        for(x=0; x < TRANS_W; x++)
+          if( pixelRank(x,y) < level )
+            ((Uint32*)dst)[x] = ((Uint32*)src)[x];
+      break;
+      case 2:
+        for(x=0; x < TRANS_W; x++)
+          if( pixelRank(x,y) < level )
+            ((Uint16*)dst)[x] = ((Uint16*)src)[x];
+      break;
+      default:
+        for(x=0; x < TRANS_W; x++)
+          if( pixelRank(x,y) < level )
+            memcpy( dst+x*bpp, src+x*bpp, bpp );
+      break;
+    }
+  }
 }
 
 #define _TRANSITION_TYPE_ROLL 253
@@ -52,11 +225,6 @@ void startTransition(SDL_Surface* scr, uint_fast8_t type, uint_fast16_t time)
   t.timeLeft=t.time;
   t.reverse=0;
 
-  if( t.sur != NULL )
-  {
-    SDL_FreeSurface(t.sur);
-  }
-
   switch( t.type )
   {
     case TRANSITION_TYPE_DISSOLVE:
@@ -82,18 +250,25 @@ void startTransition(SDL_Surface* scr, uint_fast8_t type, uint_fast16_t time)
     case TRANSITION_TYPE_CURTAIN_DOWN:
      t.reverse=1;
      /* no break */
-    case TRANSITION_TYPE_ROLL_OUT:
-    case TRANSITION_TYPE_CURTAIN_UP:
-      t.sur = SDL_ConvertSurface( scr, scr->format, scr->flags );
-      //Some surfaces has flags set that prevent propper blitting
-      t.sur->flags=0x00;
+    default:
+      //The kernels copy raw rows, so the buffers must match the screen
+      if( !capture[0] || !capture[1] || capture[0]->format->BytesPerPixel != scr->format->BytesPerPixel )
+      {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "startTransition(); No usable capture buffers, skipping transition.");
+        t.timeLeft=0;
+        return;
+      }
+
+      if( SDL_MUSTLOCK(scr) ) SDL_LockSurface(scr);
+      capturePlayArea(scr, t.sur);
+      if( SDL_MUSTLOCK(scr) ) SDL_UnlockSurface(scr);
     break;
   }
 }
 
 void runTransition(SDL_Surface* scr)
 {
-  int x;
+  int elapsed;
   if( t.timeLeft == 0 )
     return;
 
@@ -101,82 +276,42 @@ void runTransition(SDL_Surface* scr)
   if( t.timeLeft < 1 )
     t.timeLeft=0;
 
-  SDL_Rect r,rr;
-  SDL_Surface* tmpSurf;
+  //Done, the screen already holds the incoming frame
+  if( t.timeLeft == 0 && t.type != TRANSITION_TYPE_DISSOLVE )
+    return;
+
+  elapsed = t.time-t.timeLeft;
+
+  if( t.type == TRANSITION_TYPE_DISSOLVE )
+  {
+    runParticles(scr);
+    return;
+  }
+
+  if( SDL_MUSTLOCK(scr) ) SDL_LockSurface(scr);
 
   switch(t.type)
   {
     case TRANSITION_TYPE_CURTAIN_UP:
     case TRANSITION_TYPE_CURTAIN_DOWN:
-      rr.x=(HSCREENW-160);
-      x=((float)(t.timeLeft)/(float)(t.time))*(float)(240);
-
-      r.x=(HSCREENW-160);
-      r.w=(320);
-
-
-      if( !t.reverse )
-      {
-        r.h=x;
-        r.y=(HSCREENH-120);
-        rr.y=(HSCREENH-120);
-      } else {
-        r.h=HSCREENH+120;
-        r.y=HSCREENH+120-x;
-        rr.y=HSCREENH+120-x;
-      }
-      SDL_BlitSurface(t.sur, &r, scr, &rr );
-    break;
-    case TRANSITION_TYPE_DISSOLVE:
-      runParticles(scr);
+      kernelCurtain(scr, (t.timeLeft*TRANS_H)/t.time );
     break;
     case TRANSITION_TYPE_ROLL_IN:
-      x=((float)(t.timeLeft)/(float)(t.time))*(float)(320);
-
-      tmpSurf = SDL_ConvertSurface( scr, scr->format, scr->flags );
-      tmpSurf->flags=0x00;
-      r.y=(HSCREENH-120);
-      rr.y=(HSCREENH-120);
-      r.h=240;
-      rr.h=240;
-
-      rr.x=HSCREENW+160-x;
-      r.x = (HSCREENW-160);
-      r.w = x;
-      SDL_BlitSurface(t.sur, &r, scr, &rr );
-
-      rr.x=HSCREENW-160;
-      r.x = HSCREENW-160+x;
-      r.w = 320-x;
-      SDL_BlitSurface(tmpSurf,&r, scr, &rr );
-
-      SDL_FreeSurface(tmpSurf);
-    break;
-
     case TRANSITION_TYPE_ROLL_OUT:
-      x=((float)(t.timeLeft)/(float)(t.time))*(float)(320);
-
-      tmpSurf = SDL_ConvertSurface( scr, scr->format, scr->flags );
-      tmpSurf->flags=0x00;
-      r.y=(HSCREENH-120);
-      rr.y=(HSCREENH-120);
-      r.h=240;
-      rr.h=240;
-
-      rr.x=HSCREENW-160;
-      r.x = (HSCREENW+160)-x;
-      r.w = x;
-      SDL_BlitSurface(t.sur, &r, scr, &rr );
-
-      rr.x=HSCREENW-160+x;
-      r.x = HSCREENW-160;
-      r.w = 320-x;
-      SDL_BlitSurface(tmpSurf,&r, scr, &rr );
-
-      SDL_FreeSurface(tmpSurf);
+      kernelRoll(scr, (t.timeLeft*TRANS_W)/t.time );
+    break;
+    case TRANSITION_TYPE_DIAGONAL:
+      kernelDiagonal(scr, (elapsed*TRANS_W*2)/t.time );
+    break;
+    case TRANSITION_TYPE_IRIS:
+      kernelIris(scr, (elapsed*TRANS_IRIS_R)/t.time );
+    break;
+    case TRANSITION_TYPE_PIXEL_DISSOLVE:
+      kernelPixelDissolve(scr, (t.timeLeft*256)/t.time );
     break;
-
   }
+
+  if( SDL_MUSTLOCK(scr) ) SDL_UnlockSurface(scr);
 }
 
 int_fast8_t  transitionActive()
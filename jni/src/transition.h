@@ -25,11 +25,14 @@
 #define TRANSITION_TYPE_CURTAIN_DOWN 2
 #define TRANSITION_TYPE_ROLL_OUT 3
 #define TRANSITION_TYPE_ROLL_IN 4
-#define NUM_TRANSITIONS 5
+#define TRANSITION_TYPE_DIAGONAL 5
+#define TRANSITION_TYPE_IRIS 6
+#define TRANSITION_TYPE_PIXEL_DISSOLVE 7
+#define NUM_TRANSITIONS 8
 
 #define TRANSITION_TYPE_RANDOM 255
 
-void initTransition();
+void initTransition(SDL_Surface* scr);
 void startTransition(SDL_Surface* scr, uint_fast8_t type, uint_fast16_t time);
 void runTransition(SDL_Surface* scr);
 
@@ -17,6 +17,7 @@
 
 #include "userfiles.h"
 #include "defs.h"
+#include "strings.h"
 
 #include <sys/stat.h>
 #include <stdio.h>
@@ -27,16 +28,36 @@ static char* strConfDir;
 static char* strEditLvlDir;
 static char* strUsrPackDir;
 static char* strHsDir;
+static char strAppStamp[64];
 
+#if defined(__ANDROID__)
 void Java_com_game_wizznic_HelloSDL2Activity_initAppFolders(JNIEnv *env, jobject clazz, jstring storageRootPath) {
 	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "---- init folders start");
 	strConfDir = (*env)->GetStringUTFChars(env, storageRootPath, 0);
 	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "---- init folders end strConfDir =  %s", strConfDir);
 }
 
+//The install time changes on every install, the versionCode only when someone remembers to bump it
+void Java_com_game_wizznic_HelloSDL2Activity_initAppVersion(JNIEnv *env, jobject clazz, jint versionCode, jlong installTime) {
+	snprintf( strAppStamp, sizeof(strAppStamp), "%i.%lld", (int)versionCode, (long long)installTime );
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "---- app version %s", strAppStamp);
+}
+#endif
+
 void initUserPaths()
 {
   SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "initUserPaths");
+  #if !defined(__ANDROID__)
+  //No activity to hand us a folder, use ~/.wizznic like the desktop game
+  if( !strConfDir )
+  {
+    const char* home = getenv("HOME");
+    if( !home )
+      home = ".";
+    strConfDir = malloc( sizeof(char)*( strlen(home)+strlen("/.wizznic")+1 ) );
+    sprintf( strConfDir, "%s/.wizznic", home );
+  }
+  #endif
   strEditLvlDir = malloc( sizeof(char)*( strlen(strConfDir)+strlen("/editorlevels")+1 ) );
   sprintf( strEditLvlDir, "%s/editorlevels", strConfDir );
 
@@ -59,3 +80,5 @@ char* getConfigDir() { return( strConfDir ); }
 char* getHighscoreDir() { return( strHsDir ); }
 char* getUserLevelDir() { return( strEditLvlDir ); }
 char* getUsrPackDir() { return( strUsrPackDir ); }
+//Elsewhere the levels are files with an mtime, the version is enough
+const char* getAppStamp() { return( (strAppStamp[0])?strAppStamp:VERSION_STRING ); }
@@ -1,7 +1,9 @@
 #ifndef USERFILES_H_INCLUDED
 #define USERFILES_H_INCLUDED
 
+#if defined(__ANDROID__)
 #include <jni.h>
+#endif
 #include <SDL.h>
 
 /************************************************************************
@@ -27,5 +29,7 @@ char* getConfigDir();
 char* getHighscoreDir();
 char* getUserLevelDir();
 char* getUsrPackDir();
+//Changes with every install of the app, also when only the assets were rebuilt
+const char* getAppStamp();
 
 #endif // USERFILES_H_INCLUDED
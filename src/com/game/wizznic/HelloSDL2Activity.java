@@ -2,6 +2,8 @@ package com.game.wizznic;
 
 import android.os.Bundle;
 import android.content.res.AssetManager;
+import android.content.pm.PackageInfo;
+import android.content.pm.PackageManager;
 import org.libsdl.app.SDLActivity;
 
 public class HelloSDL2Activity extends SDLActivity
@@ -10,9 +12,17 @@ public class HelloSDL2Activity extends SDLActivity
 		super.onCreate(savedInstanceState);
 		initAndroidUtils(getAssets());
 		initAppFolders(getFilesDir().getAbsolutePath());
+		try {
+			PackageInfo info = getPackageManager().getPackageInfo(getPackageName(), 0);
+			initAppVersion(info.versionCode, info.lastUpdateTime);
+		} catch (PackageManager.NameNotFoundException e) {
+			initAppVersion(0, 0);
+		}
 	}
 	
 	native void initAndroidUtils(AssetManager manager);
 	
 	native void initAppFolders(String storageRoot);
+
+	native void initAppVersion(int versionCode, long installTime);
 }